@@ -0,0 +1,104 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "batch-writer.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+void Check(int condition, char* message) {
+  if (!condition) {
+    fprintf(stderr, "Condition failed: %s\n", message);
+    exit(1);
+  }
+}
+
+// Creates an empty temporary file and returns its name.
+char* MakeTempFile() {
+  static char filename[32];
+  strcpy(filename, "/tmp/batch-writer-testXXXXXX");
+  int fd = mkstemp(filename);
+  Check(fd >= 0, "Temporary file should open");
+  close(fd);
+  return filename;
+}
+
+// Returns the contents of the file in a buffer the caller frees.
+char* ReadFile(char* filename) {
+  FILE* file = fopen(filename, "rb");
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  rewind(file);
+  char* contents = malloc(size + 1);
+  Check(fread(contents, 1, size, file) == size, "File should be read");
+  contents[size] = '\0';
+  fclose(file);
+  return contents;
+}
+
+void TestWritesInOrder() {
+  char* filename = MakeTempFile();
+  char expected[2000] = "";
+  BatchWriter writer;
+  BatchWriterOpen(filename, 3, 0, &writer);
+  Check(BatchWriterFlushedBytes(&writer) == 0, "Nothing should be flushed");
+  int i;
+  for (i = 0; i < 200; i++) {
+    char line[16];
+    sprintf(line, "%d\n", i);
+    strcat(expected, line);
+    BatchWriterAppend(line, strlen(line), &writer);
+  }
+  BatchWriterAppend("", 0, &writer);
+  BatchWriterClose(&writer);
+  char* contents = ReadFile(filename);
+  Check(strcmp(contents, expected) == 0, "Lines should be written in order");
+  free(contents);
+  unlink(filename);
+}
+
+void TestFlushAfterTime() {
+  char* filename = MakeTempFile();
+  BatchWriter writer;
+  BatchWriterOpen(filename, 0, 10, &writer);
+  BatchWriterAppend("1\n2\n", 4, &writer);
+  struct timespec delay = {0, 200000000};
+  nanosleep(&delay, NULL);
+  char* contents = ReadFile(filename);
+  Check(strcmp(contents, "1\n2\n") == 0,
+        "Lines should be flushed once the time is up");
+  Check(BatchWriterFlushedBytes(&writer) == 4,
+        "Flushed lines should be counted");
+  free(contents);
+  BatchWriterClose(&writer);
+  unlink(filename);
+}
+
+void TestStopRequest() {
+  Check(!BatchWriterStopRequested(), "No stop should be requested yet");
+  BatchWriterCatchSignals();
+  raise(SIGTERM);
+  Check(BatchWriterStopRequested(), "SIGTERM should request a stop");
+}
+
+int main() {
+  TestWritesInOrder();
+  TestFlushAfterTime();
+  TestStopRequest();
+  printf("All tests passed\n");
+}
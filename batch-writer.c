@@ -0,0 +1,217 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "batch-writer.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Size of the stdio buffer, so that the file sees few large writes.
+#define WRITE_BUFFER_BYTES (1 << 20)
+
+static volatile sig_atomic_t stop_requested = 0;
+
+// Exits the program after sending the message to stderr.
+static void ErrorOut(char* message) {
+  fprintf(stderr, "%s\n", message);
+  exit(1);
+}
+
+// Retries a semaphore wait that a signal interrupted.
+static void Wait(sem_t* semaphore) {
+  while (sem_wait(semaphore) != 0) {
+    if (errno != EINTR) {
+      ErrorOut("Unable to wait for the batch writer.");
+    }
+  }
+}
+
+// Pushes out everything written so far and reports the last line.
+static void Flush(BatchWriter* writer) {
+  if (fflush(writer->out_) != 0 || fsync(fileno(writer->out_)) != 0) {
+    ErrorOut("Unable to flush the output file.");
+  }
+  pthread_mutex_lock(&writer->flushed_lock_);
+  writer->flushed_bytes_ = writer->written_bytes_;
+  pthread_mutex_unlock(&writer->flushed_lock_);
+  if (writer->last_line_size_ > 0) {
+    printf("Found primes through: %.*s", (int) writer->last_line_size_,
+           writer->last_line_);
+    fflush(stdout);
+  }
+}
+
+// Keeps a copy of the last line of the text.
+static void KeepLastLine(const char* data, size_t size, BatchWriter* writer) {
+  size_t start = size - 1;
+  while (start > 0 && data[start - 1] != '\n') {
+    start--;
+  }
+  writer->last_line_ = realloc(writer->last_line_, size - start);
+  if (writer->last_line_ == NULL) {
+    ErrorOut("Unable to allocate space for the last line.");
+  }
+  memcpy(writer->last_line_, data + start, size - start);
+  writer->last_line_size_ = size - start;
+}
+
+static void* RunWriter(void* arg) {
+  BatchWriter* writer = arg;
+  int waiting_lines = 0;
+  struct timespec deadline;
+  while (1) {
+    // Wait for more text, or until the time to flush what is waiting.
+    if (waiting_lines > 0 && writer->flush_ms_ > 0) {
+      if (sem_timedwait(&writer->filled_, &deadline) != 0) {
+        if (errno == ETIMEDOUT) {
+          Flush(writer);
+          waiting_lines = 0;
+        } else if (errno != EINTR) {
+          ErrorOut("Unable to wait for the batch writer.");
+        }
+        continue;
+      }
+    } else {
+      Wait(&writer->filled_);
+    }
+    BatchWriterEntry entry =
+        writer->entries_[writer->tail_ % BATCH_WRITER_QUEUE_SIZE];
+    writer->tail_++;
+    sem_post(&writer->free_);
+    if (entry.data == NULL) {
+      break;
+    }
+
+    if (fwrite(entry.data, 1, entry.size, writer->out_) != entry.size) {
+      ErrorOut("Unable to write to the output file.");
+    }
+    writer->written_bytes_ += entry.size;
+    KeepLastLine(entry.data, entry.size, writer);
+    if (waiting_lines == 0) {
+      clock_gettime(CLOCK_REALTIME, &deadline);
+      deadline.tv_sec += writer->flush_ms_ / 1000;
+      deadline.tv_nsec += (long) (writer->flush_ms_ % 1000) * 1000000;
+      if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+      }
+    }
+    const char* line = entry.data;
+    const char* end = entry.data + entry.size;
+    while ((line = memchr(line, '\n', end - line)) != NULL) {
+      waiting_lines++;
+      line++;
+    }
+    free(entry.data);
+    if (writer->flush_lines_ > 0 && waiting_lines >= writer->flush_lines_) {
+      Flush(writer);
+      waiting_lines = 0;
+    }
+  }
+  if (waiting_lines > 0) {
+    Flush(writer);
+  }
+  return NULL;
+}
+
+// Hands an entry to the writer thread, waiting for room in the ring.
+static void Push(char* data, size_t size, BatchWriter* writer) {
+  Wait(&writer->free_);
+  BatchWriterEntry* entry =
+      &writer->entries_[writer->head_ % BATCH_WRITER_QUEUE_SIZE];
+  entry->data = data;
+  entry->size = size;
+  writer->head_++;
+  sem_post(&writer->filled_);
+}
+
+void BatchWriterOpen(char* filename, int flush_lines, int flush_ms,
+                     BatchWriter* writer) {
+  writer->out_ = fopen(filename, "a");
+  if (writer->out_ == NULL) {
+    ErrorOut("Unable to open the output file.");
+  }
+  setvbuf(writer->out_, NULL, _IOFBF, WRITE_BUFFER_BYTES);
+  writer->flush_lines_ = flush_lines;
+  writer->flush_ms_ = flush_ms;
+  writer->head_ = 0;
+  writer->tail_ = 0;
+  writer->last_line_ = NULL;
+  writer->last_line_size_ = 0;
+  writer->written_bytes_ = 0;
+  writer->flushed_bytes_ = 0;
+  pthread_mutex_init(&writer->flushed_lock_, NULL);
+  if (sem_init(&writer->filled_, 0, 0) != 0 ||
+      sem_init(&writer->free_, 0, BATCH_WRITER_QUEUE_SIZE) != 0 ||
+      pthread_create(&writer->thread_, NULL, RunWriter, writer) != 0) {
+    ErrorOut("Unable to start the batch writer.");
+  }
+}
+
+void BatchWriterAppend(const char* data, size_t size, BatchWriter* writer) {
+  if (size == 0) {
+    return;
+  }
+  char* copy = malloc(size);
+  if (copy == NULL) {
+    ErrorOut("Unable to allocate space for queued output.");
+  }
+  memcpy(copy, data, size);
+  Push(copy, size, writer);
+}
+
+size_t BatchWriterFlushedBytes(BatchWriter* writer) {
+  pthread_mutex_lock(&writer->flushed_lock_);
+  size_t flushed_bytes = writer->flushed_bytes_;
+  pthread_mutex_unlock(&writer->flushed_lock_);
+  return flushed_bytes;
+}
+
+void BatchWriterClose(BatchWriter* writer) {
+  // An entry with no data tells the writer thread to finish.
+  Push(NULL, 0, writer);
+  pthread_join(writer->thread_, NULL);
+  if (fclose(writer->out_) != 0) {
+    ErrorOut("Unable to close the output file.");
+  }
+  sem_destroy(&writer->filled_);
+  sem_destroy(&writer->free_);
+  pthread_mutex_destroy(&writer->flushed_lock_);
+  free(writer->last_line_);
+  writer->last_line_ = NULL;
+}
+
+static void CatchStop(int signal_number) {
+  stop_requested = 1;
+}
+
+void BatchWriterCatchSignals(void) {
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = CatchStop;
+  action.sa_flags = SA_RESETHAND;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+}
+
+int BatchWriterStopRequested(void) {
+  return stop_requested;
+}
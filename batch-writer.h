@@ -0,0 +1,85 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BATCH_WRITER_H
+#define BATCH_WRITER_H
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+
+// Appends text to a file on a thread of its own, so that whoever produces
+// the text never waits on the disk. Text is handed over through a ring that
+// only the producer adds to and only the writer thread takes from, so no
+// lock is needed. Written text is flushed and synced to disk once a set
+// number of lines are waiting or a set time has passed, whichever is first.
+
+#define BATCH_WRITER_QUEUE_SIZE 64
+
+typedef struct {
+  char* data;
+  size_t size;
+} BatchWriterEntry;
+
+typedef struct {
+  FILE* out_;
+  int flush_lines_;
+  int flush_ms_;
+  BatchWriterEntry entries_[BATCH_WRITER_QUEUE_SIZE];
+  // Only the producer moves head_ and only the writer thread moves tail_.
+  long head_;
+  long tail_;
+  // Count the entries waiting in the ring and the free places left in it.
+  sem_t filled_;
+  sem_t free_;
+  pthread_t thread_;
+  // The last line written, reported after each flush.
+  char* last_line_;
+  size_t last_line_size_;
+  // Bytes written so far, and how many of them have been flushed. Only the
+  // writer thread touches written_bytes_, and flushed_bytes_ is read under
+  // flushed_lock_.
+  size_t written_bytes_;
+  size_t flushed_bytes_;
+  pthread_mutex_t flushed_lock_;
+} BatchWriter;
+
+// Opens filename for appending and starts the writer thread. Text is flushed
+// once flush_lines lines are waiting or flush_ms milliseconds after the
+// first of them was written. Either may be 0 to leave it out.
+void BatchWriterOpen(char* filename, int flush_lines, int flush_ms,
+                     BatchWriter* writer);
+
+// Queues a copy of the text, which must be made of whole lines, to be
+// appended to the file.
+void BatchWriterAppend(const char* data, size_t size, BatchWriter* writer);
+
+// Returns how many bytes of the queued text have been flushed to the file.
+// Those bytes are whole lines, so the file may be read up to there through
+// another handle while more is being written.
+size_t BatchWriterFlushedBytes(BatchWriter* writer);
+
+// Writes out everything that was queued, flushes it and closes the file.
+void BatchWriterClose(BatchWriter* writer);
+
+// Catches SIGINT and SIGTERM so that the program can stop cleanly instead of
+// being killed part way through a write. A second signal is not caught.
+void BatchWriterCatchSignals(void);
+
+// Returns 1 once SIGINT or SIGTERM has been caught.
+int BatchWriterStopRequested(void);
+
+#endif
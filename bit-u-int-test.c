@@ -27,9 +27,9 @@ void Check(int condition, char* message) {
 }
 
 void CheckBitUInt(char* expected, BitUInt* this, char* message) {
-  char buffer[100];
-  BitUIntStore(this, 100, buffer);
-  Check(0 == strncmp(expected, buffer, 100), message);
+  char buffer[256];
+  BitUIntStore(this, 256, buffer);
+  Check(0 == strncmp(expected, buffer, 256), message);
 }
 
 void TestLoadAndStore() {
@@ -37,23 +37,23 @@ void TestLoadAndStore() {
 
   char* example = "0101";
   BitUIntLoad(strlen(example), example, &a);
-  Check(a.bits[0] == 0, "loaded bit 0 should be 0");
-  Check(a.bits[1] == 1, "loaded bit 1 should be 1");
-  Check(a.bits[2] == 0, "loaded bit 2 should be 0");
-  Check(a.bits[3] == 1, "loaded bit 3 should be 1");
+  Check(BitUIntGetBit(0, &a) == 0, "loaded bit 0 should be 0");
+  Check(BitUIntGetBit(1, &a) == 1, "loaded bit 1 should be 1");
+  Check(BitUIntGetBit(2, &a) == 0, "loaded bit 2 should be 0");
+  Check(BitUIntGetBit(3, &a) == 1, "loaded bit 3 should be 1");
   Check(a.num_bits == 4, "loaded num bits should be 4");
 
   example = "10121001";
   BitUIntLoad(strlen(example), example, &a);
-  Check(a.bits[0] == 1, "loaded bit 0 should be 1");
-  Check(a.bits[1] == 0, "loaded bit 1 should be 0");
-  Check(a.bits[3] == 1, "loaded bit 2 should be 1");
+  Check(BitUIntGetBit(0, &a) == 1, "loaded bit 0 should be 1");
+  Check(BitUIntGetBit(1, &a) == 0, "loaded bit 1 should be 0");
+  Check(BitUIntGetBit(2, &a) == 1, "loaded bit 2 should be 1");
   Check(a.num_bits == 3, "loaded num bits should be 3");
 
   example = "010000";
   BitUIntLoad(strlen(example), example, &a);
-  Check(a.bits[0] == 0, "load and trim bit 0 should be 0");
-  Check(a.bits[1] == 1, "load and trim bit 1 should be 1");
+  Check(BitUIntGetBit(0, &a) == 0, "load and trim bit 0 should be 0");
+  Check(BitUIntGetBit(1, &a) == 1, "load and trim bit 1 should be 1");
   Check(a.num_bits == 2, "loaded num bits should be 2");
 
   char buffer[30];
@@ -70,11 +70,11 @@ void TestClone() {
   char* example = "11101";
   BitUIntLoad(strlen(example), example, &a);
   BitUIntClone(&a, &b);
-  Check(b.bits[0] == 1, "clone bit 0 should be 1");
-  Check(b.bits[1] == 1, "clone bit 1 should be 1");
-  Check(b.bits[2] == 1, "clone bit 2 should be 1");
-  Check(b.bits[3] == 0, "clone bit 3 should be 0");
-  Check(b.bits[4] == 1, "clone bit 4 should be 1");
+  Check(BitUIntGetBit(0, &b) == 1, "clone bit 0 should be 1");
+  Check(BitUIntGetBit(1, &b) == 1, "clone bit 1 should be 1");
+  Check(BitUIntGetBit(2, &b) == 1, "clone bit 2 should be 1");
+  Check(BitUIntGetBit(3, &b) == 0, "clone bit 3 should be 0");
+  Check(BitUIntGetBit(4, &b) == 1, "clone bit 4 should be 1");
   Check(b.num_bits == 5, "cloned num bits should be 5");
 }
 
@@ -396,6 +396,75 @@ void TestApproximateSquareRoot() {
 }
 
 
+void TestGetAndSetBit() {
+  BitUInt a;
+  a.num_bits = 0;
+  BitUIntSetBit(1, 70, &a);
+  Check(71 == a.num_bits, "setting bit 70 should give 71 bits");
+  Check(1 == BitUIntGetBit(70, &a), "bit 70 should be set");
+  Check(0 == BitUIntGetBit(3, &a), "bit 3 should be clear");
+  Check(0 == BitUIntGetBit(100, &a), "bits past the top should be clear");
+
+  BitUIntSetBit(1, 3, &a);
+  BitUIntSetBit(0, 70, &a);
+  CheckBitUInt("0001", &a, "clearing the top bit should trim");
+}
+
+void TestAcrossWords() {
+  BitUInt a, b, q, r;
+  char all_ones[131];
+  char expected[140];
+
+  // 2^130 - 1 carries through two full words when incremented.
+  memset(all_ones, '1', 130);
+  all_ones[130] = '\0';
+  BitUIntLoad(130, all_ones, &a);
+  BitUIntInc(&a);
+  memset(expected, '0', 130);
+  strcpy(expected + 130, "1");
+  CheckBitUInt(expected, &a, "2^130 - 1 plus 1 should be 2^130");
+  BitUIntDec(&a);
+  CheckBitUInt(all_ones, &a, "2^130 minus 1 should be 2^130 - 1");
+
+  // Shifts that cross word boundaries.
+  char* b_str = "1011";
+  BitUIntLoad(strlen(b_str), b_str, &b);
+  BitUIntShiftInc(125, &b);
+  memset(expected, '0', 125);
+  strcpy(expected + 125, "1011");
+  CheckBitUInt(expected, &b, "shifting 1011 up by 125 bits");
+  BitUIntDouble(&b);
+  BitUIntShiftDec(63, &b);
+  memset(expected, '0', 63);
+  strcpy(expected + 63, "1011");
+  CheckBitUInt(expected, &b, "shifting 1011 back down across a word");
+
+  // (2^130 - 1) + 13 * 2^63 carries out of the top word, and subtracting
+  // gets back to where it started.
+  BitUIntAdd(&b, &a);
+  Check(131 == a.num_bits, "sum should carry into bit 130");
+  Check(-1 == BitUIntCompare(&a, &b), "sum should be larger than b");
+  BitUIntSub(&b, &a);
+  CheckBitUInt(all_ones, &a, "subtracting b should undo the addition");
+
+  // (2^130 - 1) / (2^65 - 1) = 2^65 + 1 with no remainder.
+  memset(expected, '1', 65);
+  expected[65] = '\0';
+  BitUIntLoad(65, expected, &b);
+  BitUIntDiv(&a, &b, &q, &r);
+  memset(expected, '0', 66);
+  expected[0] = '1';
+  strcpy(expected + 65, "1");
+  CheckBitUInt(expected, &q, "(2^130 - 1) / (2^65 - 1) should be 2^65 + 1");
+  Check(0 == r.num_bits, "2^65 - 1 should divide 2^130 - 1");
+  BitUIntDec(&a);
+  BitUIntMod(&a, &b, &r);
+  memset(expected, '1', 65);
+  expected[0] = '0';
+  expected[65] = '\0';
+  CheckBitUInt(expected, &r, "(2^130 - 2) mod (2^65 - 1) should be 2^65 - 2");
+}
+
 int main() {
   TestLoadAndStore();
   TestClone();
@@ -410,5 +479,7 @@ int main() {
   TestMod();
   TestBase10Store();
   TestApproximateSquareRoot();
+  TestGetAndSetBit();
+  TestAcrossWords();
   printf("All tests passed\n");
 }
@@ -20,10 +20,72 @@
 #include <stdio.h>
 #include <string.h>
 
+// The number of words needed to hold num_bits bits.
+static int NumWords(const BitUInt* this) {
+  return (this->num_bits + 63) >> 6;
+}
+
+static int BitAt(int index, const BitUInt* this) {
+  return (this->words[index >> 6] >> (index & 63)) & 1;
+}
+
+// Sets num_bits to the trimmed length of the value held in the lowest
+// num_words words.
+static void TrimWords(int num_words, BitUInt* this) {
+  while (num_words > 0 && this->words[num_words - 1] == 0) {
+    num_words--;
+  }
+  if (num_words == 0) {
+    this->num_bits = 0;
+    return;
+  }
+  this->num_bits =
+      (num_words - 1) * 64 + 64 - __builtin_clzll(this->words[num_words - 1]);
+}
+
+// Moves the value up by num_bits bits, growing num_bits to match. Each word is
+// built from two source words, the lower one supplying the carried in bits.
+static void ShiftUp(int num_bits, BitUInt* this) {
+  int old_words = NumWords(this);
+  int word_shift = num_bits >> 6;
+  int bit_shift = num_bits & 63;
+  this->num_bits += num_bits;
+  int i;
+  for (i = NumWords(this) - 1; i >= 0; i--) {
+    int source = i - word_shift;
+    uint64_t value = 0;
+    if (source >= 0 && source < old_words) {
+      value = this->words[source] << bit_shift;
+    }
+    if (bit_shift > 0 && source - 1 >= 0 && source - 1 < old_words) {
+      value |= this->words[source - 1] >> (64 - bit_shift);
+    }
+    this->words[i] = value;
+  }
+}
+
+// Moves the value down by num_bits bits, dropping the low order bits and
+// shrinking num_bits to match.
+static void ShiftDown(int num_bits, BitUInt* this) {
+  int old_words = NumWords(this);
+  int word_shift = num_bits >> 6;
+  int bit_shift = num_bits & 63;
+  this->num_bits -= num_bits;
+  int i;
+  for (i = 0; i < NumWords(this); i++) {
+    int source = i + word_shift;
+    uint64_t value = this->words[source] >> bit_shift;
+    if (bit_shift > 0 && source + 1 < old_words) {
+      value |= this->words[source + 1] << (64 - bit_shift);
+    }
+    this->words[i] = value;
+  }
+}
+
 void BitUIntPrint(const BitUInt* this) {
   int i;
   for (i = 0; i < this->num_bits; i++) {
-    printf("%i", this->bits[i]);
+    printf("%i", BitAt(i, this));
   }
 }
 
@@ -37,11 +99,12 @@ void BitUIntLoad(int buffer_size, char* buffer, BitUInt* this) {
   int i;
   char current;
   this->num_bits = 0;
+  memset(this->words, 0, sizeof(this->words));
   for (i = 0; i < buffer_size; i++) {
     assert(i < MAX_NUM_BIT_U_INT_BITS);
     current = buffer[i];
     if (current == '0' || current == '1') {
-      this->bits[i] = current - '0';
+      this->words[i >> 6] |= (uint64_t) (current - '0') << (i & 63);
       this->num_bits++;
     } else {
       break;
@@ -54,7 +117,7 @@ void BitUIntStore(const BitUInt* this, int buffer_size, char* buffer) {
   assert(this->num_bits < buffer_size);
   int i;
   for (i = 0; i < this->num_bits; i++) {
-    buffer[i] = this->bits[i] + '0';
+    buffer[i] = BitAt(i, this) + '0';
   }
   buffer[i] = 0;
 }
@@ -62,25 +125,18 @@ void BitUIntStore(const BitUInt* this, int buffer_size, char* buffer) {
 void BitUIntBase10Store(const BitUInt* this, int buffer_size, char* buffer) {
   char internal_buffer[BASE_10_BIT_U_INT_BUFFER_SIZE];
   int num_digits = 0;
-  int i, power;
+  int i;
   BitUInt reduced_this;
   BitUInt quotient;
   BitUInt remainder;
   BitUInt ten;
-  ten.num_bits = 4;
-  ten.bits[0] = 0;
-  ten.bits[1] = 1;
-  ten.bits[2] = 0;
-  ten.bits[3] = 1;
+  BitUIntLoad(4, "0101", &ten);
 
   BitUIntDiv(this, &ten, &quotient, &remainder);
   while (remainder.num_bits > 0 || quotient.num_bits > 0) {
-    internal_buffer[num_digits] = 0;
-    power = 1;
-    for (i = 0; i < remainder.num_bits; i++) {
-      internal_buffer[num_digits] += remainder.bits[i] * power;
-      power *= 2;
-    }
+    // The remainder is less than ten so it is all in the lowest word.
+    internal_buffer[num_digits] =
+        remainder.num_bits == 0 ? 0 : remainder.words[0];
     BitUIntClone(&quotient, &reduced_this);
     num_digits++;
     BitUIntDiv(&reduced_this, &ten, &quotient, &remainder);
@@ -94,67 +150,86 @@ void BitUIntBase10Store(const BitUInt* this, int buffer_size, char* buffer) {
   buffer[i] = '\0';
 }
 
+int BitUIntGetBit(int index, const BitUInt* this) {
+  assert(index >= 0);
+  if (index >= this->num_bits) {
+    return 0;
+  }
+  return BitAt(index, this);
+}
+
+void BitUIntSetBit(int value, int index, BitUInt* this) {
+  assert(value == 0 || value == 1);
+  assert(index >= 0 && index < MAX_NUM_BIT_U_INT_BITS);
+  if (index >= this->num_bits) {
+    if (value == 0) {
+      return;
+    }
+    int i;
+    for (i = NumWords(this); i <= index >> 6; i++) {
+      this->words[i] = 0;
+    }
+    this->num_bits = index + 1;
+  }
+  if (value) {
+    this->words[index >> 6] |= (uint64_t) 1 << (index & 63);
+  } else {
+    this->words[index >> 6] &= ~((uint64_t) 1 << (index & 63));
+    BitUIntTrim(this);
+  }
+}
 
 void BitUIntClone(const BitUInt* that, BitUInt* this) {
   this->num_bits = that->num_bits;
-  int i;
-  for (i = 0; i < that->num_bits; i++) {
-    this->bits[i] = that->bits[i];
-  }
+  memmove(this->words, that->words, NumWords(that) * sizeof(uint64_t));
 }
 
 void BitUIntTrim(BitUInt* this) {
-  while (this->num_bits > 0 && this->bits[this->num_bits - 1] == 0) {
-    this->num_bits--;
-  }
+  TrimWords(NumWords(this), this);
 }
 
 void BitUIntInc(BitUInt* this) {
+  int num_words = NumWords(this);
   int i;
-  for (i = 0; i < this->num_bits; i++) {
-    if (this->bits[i] == 1) {
-      this->bits[i] = 0;
-    } else {
-      this->bits[i] = 1;
-    	  return;
+  // Stop at the first word that does not wrap around to zero.
+  for (i = 0; i < num_words; i++) {
+    this->words[i]++;
+    if (this->words[i] != 0) {
+      break;
     }
   }
-  this->num_bits++;
-  this->bits[i] = 1;
+  if (i == num_words) {
+    assert(num_words < NUM_BIT_U_INT_WORDS);
+    this->words[num_words] = 1;
+    num_words++;
+  }
+  TrimWords(num_words, this);
 }
 
 void BitUIntDec(BitUInt* this) {
   assert(this->num_bits > 0);
+  int num_words = NumWords(this);
   int i;
-  for (i = 0; i < this->num_bits; i++) {
-    if (this->bits[i] == 1) {
-      this->bits[i] = 0;
-      BitUIntTrim(this);
-      return;
-    } else {
-      this->bits[i] = 1;
+  // Borrow through the low words that are zero.
+  for (i = 0; i < num_words; i++) {
+    if (this->words[i]-- != 0) {
+      break;
     }
   }
+  TrimWords(num_words, this);
 }
 
 void BitUIntDouble(BitUInt* this) {
   assert(this->num_bits < MAX_NUM_BIT_U_INT_BITS);
-  int i;
-  this->num_bits++;
-  for (i = this->num_bits - 1; i >= 1; i--) {
-    this->bits[i] = this->bits[i - 1];
+  if (this->num_bits > 0) {
+    ShiftUp(1, this);
   }
-  this->bits[0] = 0;
 }
 
 int BitUIntHalve(BitUInt* this) {
   if (this->num_bits > 0) {
-    int low_bit = this->bits[0];
-    int i;
-    for (i = 1; i < this->num_bits; i++) {
-      this->bits[i - 1] = this->bits[i];
-    }
-    this->num_bits--;
+    int low_bit = this->words[0] & 1;
+    ShiftDown(1, this);
     return low_bit;
   } else {
     return 0;
@@ -166,66 +241,55 @@ void BitUIntShiftInc(int num_bits, BitUInt* this) {
   if (this->num_bits == 0) {
     return;
   }
-  int i;
-  for (i = this->num_bits - 1; i >= 0; i--) {
-    this->bits[i + num_bits] = this->bits[i];
-  }
-  this->num_bits += num_bits;
-  memset(this->bits, 0, num_bits); 
+  ShiftUp(num_bits, this);
 }
 
 void BitUIntShiftDec(int num_bits, BitUInt* this) {
   assert(this->num_bits - num_bits >= 0);
-  this->num_bits -= num_bits;
-  int i;
-  for (i = 0; i < this->num_bits; i++) {
-    this->bits[i] = this->bits[i + num_bits];
-  }
+  ShiftDown(num_bits, this);
 }
 
 void BitUIntAdd(BitUInt* that, BitUInt* this) {
-  int carry = 0;
-  int sum;
+  int this_words = NumWords(this);
+  int that_words = NumWords(that);
+  int num_words = this_words > that_words ? this_words : that_words;
   int i;
-  for (i = 0; i < that->num_bits || i < this->num_bits; i++) {
-    if (i < that->num_bits && i < this->num_bits) {
-      sum = this->bits[i] + that->bits[i] + carry;
-      carry = sum > 1;
-      this->bits[i] = sum & 1;
-    } else if (i < that->num_bits) {
-      sum = that->bits[i] + carry;
-      carry = sum > 1;
-      this->bits[i] = sum & 1;
-      this->num_bits++;
-    } else if (i < this->num_bits) {
-      sum = this->bits[i] + carry;
-      carry = sum > 1;
-      this->bits[i] = sum & 1;
+  for (i = this_words; i < num_words; i++) {
+    this->words[i] = 0;
+  }
+  uint64_t carry = 0;
+  unsigned __int128 sum;
+  for (i = 0; i < num_words; i++) {
+    sum = (unsigned __int128) this->words[i] + carry;
+    if (i < that_words) {
+      sum += that->words[i];
     }
+    this->words[i] = (uint64_t) sum;
+    carry = (uint64_t) (sum >> 64);
   }
   if (carry) {
-    this->bits[i] = 1;
-    this->num_bits++;
+    assert(num_words < NUM_BIT_U_INT_WORDS);
+    this->words[num_words] = carry;
+    num_words++;
   }
+  TrimWords(num_words, this);
 }
 
 void BitUIntSub(const BitUInt* that, BitUInt* this) {
   assert(BitUIntLessThanOrEqual(that, this));
+  int num_words = NumWords(this);
+  int that_words = NumWords(that);
+  uint64_t borrow = 0;
+  uint64_t subtrahend;
   int i;
-  int borrow = 0;
-  int diff;
-  for (i = 0; i < that->num_bits || i < this->num_bits; i++) {
-    if (i < that->num_bits && i < this->num_bits) {
-      diff = this->bits[i] - that->bits[i] - borrow;
-      borrow = diff < 0;
-      this->bits[i] = diff & 1;
-    } else if (i < this->num_bits) {
-      diff = this->bits[i] - borrow;
-      borrow = diff < 0;
-      this->bits[i] = diff & 1;
-    } 
+  for (i = 0; i < num_words; i++) {
+    subtrahend = i < that_words ? that->words[i] : 0;
+    uint64_t diff = this->words[i] - subtrahend - borrow;
+    borrow = this->words[i] < subtrahend ||
+             (this->words[i] == subtrahend && borrow);
+    this->words[i] = diff;
   }
-  BitUIntTrim(this);
+  TrimWords(num_words, this);
 }
 
 void BitUIntMul(const BitUInt* that, BitUInt* this) {
@@ -240,7 +304,7 @@ void BitUIntMul(const BitUInt* that, BitUInt* this) {
   // each position.
   for (i = that->num_bits - 2; i >= 0; i--) {
     BitUIntDouble(this);
-    if (that->bits[i]) {
+    if (BitAt(i, that)) {
       BitUIntAdd(&original_this, this);
     }
   }
@@ -260,7 +324,7 @@ void BitUIntDiv(const BitUInt* numerator, const BitUInt* denominator,
   BitUIntClone(denominator, &multiplied_denominator);
   int num_shifts;
   quotient->num_bits = remainder->num_bits - multiplied_denominator.num_bits + 1;
-  memset(quotient->bits, 0, quotient->num_bits);
+  memset(quotient->words, 0, NumWords(quotient) * sizeof(uint64_t));
   while (BitUIntLessThanOrEqual(denominator, remainder)) {
     num_shifts = remainder->num_bits - multiplied_denominator.num_bits;
     BitUIntShiftInc(num_shifts, &multiplied_denominator);
@@ -269,7 +333,7 @@ void BitUIntDiv(const BitUInt* numerator, const BitUInt* denominator,
       BitUIntHalve(&multiplied_denominator);
     }
     BitUIntSub(&multiplied_denominator, remainder);
-    quotient->bits[num_shifts] = 1;
+    quotient->words[num_shifts >> 6] |= (uint64_t) 1 << (num_shifts & 63);
     BitUIntClone(denominator, &multiplied_denominator);
   }
 
@@ -301,9 +365,7 @@ void BitUIntMod(const BitUInt* numerator, const BitUInt* denominator,
 
 void BitUIntApproximateSquareRoot(const BitUInt* this, BitUInt* root) {
   BitUInt two;
-  two.num_bits = 2;
-  two.bits[0] = 0;
-  two.bits[1] = 1;
+  BitUIntLoad(2, "01", &two);
 
   BitUInt remainder;
   BitUInt estimate;
@@ -350,9 +412,10 @@ int BitUIntCompare(const BitUInt* this, const BitUInt* that) {
   }
 
   int i;
-  for (i = this->num_bits - 1; i >= 0; i--) {
-    if (this->bits[i] != that->bits[i]) {
-      return this->bits[i] < that->bits[i] ? 1 : -1;
+  // Start with the most significant word.
+  for (i = NumWords(this) - 1; i >= 0; i--) {
+    if (this->words[i] != that->words[i]) {
+      return this->words[i] < that->words[i] ? 1 : -1;
     }
   }
   return 0;
@@ -26,9 +26,14 @@
 // terminator. This should be a safe overestimate.
 #define BASE_10_BIT_U_INT_BUFFER_SIZE MAX_NUM_BIT_U_INT_BITS / 3 + 1
 
+// Bits are packed 64 to a word, least significant word first, so bit i of the
+// number is bit i % 64 of words[i / 64]. Any bits of the highest word at or
+// above num_bits are always zero.
+#define NUM_BIT_U_INT_WORDS ((MAX_NUM_BIT_U_INT_BITS + 63) / 64)
+
 typedef struct {
   int num_bits;
-  uint8_t bits[MAX_NUM_BIT_U_INT_BITS];
+  uint64_t words[NUM_BIT_U_INT_WORDS];
 } BitUInt;
 
 // Sends the binary representation of the integer to stdout. The bits are
@@ -52,6 +57,12 @@ void BitUIntStore(const BitUInt* this, int buffer_size, char* buffer);
 // first.
 void BitUIntBase10Store(const BitUInt* this, int buffer_size, char* buffer);
 
+// Retrieves one bit, returning 0 for any index at or above num_bits.
+int BitUIntGetBit(int index, const BitUInt* this);
+
+// Sets one bit to 0 or 1, growing or trimming num_bits as needed.
+void BitUIntSetBit(int value, int index, BitUInt* this);
+
 // Copies the value from the first argument into the second argument.
 void BitUIntClone(const BitUInt* that, BitUInt* this);
 
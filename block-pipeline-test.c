@@ -0,0 +1,123 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "block-pipeline.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define NUM_TEST_BLOCKS 200
+
+void Check(int condition, char* message) {
+  if (!condition) {
+    fprintf(stderr, "Condition failed: %s\n", message);
+    exit(1);
+  }
+}
+
+typedef struct {
+  long end_block;
+  long next_commit;
+  int in_order;
+  atomic_int num_exits;
+} TestContext;
+
+// Writes the block number as text, after sleeping for a varying time so that
+// blocks finish out of order.
+int WriteBlockNumber(long block, void* context, BlockOutput* output) {
+  TestContext* test = context;
+  if (block >= test->end_block) {
+    return 0;
+  }
+  struct timespec delay = {0, (block * 7919 % 13) * 100000};
+  nanosleep(&delay, NULL);
+  char buffer[32];
+  int size = sprintf(buffer, "%ld", block);
+  BlockOutputAppend(buffer, size, output);
+  return 1;
+}
+
+// Ends the work at end_block alone, as a block that sees a stop request
+// does, while later blocks still do their work.
+int StopAtBlock(long block, void* context, BlockOutput* output) {
+  TestContext* test = context;
+  if (block == test->end_block) {
+    return 0;
+  }
+  char buffer[32];
+  int size = sprintf(buffer, "%ld", block);
+  BlockOutputAppend(buffer, size, output);
+  return 1;
+}
+
+void CheckBlockNumber(long block, const BlockOutput* output, void* context) {
+  TestContext* test = context;
+  char buffer[32];
+  int size = sprintf(buffer, "%ld", block);
+  if (block != test->next_commit || output->size != size ||
+      memcmp(output->data, buffer, size) != 0) {
+    test->in_order = 0;
+  }
+  test->next_commit++;
+}
+
+void CountExit(void* context) {
+  TestContext* test = context;
+  atomic_fetch_add(&test->num_exits, 1);
+}
+
+void TestCommitOrder(int num_threads, long end_block) {
+  TestContext test = {end_block, 0, 1};
+  RunBlockPipeline(num_threads, WriteBlockNumber, CheckBlockNumber, CountExit,
+                   &test);
+  Check(test.in_order, "Blocks should be committed in order.");
+  Check(test.next_commit == end_block,
+        "Every block before the end should be committed.");
+  Check(atomic_load(&test.num_exits) == num_threads,
+        "Every worker should report its exit.");
+}
+
+void TestStopEarly() {
+  TestContext test = {50, 0, 1};
+  RunBlockPipeline(4, StopAtBlock, CheckBlockNumber, NULL, &test);
+  Check(test.in_order, "Blocks should be committed in order.");
+  Check(test.next_commit == 50,
+        "Blocks after the one that stopped should be dropped.");
+}
+
+void TestBlockOutputAppend() {
+  BlockOutput output = {NULL, 0, 0};
+  int i;
+  for (i = 0; i < 5000; i++) {
+    BlockOutputAppend("ab", 2, &output);
+  }
+  Check(output.size == 10000, "Output should hold every append.");
+  Check(output.capacity >= output.size, "Output should have grown.");
+  Check(memcmp(output.data + 9998, "ab", 2) == 0,
+        "Output should keep appends in order.");
+  free(output.data);
+}
+
+int main() {
+  TestBlockOutputAppend();
+  TestCommitOrder(1, NUM_TEST_BLOCKS);
+  TestCommitOrder(4, NUM_TEST_BLOCKS);
+  TestCommitOrder(4, 0);
+  TestCommitOrder(3, 1);
+  TestStopEarly();
+  printf("All tests passed\n");
+}
@@ -0,0 +1,168 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "block-pipeline.h"
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The reorder buffer holds this many blocks for each worker thread.
+#define BLOCKS_PER_THREAD 4
+
+typedef struct {
+  BlockOutput output;
+  // Set once the block's work is done, cleared once it is committed.
+  int done;
+} Slot;
+
+typedef struct {
+  BlockWork work;
+  BlockWorkerExit worker_exit;
+  void* context;
+  int num_slots;
+  Slot* slots;
+
+  pthread_mutex_t lock;
+  // Signalled when a block finishes or the end is found.
+  pthread_cond_t block_done;
+  // Signalled when a block is committed, freeing its slot.
+  pthread_cond_t slot_free;
+  long next_block;
+  long next_commit;
+  // The first block that is past the end of the work.
+  long end_block;
+} Pipeline;
+
+// Exits the program after sending the message to stderr.
+static void ErrorOut(char* message) {
+  fprintf(stderr, "%s\n", message);
+  exit(1);
+}
+
+void BlockOutputAppend(const char* data, size_t size, BlockOutput* output) {
+  if (output->size + size > output->capacity) {
+    size_t capacity = output->capacity == 0 ? 4096 : 2 * output->capacity;
+    while (capacity < output->size + size) {
+      capacity *= 2;
+    }
+    output->data = realloc(output->data, capacity);
+    if (output->data == NULL) {
+      ErrorOut("Unable to allocate space for block output.");
+    }
+    output->capacity = capacity;
+  }
+  memcpy(output->data + output->size, data, size);
+  output->size += size;
+}
+
+static void* RunWorker(void* arg) {
+  Pipeline* pipeline = arg;
+  pthread_mutex_lock(&pipeline->lock);
+  while (1) {
+    // Wait for the block's slot to be committed from its last use.
+    while (pipeline->next_block < pipeline->end_block &&
+           pipeline->next_block >=
+               pipeline->next_commit + pipeline->num_slots) {
+      pthread_cond_wait(&pipeline->slot_free, &pipeline->lock);
+    }
+    if (pipeline->next_block >= pipeline->end_block) {
+      break;
+    }
+    long block = pipeline->next_block;
+    pipeline->next_block++;
+    Slot* slot = &pipeline->slots[block % pipeline->num_slots];
+    pthread_mutex_unlock(&pipeline->lock);
+
+    slot->output.size = 0;
+    int more = pipeline->work(block, pipeline->context, &slot->output);
+
+    pthread_mutex_lock(&pipeline->lock);
+    if (more) {
+      slot->done = 1;
+    } else if (block < pipeline->end_block) {
+      pipeline->end_block = block;
+      // Wake any workers waiting for slots beyond the end.
+      pthread_cond_broadcast(&pipeline->slot_free);
+    }
+    pthread_cond_broadcast(&pipeline->block_done);
+  }
+  pthread_mutex_unlock(&pipeline->lock);
+  if (pipeline->worker_exit != NULL) {
+    pipeline->worker_exit(pipeline->context);
+  }
+  return NULL;
+}
+
+void RunBlockPipeline(int num_threads, BlockWork work, BlockCommit commit,
+                      BlockWorkerExit worker_exit, void* context) {
+  if (num_threads < 1) {
+    ErrorOut("The block pipeline needs at least one thread.");
+  }
+  Pipeline pipeline;
+  pipeline.work = work;
+  pipeline.worker_exit = worker_exit;
+  pipeline.context = context;
+  pipeline.num_slots = BLOCKS_PER_THREAD * num_threads;
+  pipeline.slots = calloc(pipeline.num_slots, sizeof(Slot));
+  pthread_t* threads = malloc(num_threads * sizeof(pthread_t));
+  if (pipeline.slots == NULL || threads == NULL) {
+    ErrorOut("Unable to allocate space for the block pipeline.");
+  }
+  pthread_mutex_init(&pipeline.lock, NULL);
+  pthread_cond_init(&pipeline.block_done, NULL);
+  pthread_cond_init(&pipeline.slot_free, NULL);
+  pipeline.next_block = 0;
+  pipeline.next_commit = 0;
+  pipeline.end_block = LONG_MAX;
+
+  int i;
+  for (i = 0; i < num_threads; i++) {
+    if (pthread_create(&threads[i], NULL, RunWorker, &pipeline) != 0) {
+      ErrorOut("Unable to start a worker thread.");
+    }
+  }
+
+  // Commit blocks in order as they finish.
+  pthread_mutex_lock(&pipeline.lock);
+  while (pipeline.next_commit < pipeline.end_block) {
+    Slot* slot = &pipeline.slots[pipeline.next_commit % pipeline.num_slots];
+    if (!slot->done) {
+      pthread_cond_wait(&pipeline.block_done, &pipeline.lock);
+      continue;
+    }
+    pthread_mutex_unlock(&pipeline.lock);
+    commit(pipeline.next_commit, &slot->output, context);
+    pthread_mutex_lock(&pipeline.lock);
+    slot->done = 0;
+    pipeline.next_commit++;
+    pthread_cond_broadcast(&pipeline.slot_free);
+  }
+  pthread_mutex_unlock(&pipeline.lock);
+
+  for (i = 0; i < num_threads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  for (i = 0; i < pipeline.num_slots; i++) {
+    free(pipeline.slots[i].output.data);
+  }
+  free(pipeline.slots);
+  free(threads);
+  pthread_mutex_destroy(&pipeline.lock);
+  pthread_cond_destroy(&pipeline.block_done);
+  pthread_cond_destroy(&pipeline.slot_free);
+}
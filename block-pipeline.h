@@ -0,0 +1,60 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef BLOCK_PIPELINE_H
+#define BLOCK_PIPELINE_H
+
+#include <stddef.h>
+
+// Splits work into numbered blocks that worker threads take in increasing
+// order, while the output of each block is committed strictly in block order.
+// Finished blocks wait in a reorder buffer until every block before them has
+// been committed, so whatever the commit step writes is always a complete
+// prefix of the sequential result.
+
+// The output of one block, appended to by the worker that runs it.
+typedef struct {
+  char* data;
+  size_t size;
+  size_t capacity;
+} BlockOutput;
+
+// Adds size bytes of data to the end of the output.
+void BlockOutputAppend(const char* data, size_t size, BlockOutput* output);
+
+// Fills output with the result of the given block and returns 1, or returns 0
+// if the block is past the end of the work. The first block to return 0 ends
+// the work, and the output of any later blocks is dropped, so a block may
+// also return 0 to stop the work early. Called on the worker threads, any
+// number at a time.
+typedef int (*BlockWork)(long block, void* context, BlockOutput* output);
+
+// Receives the output of each block. Called on the thread that started the
+// pipeline, once for each block in increasing order.
+typedef void (*BlockCommit)(long block, const BlockOutput* output,
+                            void* context);
+
+// Called on each worker thread just before it exits, for example to release
+// per-thread storage that the work built up.
+typedef void (*BlockWorkerExit)(void* context);
+
+// Runs work for blocks 0, 1, 2, ... on num_threads worker threads and commits
+// their output in order, returning after the last block before the end has
+// been committed. Workers run at most four blocks per thread ahead of the
+// oldest block that has not been committed. worker_exit may be NULL.
+void RunBlockPipeline(int num_threads, BlockWork work, BlockCommit commit,
+                      BlockWorkerExit worker_exit, void* context);
+
+#endif
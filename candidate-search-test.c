@@ -0,0 +1,161 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "candidate-search.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+void Check(int condition, char* message) {
+  if (!condition) {
+    fprintf(stderr, "Condition failed: %s\n", message);
+    exit(1);
+  }
+}
+
+// The nearest prime at or above value, found by plain trial division.
+uint64_t NextPrime(uint64_t value) {
+  while (1) {
+    int is_prime = value >= 2;
+    uint64_t divisor;
+    for (divisor = 2; divisor * divisor <= value && is_prime; divisor++) {
+      is_prime = value % divisor != 0;
+    }
+    if (is_prime) {
+      return value;
+    }
+    value++;
+  }
+}
+
+// Searches up from value and returns the prime found.
+uint64_t SearchFrom(uint64_t value, int num_threads, int probable) {
+  LargeUInt candidate = {0};
+  LargeUIntSetWord(value, &candidate);
+  if (probable) {
+    CandidateSearchProbablePrime(&candidate);
+  } else {
+    CandidateSearchPrime(num_threads, NULL, &candidate);
+  }
+  uint64_t prime = LargeUIntGetWord(&candidate);
+  LargeUIntFree(&candidate);
+  return prime;
+}
+
+void TestSmallCandidates() {
+  // 2 is left to the callers, as the wheel only holds odd numbers.
+  uint64_t value;
+  for (value = 3; value < 300; value++) {
+    Check(SearchFrom(value, 1, 0) == NextPrime(value),
+          "Small candidates should move up to the next prime");
+    Check(SearchFrom(value, 1, 1) == NextPrime(value),
+          "Small candidates should move up to the next probable prime");
+  }
+}
+
+void TestLargeCandidates() {
+  // Around the end of the product tree screen, and past 2^32 where trial
+  // division takes over from the screen.
+  uint64_t starts[] = {65519, 65520, 65538, 4294967291ULL, 4294967296ULL,
+                       1000000000000ULL, 1000003ULL * 1000033ULL};
+  int i;
+  for (i = 0; i < sizeof(starts) / sizeof(starts[0]); i++) {
+    uint64_t prime = NextPrime(starts[i]);
+    Check(SearchFrom(starts[i], 1, 0) == prime,
+          "Search should find the next prime");
+    Check(SearchFrom(starts[i], 3, 0) == prime,
+          "Search on several threads should find the next prime");
+    Check(SearchFrom(starts[i], 1, 1) == prime,
+          "Probable prime search should find the next prime");
+  }
+}
+
+// Creates an empty temporary file and returns its name.
+char* MakeTempFile() {
+  static char filename[40];
+  strcpy(filename, "/tmp/candidate-search-testXXXXXX");
+  int fd = mkstemp(filename);
+  Check(fd >= 0, "Temporary file should open");
+  close(fd);
+  return filename;
+}
+
+void TestCheckpoint() {
+  char* filename = MakeTempFile();
+  char rejected_filename[50];
+  sprintf(rejected_filename, "%s.rejected", filename);
+  SearchCheckpoint checkpoint = {0};
+  SearchCheckpointInit(filename, 1000000, &checkpoint);
+  LargeUInt candidate = {0};
+  uint64_t start = 1000000000000ULL;
+  LargeUIntSetWord(start, &candidate);
+  CandidateSearchPrime(1, &checkpoint, &candidate);
+  Check(LargeUIntGetWord(&candidate) == NextPrime(start),
+        "Search with a checkpoint should find the next prime");
+  Check(LargeUIntEqual(&checkpoint.candidate, &candidate),
+        "Checkpoint should hold the prime");
+  Check(LargeUIntLessThan(&checkpoint.max_divisor, &checkpoint.tried_below),
+        "Checkpoint should show every divisor tried");
+  int i;
+  int all_composite = checkpoint.num_rejected > 0;
+  for (i = 0; i < checkpoint.num_rejected; i++) {
+    uint64_t rejected = LargeUIntGetWord(&checkpoint.rejected[i]);
+    uint64_t factor = LargeUIntGetWord(&checkpoint.rejected_by[i]);
+    if (rejected < start || rejected >= NextPrime(start) || factor < 11 ||
+        rejected % factor != 0) {
+      all_composite = 0;
+    }
+  }
+  Check(all_composite, "Each rejected candidate should be kept with a factor");
+  SearchCheckpointFree(&checkpoint);
+
+  // A checkpoint whose progress on the candidate is past its only factor
+  // below the square root is taken at its word.
+  uint64_t composite = 1000003ULL * 1000033ULL;
+  SearchCheckpointInit(filename, 1000000, &checkpoint);
+  LargeUIntSetWord(composite, &checkpoint.candidate);
+  LargeUIntSetWord(1000004, &checkpoint.tried_below);
+  LargeUIntSetWord(composite, &candidate);
+  CandidateSearchPrime(1, &checkpoint, &candidate);
+  Check(LargeUIntGetWord(&candidate) == composite,
+        "Search should carry on from the checkpoint");
+  SearchCheckpointFree(&checkpoint);
+
+  unlink(filename);
+  unlink(rejected_filename);
+  LargeUIntFree(&candidate);
+}
+
+void TestPrintPrime() {
+  LargeUInt prime = {0};
+  LargeUIntSetWord(65537, &prime);
+  char line[100];
+  FILE* out = fmemopen(line, sizeof(line), "w");
+  CandidateSearchPrintPrime(&prime, out);
+  fclose(out);
+  Check(strcmp(line, "0300_010001 # int value: 65537\n") == 0,
+        "Prime should be printed with its decimal value");
+  LargeUIntFree(&prime);
+}
+
+int main() {
+  TestSmallCandidates();
+  TestLargeCandidates();
+  TestCheckpoint();
+  TestPrintPrime();
+  printf("\nAll tests passed\n");
+}
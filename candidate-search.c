@@ -0,0 +1,146 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "candidate-search.h"
+#include "product-tree.h"
+#include "trial-division.h"
+#include "wheel.h"
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Candidates are first checked against a product tree of the primes from 11
+// up to this limit, and only trial divided from there if none divides them.
+#define SCREEN_LIMIT (1 << 16)
+
+// Passes the progress of trial division on to the checkpoint.
+static void SaveProgress(const LargeUInt* tried_below, void* checkpoint) {
+  SearchCheckpointTried(tried_below, checkpoint);
+}
+
+// The wheel steps over 3, 5 and 7, so small starting points are settled here.
+// Returns 1 if the candidate was one, having moved it up to the nearest prime.
+static int SettleSmallCandidate(LargeUInt* candidate) {
+  if (LargeUIntNumBytes(candidate) > 1 || LargeUIntGetWord(candidate) > 7) {
+    return 0;
+  }
+  int prime = WheelSmallOddPrime(LargeUIntGetWord(candidate));
+  LargeUIntInit(1, candidate);
+  LargeUIntSetByte(prime, 0, candidate);
+  return 1;
+}
+
+void CandidateSearchProbablePrime(LargeUInt* candidate) {
+  if (SettleSmallCandidate(candidate)) {
+    return;
+  }
+  Wheel candidate_wheel;
+  LargeUIntAddByte(WheelStart(LargeUIntModWord(candidate, WHEEL_MODULUS),
+                              &candidate_wheel),
+                   candidate);
+  ProductTree screen = {0};
+  ProductTreeInitRange(WHEEL_FIRST_DIVISOR, SCREEN_LIMIT, &screen);
+  while (ProductTreeHasFactor(&screen, candidate) ||
+         !LargeUIntIsProbablePrime(candidate)) {
+    LargeUIntAddByte(WheelNext(&candidate_wheel), candidate);
+  }
+  ProductTreeFree(&screen);
+}
+
+void CandidateSearchPrime(int num_threads, SearchCheckpoint* checkpoint,
+                          LargeUInt* candidate) {
+  if (SettleSmallCandidate(candidate)) {
+    return;
+  }
+
+  // Move up to the first candidate with no factor below 11, then only try
+  // candidates on the wheel.
+  Wheel candidate_wheel;
+  LargeUIntAddByte(WheelStart(LargeUIntModWord(candidate, WHEEL_MODULUS),
+                              &candidate_wheel),
+                   candidate);
+
+  ProductTree screen = {0};
+  ProductTreeInitRange(WHEEL_FIRST_DIVISOR, SCREEN_LIMIT, &screen);
+  LargeUInt screen_limit = {0};
+  LargeUIntSetWord(SCREEN_LIMIT, &screen_limit);
+  LargeUInt max_divisor = {0};
+  LargeUInt factor = {0};
+  // Every divisor below tried_below has been tried on the candidate, and none
+  // below 11 divides a candidate on the wheel.
+  LargeUInt tried_below = {0};
+  LargeUIntSetWord(WHEEL_FIRST_DIVISOR, &tried_below);
+  if (checkpoint != NULL && LargeUIntEqual(&checkpoint->candidate, candidate)) {
+    LargeUIntClone(&checkpoint->tried_below, &tried_below);
+  }
+  printf("Starting with possible prime ");
+  while (1) {
+    // Establish the limit of the highest divisor we need to try.
+    LargeUIntApproximateSquareRoot(candidate, &max_divisor);
+    LargeUIntBase10Print(candidate, stdout);
+    printf("\nMaximum divisor: ");
+    LargeUIntPrint(&max_divisor, stdout);
+    printf("\nProgress: 0|-------20|-------40|-------60|-------80|------100|");
+    printf("\n           x");
+    fflush(stdout);
+    if (checkpoint != NULL) {
+      SearchCheckpointStart(candidate, &max_divisor, &tried_below,
+                            checkpoint);
+    }
+    uint32_t small_factor = 0;
+    if (LargeUIntLessThan(&tried_below, &screen_limit)) {
+      small_factor = ProductTreeFactor(&screen, candidate);
+      if (small_factor != 0) {
+        LargeUIntSetWord(small_factor, &factor);
+      } else {
+        LargeUIntClone(&screen_limit, &tried_below);
+      }
+    }
+    if (small_factor == 0 &&
+        TrialDivisionIsPrimeFrom(candidate, &tried_below, &max_divisor,
+                                 num_threads,
+                                 checkpoint == NULL ? NULL : SaveProgress,
+                                 checkpoint, &factor)) {
+      break;
+    }
+    if (checkpoint != NULL) {
+      SearchCheckpointReject(&factor, checkpoint);
+    }
+    LargeUIntAddByte(WheelNext(&candidate_wheel), candidate);
+    LargeUIntSetWord(WHEEL_FIRST_DIVISOR, &tried_below);
+    printf("\nTrying a new possible prime ");
+  }
+
+  // We ran out of divisors so the value stored in candidate is prime.
+  if (checkpoint != NULL) {
+    LargeUIntClone(&max_divisor, &tried_below);
+    LargeUIntIncrement(&tried_below);
+    SearchCheckpointTried(&tried_below, checkpoint);
+    SearchCheckpointSave(checkpoint);
+  }
+  LargeUIntFree(&max_divisor);
+  LargeUIntFree(&factor);
+  LargeUIntFree(&tried_below);
+  LargeUIntFree(&screen_limit);
+  ProductTreeFree(&screen);
+}
+
+void CandidateSearchPrintPrime(const LargeUInt* prime, FILE* out) {
+  LargeUIntPrint(prime, out);
+  fprintf(out, " # int value: ");
+  LargeUIntBase10Print(prime, out);
+  fprintf(out, "\n");
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef CANDIDATE_SEARCH_H
+#define CANDIDATE_SEARCH_H
+
+#include "large-u-int.h"
+#include "search-checkpoint.h"
+
+#include <stdio.h>
+
+// The search for the nearest prime at or above a starting candidate, shared
+// by the finders that start from a given or a random number. Candidates off
+// the mod 210 wheel are skipped, those on it are screened with a product tree
+// of the primes up to 2^16, and the ones left are trial divided or given a
+// Baillie-PSW test.
+
+// Checkpoints of the search are saved no more often than this.
+#define CANDIDATE_SEARCH_CHECKPOINT_MS 5000
+
+// Moves the candidate up to the nearest prime at or above it, printing each
+// candidate and a progress bar for its divisors. The divisors of each
+// candidate that passes the screen are tried on num_threads threads. Unless
+// checkpoint is NULL, the progress is saved to it, and if it holds progress on
+// the starting candidate the search carries on from there.
+void CandidateSearchPrime(int num_threads, SearchCheckpoint* checkpoint,
+                          LargeUInt* candidate);
+
+// Moves the candidate up to the nearest probable prime at or above it. Each
+// candidate that passes the screen is given a Baillie-PSW test in place of
+// trial division.
+void CandidateSearchProbablePrime(LargeUInt* candidate);
+
+// Writes the prime on one line, in the LargeUInt text format followed by a
+// comment with its decimal value.
+void CandidateSearchPrintPrime(const LargeUInt* prime, FILE* out);
+
+#endif
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Checks a primality certificate written by probable-random-prime-finder
+// --certificate, without trial division or any probable prime test.
+
+#include "large-u-int.h"
+#include "prime-certificate.h"
+
+#include <stdio.h>
+
+void PrintPrime(LargeUInt* prime, FILE* out) {
+  LargeUIntPrint(prime, out);
+  fprintf(out, " # int value: ");
+  LargeUIntBase10Print(prime, out);
+  fprintf(out, "\n");
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    printf("Usage: %s <certificate file>\n", argv[0]);
+    printf("Checks a certificate written by probable-random-prime-finder "
+           "--certificate.\n");
+    return 1;
+  }
+  FILE* in = fopen(argv[1], "r");
+  if (in == NULL) {
+    printf("Unable to open %s\n", argv[1]);
+    return 1;
+  }
+
+  PrimeCertificate certificate = {0};
+  LargeUInt prime = {0};
+  int bad_line;
+  int valid = PrimeCertificateCheckFile(in, &certificate, &bad_line, &prime);
+  fclose(in);
+  if (valid) {
+    printf("Proven prime:\n");
+    PrintPrime(&prime, stdout);
+  } else if (bad_line == 0) {
+    printf("The certificate is empty.\n");
+  } else {
+    printf("Line %d of the certificate does not check.\n", bad_line);
+  }
+  PrimeCertificateFree(&certificate);
+  LargeUIntFree(&prime);
+  return !valid;
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Times schoolbook multiplication against one level of Karatsuba for a range
+// of operand sizes, to find the size at which KARATSUBA_THRESHOLD should be
+// set. The half sized products inside Karatsuba use the schoolbook method for
+// every size measured here, so run this with the threshold set above the
+// largest size, e.g. make karatsuba-benchmark, which builds with
+// -DKARATSUBA_THRESHOLD=1000.
+
+#include "large-u-int-limbs.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define MIN_LIMBS 4
+#define MAX_LIMBS 96
+#define TARGET_LIMB_PRODUCTS 200000000
+
+static double Seconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+int main(void) {
+  uint64_t a[MAX_LIMBS], b[MAX_LIMBS], result[2 * MAX_LIMBS];
+  uint64_t* scratch =
+      malloc(LimbsMulKaratsubaScratchSize(MAX_LIMBS) * sizeof(uint64_t));
+  int i, len, round;
+  for (i = 0; i < MAX_LIMBS; i++) {
+    a[i] = ((uint64_t) rand() << 40) ^ ((uint64_t) rand() << 20) ^ rand();
+    b[i] = ((uint64_t) rand() << 40) ^ ((uint64_t) rand() << 20) ^ rand();
+  }
+
+  printf("limbs  schoolbook ns  karatsuba ns\n");
+  int crossover = 0;
+  for (len = MIN_LIMBS; len <= MAX_LIMBS; len += 2) {
+    // Keep the total work per size roughly constant.
+    int rounds = TARGET_LIMB_PRODUCTS / (len * len);
+    double start = Seconds();
+    for (round = 0; round < rounds; round++) {
+      LimbsMulSchoolbook(a, len, b, len, result);
+      a[0] ^= result[len];
+    }
+    double schoolbook = (Seconds() - start) / rounds * 1e9;
+
+    start = Seconds();
+    for (round = 0; round < rounds; round++) {
+      LimbsMulKaratsuba(a, b, len, result, scratch);
+      a[0] ^= result[len];
+    }
+    double karatsuba = (Seconds() - start) / rounds * 1e9;
+
+    printf("%5i  %13.1f  %12.1f\n", len, schoolbook, karatsuba);
+    if (karatsuba < schoolbook) {
+      if (crossover == 0) {
+        crossover = len;
+      }
+    } else {
+      crossover = 0;
+    }
+  }
+  if (crossover == 0) {
+    printf("Karatsuba was not faster by %i limbs\n", MAX_LIMBS);
+  } else {
+    printf("Karatsuba is faster from %i limbs on\n", crossover);
+  }
+  free(scratch);
+  return 0;
+}
@@ -0,0 +1,310 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "large-u-int-limbs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_TEST_LIMBS 200
+
+void Check(int condition, char* message) {
+  if (!condition) {
+    fprintf(stderr, "Condition failed: %s\n", message);
+    exit(1);
+  }
+}
+
+void FillRandomly(int len, uint64_t* limbs) {
+  int i;
+  for (i = 0; i < len; i++) {
+    limbs[i] = ((uint64_t) rand() << 40) ^ ((uint64_t) rand() << 20) ^ rand();
+  }
+}
+
+void TestAddAndSub() {
+  uint64_t a[3] = {UINT64_MAX, UINT64_MAX, 5};
+  uint64_t b[1] = {1};
+  uint64_t result[3];
+  Check(0 == LimbsAdd(a, 3, b, 1, result), "Sum should not carry out");
+  Check(0 == result[0] && 0 == result[1] && 6 == result[2],
+        "Carry should ripple through every limb");
+
+  uint64_t top[1] = {UINT64_MAX};
+  Check(1 == LimbsAdd(top, 1, b, 1, result), "Sum should carry out");
+  Check(0 == result[0], "Low limb should wrap to zero");
+
+  Check(0 == LimbsSub(result, 3, b, 1, result), "Difference has no borrow");
+  Check(UINT64_MAX == result[0] && UINT64_MAX == result[1] && 5 == result[2],
+        "Borrow should ripple back through every limb");
+  Check(1 == LimbsSub(b, 1, top, 1, result), "Difference should borrow out");
+}
+
+void TestAddMul() {
+  uint64_t a[2] = {UINT64_MAX, UINT64_MAX};
+  uint64_t result[2] = {1, 0};
+  // (2^128 - 1) * (2^64 - 1) + 1 = 2^192 - 2^128 - 2^64 + 2
+  uint64_t carry = LimbsAddMul(a, 2, UINT64_MAX, result);
+  Check(2 == result[0], "Low limb of the product should be 2");
+  Check(UINT64_MAX == result[1], "Middle limb of the product should be max");
+  Check(UINT64_MAX - 1 == carry, "Carry limb should be 2^64 - 2");
+}
+
+void TestKaratsubaMatchesSchoolbook() {
+  uint64_t a[MAX_TEST_LIMBS], b[MAX_TEST_LIMBS];
+  uint64_t expected[2 * MAX_TEST_LIMBS], actual[2 * MAX_TEST_LIMBS];
+  uint64_t* scratch =
+      malloc(LimbsMulKaratsubaScratchSize(MAX_TEST_LIMBS) * sizeof(uint64_t));
+  int len;
+  for (len = 2; len <= MAX_TEST_LIMBS; len += 7) {
+    FillRandomly(len, a);
+    FillRandomly(len, b);
+    LimbsMulSchoolbook(a, len, b, len, expected);
+    LimbsMulKaratsuba(a, b, len, actual, scratch);
+    Check(0 == memcmp(expected, actual, 2 * len * sizeof(uint64_t)),
+          "Karatsuba product should match the schoolbook product");
+  }
+
+  // All ones maximises every carry in the sums and the middle term.
+  for (len = 2; len <= MAX_TEST_LIMBS; len += 13) {
+    memset(a, 0xFF, len * sizeof(uint64_t));
+    LimbsMulSchoolbook(a, len, a, len, expected);
+    LimbsMulKaratsuba(a, a, len, actual, scratch);
+    Check(0 == memcmp(expected, actual, 2 * len * sizeof(uint64_t)),
+          "Karatsuba square of all ones should match schoolbook");
+  }
+  free(scratch);
+}
+
+void TestMulUnequalLengths() {
+  uint64_t a[MAX_TEST_LIMBS], b[MAX_TEST_LIMBS];
+  uint64_t expected[2 * MAX_TEST_LIMBS], actual[2 * MAX_TEST_LIMBS];
+  uint64_t* scratch =
+      malloc(LimbsMulScratchSize(MAX_TEST_LIMBS) * sizeof(uint64_t));
+  int a_len, b_len;
+  for (a_len = 1; a_len <= MAX_TEST_LIMBS; a_len += 11) {
+    for (b_len = 1; b_len <= MAX_TEST_LIMBS; b_len += 17) {
+      FillRandomly(a_len, a);
+      FillRandomly(b_len, b);
+      LimbsMulSchoolbook(a, a_len, b, b_len, expected);
+      LimbsMul(a, a_len, b, b_len, actual, scratch);
+      Check(0 == memcmp(expected, actual, (a_len + b_len) * sizeof(uint64_t)),
+            "Product of unequal lengths should match schoolbook");
+    }
+  }
+  free(scratch);
+}
+
+void TestShift() {
+  uint64_t a[2] = {0x8000000000000001, 0x8000000000000000};
+  uint64_t result[2];
+  Check(1 == LimbsShiftLeft(a, 2, 1, result), "Top bit should shift out");
+  Check(2 == result[0] && 1 == result[1], "Bits should cross limbs upward");
+  LimbsShiftRight(a, 2, 1, result);
+  Check(0x4000000000000000 == result[0] && 0x4000000000000000 == result[1],
+        "Bits should cross limbs downward");
+  Check(0 == LimbsShiftLeft(a, 2, 0, result), "Zero shift drops nothing");
+  Check(a[0] == result[0] && a[1] == result[1], "Zero shift is a copy");
+}
+
+// Checks that quotient * denominator + remainder == numerator and
+// remainder < denominator.
+void CheckDivision(const uint64_t* numerator, int numerator_len,
+                   const uint64_t* denominator, int denominator_len) {
+  uint64_t quotient[MAX_TEST_LIMBS], remainder[MAX_TEST_LIMBS];
+  uint64_t product[2 * MAX_TEST_LIMBS];
+  uint64_t scratch[2 * MAX_TEST_LIMBS + 1];
+  int quotient_len = numerator_len - denominator_len + 1;
+  LimbsDivRem(numerator, numerator_len, denominator, denominator_len,
+              quotient, remainder, scratch);
+
+  int i;
+  for (i = denominator_len - 1; i >= 0; i--) {
+    if (remainder[i] != denominator[i]) {
+      break;
+    }
+  }
+  Check(i >= 0 && remainder[i] < denominator[i],
+        "Remainder should be less than the denominator");
+
+  LimbsMulSchoolbook(quotient, quotient_len, denominator, denominator_len,
+                     product);
+  Check(0 == LimbsAdd(product, quotient_len + denominator_len, remainder,
+                      denominator_len, product),
+        "Quotient times denominator plus remainder should not overflow");
+  Check(0 == memcmp(product, numerator, numerator_len * sizeof(uint64_t)),
+        "Quotient times denominator plus remainder should be the numerator");
+  Check(quotient_len + denominator_len == numerator_len ||
+            0 == product[numerator_len],
+        "Product should be no longer than the numerator");
+}
+
+void TestDivRem() {
+  uint64_t numerator[MAX_TEST_LIMBS], denominator[MAX_TEST_LIMBS];
+  // Limb values near the edges are the ones that make quotient estimates
+  // too large and force the add back step.
+  const uint64_t kEdges[] = {0, 1, 0x7FFFFFFFFFFFFFFF, 0x8000000000000000,
+                             UINT64_MAX - 1, UINT64_MAX};
+  int numerator_len, denominator_len, round, i;
+  for (round = 0; round < 2000; round++) {
+    denominator_len = 1 + rand() % 8;
+    numerator_len = denominator_len + rand() % 8;
+    FillRandomly(numerator_len, numerator);
+    FillRandomly(denominator_len, denominator);
+    if (round % 2 == 0) {
+      for (i = 0; i < numerator_len; i++) {
+        numerator[i] = kEdges[rand() % 6];
+      }
+      for (i = 0; i < denominator_len; i++) {
+        denominator[i] = kEdges[rand() % 6];
+      }
+    }
+    if (denominator[denominator_len - 1] == 0) {
+      denominator[denominator_len - 1] = 1;
+    }
+    CheckDivision(numerator, numerator_len, denominator, denominator_len);
+  }
+
+  // A classic add back case: the first estimate of the quotient limb is one
+  // too large even after the refinement with the second divisor limb.
+  uint64_t add_back_numerator[3] = {0, 0xFFFFFFFFFFFFFFFE, 0x7FFFFFFFFFFFFFFF};
+  uint64_t add_back_denominator[2] = {UINT64_MAX, 0x8000000000000000};
+  CheckDivision(add_back_numerator, 3, add_back_denominator, 2);
+
+  // Single limb division against the compiler's double width division.
+  uint64_t quotient[MAX_TEST_LIMBS];
+  for (round = 0; round < 2000; round++) {
+    uint64_t divisor;
+    FillRandomly(1, &divisor);
+    divisor >>= rand() % 64;
+    if (divisor == 0) {
+      divisor = 1;
+    }
+    numerator_len = 1 + rand() % 8;
+    FillRandomly(numerator_len, numerator);
+    uint64_t expected = 0;
+    for (i = numerator_len - 1; i >= 0; i--) {
+      DoubleLimb partial = (DoubleLimb) expected << 64 | numerator[i];
+      Check(0 == (partial / divisor) >> 64 || i == numerator_len - 1,
+            "Reference quotient limb should fit");
+      expected = (uint64_t) (partial % divisor);
+    }
+    Check(expected == LimbsDivRemLimb(numerator, numerator_len, divisor,
+                                      quotient),
+          "Single limb remainder should match double width division");
+    denominator[0] = divisor;
+    CheckDivision(numerator, numerator_len, denominator, 1);
+  }
+
+  uint64_t remainder = LimbsDivRemLimb(add_back_numerator, 3, 10, numerator);
+  Check(remainder == 6, "Remainder of (2^191 - 2^65) by 10 should be 6");
+}
+
+void TestModSmall() {
+  uint64_t a[MAX_TEST_LIMBS];
+  uint32_t divisors[37], residues[37];
+  // Divisors near 2^32 and the edge limb values leave the least room in the
+  // vector kernels.
+  const uint32_t kDivisors[] = {1, 2, 3, 65535, 65536, 65537, 0x7FFFFFFF,
+                                0x80000000, UINT32_MAX - 1, UINT32_MAX};
+  const uint64_t kEdges[] = {0, 1, UINT64_MAX - 1, UINT64_MAX};
+  LimbsModSmallKernel best = LimbsModSmallBestKernel();
+  int len, round, i, kernel;
+  for (round = 0; round < 500; round++) {
+    len = rand() % 9;
+    FillRandomly(len, a);
+    if (round % 2 == 0) {
+      for (i = 0; i < len; i++) {
+        a[i] = kEdges[rand() % 4];
+      }
+    }
+    // Every count up to 37 leaves a different number of unused lanes.
+    int count = 1 + round % 37;
+    for (i = 0; i < count; i++) {
+      if (rand() % 2 == 0) {
+        divisors[i] = kDivisors[rand() % 10];
+      } else {
+        divisors[i] = (uint32_t) rand() >> (rand() % 31);
+        if (divisors[i] == 0) {
+          divisors[i] = 1;
+        }
+      }
+    }
+    for (kernel = LIMBS_MOD_SMALL_SCALAR; kernel <= best; kernel++) {
+      LimbsModSmallWith(kernel, a, len, divisors, count, residues);
+      for (i = 0; i < count; i++) {
+        Check(residues[i] == LimbsDivRemLimb(a, len, divisors[i], NULL),
+              "Each kernel should match single limb division");
+      }
+    }
+  }
+}
+
+void TestSqr() {
+  uint64_t a[MAX_TEST_LIMBS];
+  uint64_t expected[2 * MAX_TEST_LIMBS], actual[2 * MAX_TEST_LIMBS];
+  uint64_t* scratch =
+      malloc(LimbsMulScratchSize(MAX_TEST_LIMBS) * sizeof(uint64_t));
+  int len;
+  for (len = 1; len <= MAX_TEST_LIMBS; len += 3) {
+    FillRandomly(len, a);
+    if (len % 2 == 0) {
+      memset(a, 0xFF, len * sizeof(uint64_t));
+    }
+    LimbsMulSchoolbook(a, len, a, len, expected);
+    LimbsSqr(a, len, actual, scratch);
+    Check(0 == memcmp(expected, actual, 2 * len * sizeof(uint64_t)),
+          "Square should match the schoolbook product");
+  }
+  free(scratch);
+}
+
+void TestMontRedc() {
+  uint64_t modulus = 0xFFFFFFFFFFFFFFC5;  // The largest 64 bit prime.
+  uint64_t inverse = LimbsMontInverse(modulus);
+  Check(UINT64_MAX == modulus * inverse, "modulus * inverse should be -1");
+
+  // Reducing 12345 * 2^64 should give back 12345.
+  uint64_t t[2] = {0, 12345};
+  uint64_t result[1];
+  LimbsMontRedc(t, &modulus, 1, inverse, result);
+  Check(12345 == result[0], "Reduction should divide out 2^64");
+
+  // (m - 1) * (m - 1) / 2^64 mod m, compared against plain division.
+  uint64_t a[1] = {modulus - 1};
+  uint64_t square[2], scratch[4], remainder[1];
+  LimbsMulSchoolbook(a, 1, a, 1, square);
+  LimbsMontRedc(square, &modulus, 1, inverse, result);
+  // result * 2^64 should be congruent to (m - 1)^2 = 1.
+  uint64_t shifted[2] = {0, result[0]};
+  LimbsDivRem(shifted, 2, &modulus, 1, NULL, remainder, scratch);
+  Check(result[0] < modulus, "Reduction should stay below m");
+  Check(1 == remainder[0], "Reduced square times 2^64 should be 1 mod m");
+}
+
+int main(void) {
+  srand(1);
+  TestAddAndSub();
+  TestAddMul();
+  TestKaratsubaMatchesSchoolbook();
+  TestMulUnequalLengths();
+  TestShift();
+  TestDivRem();
+  TestModSmall();
+  TestSqr();
+  TestMontRedc();
+  printf("All tests passed\n");
+}
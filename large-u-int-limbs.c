@@ -0,0 +1,585 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "large-u-int-limbs.h"
+
+#include <string.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+uint64_t LimbsAdd(const uint64_t* a, int a_len, const uint64_t* b, int b_len,
+                  uint64_t* result) {
+  uint64_t carry = 0;
+  DoubleLimb sum;
+  int i;
+  for (i = 0; i < b_len; i++) {
+    sum = (DoubleLimb) a[i] + b[i] + carry;
+    result[i] = (uint64_t) sum;
+    carry = (uint64_t) (sum >> 64);
+  }
+  for (; i < a_len; i++) {
+    result[i] = a[i] + carry;
+    carry = result[i] < carry;
+  }
+  return carry;
+}
+
+uint64_t LimbsSub(const uint64_t* a, int a_len, const uint64_t* b, int b_len,
+                  uint64_t* result) {
+  uint64_t borrow = 0;
+  DoubleLimb diff;
+  int i;
+  for (i = 0; i < b_len; i++) {
+    diff = (DoubleLimb) a[i] - b[i] - borrow;
+    result[i] = (uint64_t) diff;
+    borrow = (uint64_t) (diff >> 64) & 1;
+  }
+  uint64_t limb;
+  for (; i < a_len; i++) {
+    limb = a[i];
+    result[i] = limb - borrow;
+    borrow = limb < borrow;
+  }
+  return borrow;
+}
+
+uint64_t LimbsAddMul(const uint64_t* a, int len, uint64_t multiplier,
+                     uint64_t* result) {
+  uint64_t carry = 0;
+  DoubleLimb product;
+  int i;
+  for (i = 0; i < len; i++) {
+    product = (DoubleLimb) a[i] * multiplier + result[i] + carry;
+    result[i] = (uint64_t) product;
+    carry = (uint64_t) (product >> 64);
+  }
+  return carry;
+}
+
+uint64_t LimbsSubMul(const uint64_t* a, int len, uint64_t multiplier,
+                     uint64_t* result) {
+  uint64_t borrow = 0;
+  DoubleLimb product;
+  uint64_t low;
+  int i;
+  for (i = 0; i < len; i++) {
+    product = (DoubleLimb) a[i] * multiplier + borrow;
+    low = (uint64_t) product;
+    borrow = (uint64_t) (product >> 64) + (result[i] < low);
+    result[i] -= low;
+  }
+  return borrow;
+}
+
+uint64_t LimbsShiftLeft(const uint64_t* a, int len, int bits,
+                        uint64_t* result) {
+  if (bits == 0) {
+    memmove(result, a, len * sizeof(uint64_t));
+    return 0;
+  }
+  uint64_t out = 0;
+  uint64_t limb;
+  int i;
+  for (i = 0; i < len; i++) {
+    limb = a[i];
+    result[i] = limb << bits | out;
+    out = limb >> (64 - bits);
+  }
+  return out;
+}
+
+void LimbsShiftRight(const uint64_t* a, int len, int bits, uint64_t* result) {
+  if (bits == 0) {
+    memmove(result, a, len * sizeof(uint64_t));
+    return;
+  }
+  int i;
+  for (i = 0; i < len - 1; i++) {
+    result[i] = a[i] >> bits | a[i + 1] << (64 - bits);
+  }
+  if (len > 0) {
+    result[len - 1] = a[len - 1] >> bits;
+  }
+}
+
+void LimbsMulSchoolbook(const uint64_t* a, int a_len, const uint64_t* b,
+                        int b_len, uint64_t* result) {
+  memset(result, 0, (a_len + b_len) * sizeof(uint64_t));
+  int i;
+  for (i = 0; i < b_len; i++) {
+    result[i + a_len] = LimbsAddMul(a, a_len, b[i], result + i);
+  }
+}
+
+// Multiplies two len limb numbers with whichever method suits the size.
+static void MulBalanced(const uint64_t* a, const uint64_t* b, int len,
+                        uint64_t* result, uint64_t* scratch) {
+  if (len < KARATSUBA_THRESHOLD) {
+    LimbsMulSchoolbook(a, len, b, len, result);
+  } else {
+    LimbsMulKaratsuba(a, b, len, result, scratch);
+  }
+}
+
+void LimbsMulKaratsuba(const uint64_t* a, const uint64_t* b, int len,
+                       uint64_t* result, uint64_t* scratch) {
+  // Split a = a1 * B^low + a0 and b = b1 * B^low + b0, where the high halves
+  // are the same size as or one limb longer than the low halves.
+  int low = len / 2;
+  int high = len - low;
+
+  // a0 * b0 and a1 * b1 go straight into the low and high ends of the result.
+  // Both are done before the rest of scratch is claimed, so they may use all
+  // of it.
+  MulBalanced(a, b, low, result, scratch);
+  MulBalanced(a + low, b + low, high, result + 2 * low, scratch);
+
+  // (a0 + a1) * (b0 + b1) - a0 * b0 - a1 * b1 = a0 * b1 + a1 * b0 is the
+  // middle term. The sums may carry into one extra limb.
+  uint64_t* a_sum = scratch;
+  uint64_t* b_sum = a_sum + high + 1;
+  uint64_t* middle = b_sum + high + 1;
+  a_sum[high] = LimbsAdd(a + low, high, a, low, a_sum);
+  b_sum[high] = LimbsAdd(b + low, high, b, low, b_sum);
+  MulBalanced(a_sum, b_sum, high + 1, middle, middle + 2 * (high + 1));
+  LimbsSub(middle, 2 * (high + 1), result, 2 * low, middle);
+  LimbsSub(middle, 2 * (high + 1), result + 2 * low, 2 * high, middle);
+
+  // The middle term is less than B^(len + 1), so any of its limbs that would
+  // land past the end of the result are zero.
+  int middle_len = 2 * (high + 1);
+  if (middle_len > len + high) {
+    middle_len = len + high;
+  }
+  LimbsAdd(result + low, len + high, middle, middle_len, result + low);
+}
+
+int LimbsMulKaratsubaScratchSize(int len) {
+  int high = len - len / 2;
+  int size = 4 * (high + 1);
+  if (high + 1 >= KARATSUBA_THRESHOLD) {
+    size += LimbsMulKaratsubaScratchSize(high + 1);
+  }
+  return size;
+}
+
+int LimbsMulScratchSize(int len) {
+  if (len < KARATSUBA_THRESHOLD) {
+    return 0;
+  }
+  // Unequal lengths need room for one padded chunk and its product on top of
+  // what Karatsuba itself uses.
+  return 3 * len + LimbsMulKaratsubaScratchSize(len);
+}
+
+void LimbsMul(const uint64_t* a, int a_len, const uint64_t* b, int b_len,
+              uint64_t* result, uint64_t* scratch) {
+  if (a_len < b_len) {
+    const uint64_t* swap = a;
+    a = b;
+    b = swap;
+    int swap_len = a_len;
+    a_len = b_len;
+    b_len = swap_len;
+  }
+
+  if (b_len < KARATSUBA_THRESHOLD) {
+    LimbsMulSchoolbook(a, a_len, b, b_len, result);
+    return;
+  }
+  if (a_len == b_len) {
+    LimbsMulKaratsuba(a, b, a_len, result, scratch);
+    return;
+  }
+
+  // Multiply b by each b_len limb chunk of a in turn, adding the partial
+  // products into place. The last chunk is padded with zero limbs.
+  uint64_t* chunk = scratch;
+  uint64_t* chunk_product = chunk + b_len;
+  uint64_t* karatsuba_scratch = chunk_product + 2 * b_len;
+  memset(result, 0, (a_len + b_len) * sizeof(uint64_t));
+  int offset;
+  for (offset = 0; offset < a_len; offset += b_len) {
+    int chunk_len = a_len - offset < b_len ? a_len - offset : b_len;
+    memcpy(chunk, a + offset, chunk_len * sizeof(uint64_t));
+    memset(chunk + chunk_len, 0, (b_len - chunk_len) * sizeof(uint64_t));
+    LimbsMulKaratsuba(chunk, b, b_len, chunk_product, karatsuba_scratch);
+    // Only chunk_len + b_len limbs of the partial product can be non-zero,
+    // which is exactly the space left in the result.
+    LimbsAdd(result + offset, a_len + b_len - offset, chunk_product,
+             chunk_len + b_len, result + offset);
+  }
+}
+
+static void SqrSchoolbook(const uint64_t* a, int len, uint64_t* result) {
+  // Sum each cross product a[i] * a[j], i < j, once.
+  memset(result, 0, 2 * len * sizeof(uint64_t));
+  int i;
+  for (i = 0; i < len - 1; i++) {
+    result[i + len] =
+        LimbsAddMul(a + i + 1, len - i - 1, a[i], result + 2 * i + 1);
+  }
+
+  // Double the cross products, then add the squares a[i] * a[i].
+  LimbsShiftLeft(result, 2 * len, 1, result);
+  uint64_t carry = 0;
+  DoubleLimb square, sum;
+  for (i = 0; i < len; i++) {
+    square = (DoubleLimb) a[i] * a[i];
+    sum = (DoubleLimb) result[2 * i] + (uint64_t) square + carry;
+    result[2 * i] = (uint64_t) sum;
+    carry = (uint64_t) (sum >> 64);
+    sum = (DoubleLimb) result[2 * i + 1] + (uint64_t) (square >> 64) + carry;
+    result[2 * i + 1] = (uint64_t) sum;
+    carry = (uint64_t) (sum >> 64);
+  }
+}
+
+void LimbsSqr(const uint64_t* a, int len, uint64_t* result, uint64_t* scratch) {
+  if (len < KARATSUBA_THRESHOLD) {
+    SqrSchoolbook(a, len, result);
+  } else {
+    LimbsMulKaratsuba(a, a, len, result, scratch);
+  }
+}
+
+uint64_t LimbsMontInverse(uint64_t modulus) {
+  // Newton's iteration doubles the number of correct low bits each step,
+  // starting from 3 correct bits since modulus * modulus == 1 mod 8.
+  uint64_t inverse = modulus;
+  int i;
+  for (i = 0; i < 5; i++) {
+    inverse *= 2 - modulus * inverse;
+  }
+  return -inverse;
+}
+
+void LimbsMontRedc(uint64_t* t, const uint64_t* modulus, int len,
+                   uint64_t inverse, uint64_t* result) {
+  // Each round adds the multiple of the modulus that clears the lowest
+  // remaining limb of t. The carry out of each round is held back and added
+  // in one limb higher on the next round.
+  uint64_t carry = 0;
+  DoubleLimb sum;
+  int i;
+  for (i = 0; i < len; i++) {
+    uint64_t multiple = t[i] * inverse;
+    sum = (DoubleLimb) t[i + len] + carry +
+          LimbsAddMul(modulus, len, multiple, t + i);
+    t[i + len] = (uint64_t) sum;
+    carry = (uint64_t) (sum >> 64);
+  }
+
+  // What is left is less than twice the modulus.
+  uint64_t* reduced = t + len;
+  int needs_subtract = carry > 0;
+  if (!needs_subtract) {
+    needs_subtract = 1;
+    for (i = len - 1; i >= 0; i--) {
+      if (reduced[i] != modulus[i]) {
+        needs_subtract = reduced[i] > modulus[i];
+        break;
+      }
+    }
+  }
+  if (needs_subtract) {
+    LimbsSub(reduced, len, modulus, len, result);
+  } else {
+    memcpy(result, reduced, len * sizeof(uint64_t));
+  }
+}
+
+uint64_t LimbsReciprocal(uint64_t divisor) {
+  // The true reciprocal is between 2^64 and 2^65 - 1, so dropping the top
+  // bit in the conversion subtracts the 2^64.
+  return (uint64_t) (~(DoubleLimb) 0 / divisor);
+}
+
+// Divides high * 2^64 + low by a normalized divisor, where high < divisor,
+// using its reciprocal in place of a hardware division. Returns the quotient
+// and stores the remainder. This is algorithm 4 of Moller and Granlund,
+// "Improved division by invariant integers".
+static uint64_t DivRemPreinv(uint64_t high, uint64_t low, uint64_t divisor,
+                             uint64_t reciprocal, uint64_t* remainder) {
+  // Sums wrap modulo 2^128, which the algorithm allows for.
+  DoubleLimb estimate = (DoubleLimb) reciprocal * high +
+                        ((DoubleLimb) high << 64 | low);
+  uint64_t quotient = (uint64_t) (estimate >> 64) + 1;
+  uint64_t rest = low - quotient * divisor;
+  if (rest > (uint64_t) estimate) {
+    quotient--;
+    rest += divisor;
+  }
+  if (rest >= divisor) {
+    quotient++;
+    rest -= divisor;
+  }
+  *remainder = rest;
+  return quotient;
+}
+
+uint64_t LimbsDivRemLimb(const uint64_t* a, int len, uint64_t divisor,
+                         uint64_t* quotient) {
+  if (len == 0) {
+    return 0;
+  }
+  // Work on a and divisor both shifted up so the divisor's top bit is set.
+  // The remainder is shifted back down at the end; the quotient is the same.
+  int shift = __builtin_clzll(divisor);
+  uint64_t normalized = divisor << shift;
+  uint64_t reciprocal = LimbsReciprocal(normalized);
+  uint64_t remainder = 0;
+  uint64_t limb, next;
+  int i;
+  if (shift > 0) {
+    remainder = a[len - 1] >> (64 - shift);
+  }
+  for (i = len - 1; i >= 0; i--) {
+    limb = a[i] << shift;
+    if (shift > 0 && i > 0) {
+      limb |= a[i - 1] >> (64 - shift);
+    }
+    next = DivRemPreinv(remainder, limb, normalized, reciprocal, &remainder);
+    if (quotient != NULL) {
+      quotient[i] = next;
+    }
+  }
+  return remainder >> shift;
+}
+
+int LimbsDivRemScratchSize(int numerator_len, int denominator_len) {
+  return numerator_len + 1 + denominator_len;
+}
+
+void LimbsDivRem(const uint64_t* numerator, int numerator_len,
+                 const uint64_t* denominator, int denominator_len,
+                 uint64_t* quotient, uint64_t* remainder, uint64_t* scratch) {
+  if (denominator_len == 1) {
+    remainder[0] = LimbsDivRemLimb(numerator, numerator_len, denominator[0],
+                                   quotient);
+    return;
+  }
+
+  // Normalize so the top bit of the denominator is set, which keeps every
+  // quotient limb estimate below within two of the true value.
+  int shift = __builtin_clzll(denominator[denominator_len - 1]);
+  uint64_t* d = scratch;
+  uint64_t* n = d + denominator_len;
+  LimbsShiftLeft(denominator, denominator_len, shift, d);
+  n[numerator_len] = LimbsShiftLeft(numerator, numerator_len, shift, n);
+
+  uint64_t d_top = d[denominator_len - 1];
+  uint64_t d_next = d[denominator_len - 2];
+  DoubleLimb partial, q_estimate, r_estimate;
+  int j;
+  for (j = numerator_len - denominator_len; j >= 0; j--) {
+    // Estimate this quotient limb from the top two limbs of what remains
+    // and the top limb of the denominator, then refine with the next limb.
+    partial = (DoubleLimb) n[j + denominator_len] << 64 |
+              n[j + denominator_len - 1];
+    q_estimate = partial / d_top;
+    r_estimate = partial % d_top;
+    while (q_estimate >> 64 != 0 ||
+           q_estimate * d_next >
+               (r_estimate << 64 | n[j + denominator_len - 2])) {
+      q_estimate--;
+      r_estimate += d_top;
+      if (r_estimate >> 64 != 0) {
+        break;
+      }
+    }
+
+    // Subtract the estimate times the denominator. The estimate may still
+    // be one too large, in which case the denominator is added back once.
+    uint64_t q = (uint64_t) q_estimate;
+    uint64_t borrow = LimbsSubMul(d, denominator_len, q, n + j);
+    uint64_t top = n[j + denominator_len];
+    n[j + denominator_len] = top - borrow;
+    if (top < borrow) {
+      q--;
+      n[j + denominator_len] +=
+          LimbsAdd(n + j, denominator_len, d, denominator_len, n + j);
+    }
+    if (quotient != NULL) {
+      quotient[j] = q;
+    }
+  }
+
+  LimbsShiftRight(n, denominator_len, shift, remainder);
+}
+
+// Each divisor takes two hardware divisions per limb, one for each half.
+static void ModSmallScalar(const uint64_t* a, int len, const uint32_t* divisors,
+                           int count, uint32_t* residues) {
+  int i, j;
+  for (j = 0; j < count; j++) {
+    uint64_t divisor = divisors[j];
+    uint64_t remainder = 0;
+    for (i = len - 1; i >= 0; i--) {
+      remainder = ((remainder << 32) | (a[i] >> 32)) % divisor;
+      remainder = ((remainder << 32) | (a[i] & 0xFFFFFFFF)) % divisor;
+    }
+    residues[j] = remainder;
+  }
+}
+
+#if defined(__x86_64__)
+
+// The vector kernels bring each limb in 16 bits at a time. With a remainder
+// below 2^32 the next value is below 2^48, and the quotient guessed from the
+// reciprocal is never off by more than one, so every step is exact in
+// doubles.
+
+// Reduces a by 4 divisors in each of two vectors.
+__attribute__((target("avx2,fma")))
+static void ModSmallAvx2(const uint64_t* a, int len, const uint32_t* divisors,
+                         int count, uint32_t* residues) {
+  double lanes[8];
+  int i, j, k;
+  for (j = 0; j < count; j += 8) {
+    // Unused lanes divide by 1.
+    for (k = 0; k < 8; k++) {
+      lanes[k] = j + k < count ? divisors[j + k] : 1;
+    }
+    __m256d divisor[2], reciprocal[2], remainder[2];
+    for (k = 0; k < 2; k++) {
+      divisor[k] = _mm256_loadu_pd(lanes + 4 * k);
+      reciprocal[k] = _mm256_div_pd(_mm256_set1_pd(1.0), divisor[k]);
+      remainder[k] = _mm256_setzero_pd();
+    }
+    const __m256d radix = _mm256_set1_pd(65536.0);
+    const __m256d zero = _mm256_setzero_pd();
+    for (i = len - 1; i >= 0; i--) {
+      int shift;
+      for (shift = 48; shift >= 0; shift -= 16) {
+        __m256d digit = _mm256_set1_pd((double) ((a[i] >> shift) & 0xFFFF));
+        for (k = 0; k < 2; k++) {
+          __m256d x = _mm256_fmadd_pd(remainder[k], radix, digit);
+          __m256d q = _mm256_floor_pd(_mm256_mul_pd(x, reciprocal[k]));
+          __m256d r = _mm256_fnmadd_pd(q, divisor[k], x);
+          r = _mm256_add_pd(r, _mm256_and_pd(_mm256_cmp_pd(r, zero, _CMP_LT_OQ),
+                                             divisor[k]));
+          r = _mm256_sub_pd(r, _mm256_and_pd(
+              _mm256_cmp_pd(r, divisor[k], _CMP_GE_OQ), divisor[k]));
+          remainder[k] = r;
+        }
+      }
+    }
+    for (k = 0; k < 2; k++) {
+      _mm256_storeu_pd(lanes + 4 * k, remainder[k]);
+    }
+    for (k = 0; k < 8 && j + k < count; k++) {
+      residues[j + k] = (uint32_t) lanes[k];
+    }
+  }
+}
+
+// Reduces a by 8 divisors in each of two vectors.
+__attribute__((target("avx512f")))
+static void ModSmallAvx512(const uint64_t* a, int len,
+                           const uint32_t* divisors, int count,
+                           uint32_t* residues) {
+  double lanes[16];
+  int i, j, k;
+  for (j = 0; j < count; j += 16) {
+    // Unused lanes divide by 1.
+    for (k = 0; k < 16; k++) {
+      lanes[k] = j + k < count ? divisors[j + k] : 1;
+    }
+    __m512d divisor[2], reciprocal[2], remainder[2];
+    for (k = 0; k < 2; k++) {
+      divisor[k] = _mm512_loadu_pd(lanes + 8 * k);
+      reciprocal[k] = _mm512_div_pd(_mm512_set1_pd(1.0), divisor[k]);
+      remainder[k] = _mm512_setzero_pd();
+    }
+    const __m512d radix = _mm512_set1_pd(65536.0);
+    const __m512d zero = _mm512_setzero_pd();
+    for (i = len - 1; i >= 0; i--) {
+      int shift;
+      for (shift = 48; shift >= 0; shift -= 16) {
+        __m512d digit = _mm512_set1_pd((double) ((a[i] >> shift) & 0xFFFF));
+        for (k = 0; k < 2; k++) {
+          __m512d x = _mm512_fmadd_pd(remainder[k], radix, digit);
+          __m512d q = _mm512_roundscale_pd(_mm512_mul_pd(x, reciprocal[k]),
+                                           _MM_FROUND_TO_NEG_INF |
+                                           _MM_FROUND_NO_EXC);
+          __m512d r = _mm512_fnmadd_pd(q, divisor[k], x);
+          r = _mm512_mask_add_pd(r, _mm512_cmp_pd_mask(r, zero, _CMP_LT_OQ),
+                                 r, divisor[k]);
+          r = _mm512_mask_sub_pd(
+              r, _mm512_cmp_pd_mask(r, divisor[k], _CMP_GE_OQ), r,
+              divisor[k]);
+          remainder[k] = r;
+        }
+      }
+    }
+    for (k = 0; k < 2; k++) {
+      _mm512_storeu_pd(lanes + 8 * k, remainder[k]);
+    }
+    for (k = 0; k < 16 && j + k < count; k++) {
+      residues[j + k] = (uint32_t) lanes[k];
+    }
+  }
+}
+
+#endif
+
+LimbsModSmallKernel LimbsModSmallBestKernel(void) {
+#if defined(__x86_64__)
+  if (__builtin_cpu_supports("avx512f")) {
+    return LIMBS_MOD_SMALL_AVX512;
+  }
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return LIMBS_MOD_SMALL_AVX2;
+  }
+#endif
+  return LIMBS_MOD_SMALL_SCALAR;
+}
+
+void LimbsModSmallWith(LimbsModSmallKernel kernel, const uint64_t* a, int len,
+                       const uint32_t* divisors, int count,
+                       uint32_t* residues) {
+  switch (kernel) {
+#if defined(__x86_64__)
+    case LIMBS_MOD_SMALL_AVX512:
+      ModSmallAvx512(a, len, divisors, count, residues);
+      return;
+    case LIMBS_MOD_SMALL_AVX2:
+      ModSmallAvx2(a, len, divisors, count, residues);
+      return;
+#endif
+    default:
+      ModSmallScalar(a, len, divisors, count, residues);
+  }
+}
+
+// The kernel LimbsModSmall uses, chosen once at startup so that the CPU is
+// not queried on every call.
+static LimbsModSmallKernel mod_small_kernel;
+
+__attribute__((constructor)) static void ChooseModSmallKernel(void) {
+  // Constructors may run before the CPU model is set up.
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+#endif
+  mod_small_kernel = LimbsModSmallBestKernel();
+}
+
+void LimbsModSmall(const uint64_t* a, int len, const uint32_t* divisors,
+                   int count, uint32_t* residues) {
+  LimbsModSmallWith(mod_small_kernel, a, len, divisors, count, residues);
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LARGE_U_INT_LIMBS_H
+#define LARGE_U_INT_LIMBS_H
+
+#include <stdint.h>
+
+// Low level arithmetic on arrays of 64 bit limbs, least significant limb
+// first. These are the building blocks for LargeUInt and do no allocation or
+// size checking of their own; callers provide every output and scratch array.
+
+// Products and sums of two limbs are computed in double width so that the
+// carry, or the high limb of a product, is available in the upper half.
+typedef unsigned __int128 DoubleLimb;
+
+// Operands of at least this many limbs are multiplied with Karatsuba's method,
+// shorter ones with the schoolbook method. Measured with karatsuba-benchmark
+// on x86-64, where Karatsuba was consistently faster from about 40 limbs
+// (2560 bits) on.
+#ifndef KARATSUBA_THRESHOLD
+#define KARATSUBA_THRESHOLD 40
+#endif
+
+// Adds the b_len limbs of b to the a_len limbs of a, writing a_len limbs into
+// result and returning the carry out of the top limb. Requires a_len >= b_len.
+// The result may be the same array as either input.
+uint64_t LimbsAdd(const uint64_t* a, int a_len, const uint64_t* b, int b_len,
+                  uint64_t* result);
+
+// Subtracts the b_len limbs of b from the a_len limbs of a, writing a_len limbs
+// into result and returning the borrow out of the top limb. Requires
+// a_len >= b_len. The result may be the same array as either input.
+uint64_t LimbsSub(const uint64_t* a, int a_len, const uint64_t* b, int b_len,
+                  uint64_t* result);
+
+// Adds the len limbs of a multiplied by multiplier into the first len limbs of
+// result, returning the limb carried out of the top.
+uint64_t LimbsAddMul(const uint64_t* a, int len, uint64_t multiplier,
+                     uint64_t* result);
+
+// Subtracts the len limbs of a multiplied by multiplier from the first len
+// limbs of result, returning the limb borrowed from above the top.
+uint64_t LimbsSubMul(const uint64_t* a, int len, uint64_t multiplier,
+                     uint64_t* result);
+
+// Shifts the len limbs of a up by bits, 0 <= bits < 64, writing len limbs into
+// result and returning the bits shifted out of the top limb. The result may
+// be the same array as a.
+uint64_t LimbsShiftLeft(const uint64_t* a, int len, int bits,
+                        uint64_t* result);
+
+// Shifts the len limbs of a down by bits, 0 <= bits < 64, writing len limbs
+// into result. The result may be the same array as a.
+void LimbsShiftRight(const uint64_t* a, int len, int bits, uint64_t* result);
+
+// Schoolbook multiplication writing all a_len + b_len limbs of the product
+// into result, which must not overlap either input.
+void LimbsMulSchoolbook(const uint64_t* a, int a_len, const uint64_t* b,
+                        int b_len, uint64_t* result);
+
+// Multiplies two len limb numbers, len >= 2, by splitting each in half and
+// forming the product from three half sized products. The half sized products
+// use Karatsuba again or the schoolbook method depending on
+// KARATSUBA_THRESHOLD. Writes 2 * len limbs into result, which must not
+// overlap either input. scratch must hold LimbsMulKaratsubaScratchSize(len)
+// limbs.
+void LimbsMulKaratsuba(const uint64_t* a, const uint64_t* b, int len,
+                       uint64_t* result, uint64_t* scratch);
+
+// The number of scratch limbs LimbsMulKaratsuba needs for len limb operands.
+int LimbsMulKaratsubaScratchSize(int len);
+
+// The number of scratch limbs LimbsMul needs when neither operand is longer
+// than len limbs. Zero below KARATSUBA_THRESHOLD.
+int LimbsMulScratchSize(int len);
+
+// Writes all a_len + b_len limbs of the product of a and b into result, which
+// must not overlap either input. Picks schoolbook or Karatsuba multiplication
+// by size. scratch must hold LimbsMulScratchSize of the longer length, and may
+// be NULL when that is zero.
+void LimbsMul(const uint64_t* a, int a_len, const uint64_t* b, int b_len,
+              uint64_t* result, uint64_t* scratch);
+
+// Writes the 2 * len limbs of the square of a into result, which must not
+// overlap a. Below KARATSUBA_THRESHOLD each cross product is computed once
+// and doubled. scratch must hold LimbsMulScratchSize(len) limbs, and may be
+// NULL when that is zero.
+void LimbsSqr(const uint64_t* a, int len, uint64_t* result, uint64_t* scratch);
+
+// Returns -1 / modulus mod 2^64 for an odd modulus, as used by
+// LimbsMontRedc.
+uint64_t LimbsMontInverse(uint64_t modulus);
+
+// Montgomery reduction. Given the 2 * len limbs of t, which must be less than
+// modulus * 2^(64 * len), writes the len limbs of t / 2^(64 * len) mod
+// modulus into result. inverse comes from LimbsMontInverse of the lowest
+// modulus limb. t is used as working space and left in an unspecified state.
+void LimbsMontRedc(uint64_t* t, const uint64_t* modulus, int len,
+                   uint64_t inverse, uint64_t* result);
+
+// Returns floor((2^128 - 1) / divisor) - 2^64 for a divisor with its top bit
+// set. Multiplying by this stands in for dividing by the divisor.
+uint64_t LimbsReciprocal(uint64_t divisor);
+
+// Divides the len limbs of a by a single non-zero limb, writing len quotient
+// limbs into quotient unless it is NULL, and returns the remainder. Each limb
+// costs a couple of multiplications against a precomputed reciprocal rather
+// than a hardware division. The quotient may be the same array as a.
+uint64_t LimbsDivRemLimb(const uint64_t* a, int len, uint64_t divisor,
+                         uint64_t* quotient);
+
+// The ways LimbsModSmall can be computed. The vector kernels keep one
+// divisor per lane as a double, which holds every intermediate value exactly
+// for divisors below 2^32, and reduce 8 or 16 divisors in each pass over the
+// limbs.
+typedef enum {
+  LIMBS_MOD_SMALL_SCALAR,
+  LIMBS_MOD_SMALL_AVX2,
+  LIMBS_MOD_SMALL_AVX512
+} LimbsModSmallKernel;
+
+// Returns the fastest kernel the running CPU supports. The kernels are listed
+// in order, so every kernel up to this one is supported too.
+LimbsModSmallKernel LimbsModSmallBestKernel(void);
+
+// Writes the len limbs of a mod each of the count divisors into residues.
+// Every divisor must be at least 1. Uses the best kernel for the CPU.
+void LimbsModSmall(const uint64_t* a, int len, const uint32_t* divisors,
+                   int count, uint32_t* residues);
+
+// LimbsModSmall with the given kernel, which the CPU must support.
+void LimbsModSmallWith(LimbsModSmallKernel kernel, const uint64_t* a, int len,
+                       const uint32_t* divisors, int count,
+                       uint32_t* residues);
+
+// The number of scratch limbs LimbsDivRem needs for the given lengths.
+int LimbsDivRemScratchSize(int numerator_len, int denominator_len);
+
+// Long division (Knuth's Algorithm D) of the numerator_len limbs of numerator
+// by the denominator_len limbs of denominator. Requires
+// numerator_len >= denominator_len >= 1 and a non-zero top denominator limb.
+// Writes numerator_len - denominator_len + 1 quotient limbs into quotient
+// unless it is NULL, and denominator_len remainder limbs into remainder. The
+// outputs must not overlap the inputs. scratch must hold
+// LimbsDivRemScratchSize limbs.
+void LimbsDivRem(const uint64_t* numerator, int numerator_len,
+                 const uint64_t* denominator, int denominator_len,
+                 uint64_t* quotient, uint64_t* remainder, uint64_t* scratch);
+
+#endif
@@ -14,8 +14,13 @@
  * limitations under the License.
  */
 
+#include "batch-writer.h"
+#include "block-pipeline.h"
 #include "large-u-int.h"
+#include "primes-file.h"
+#include "wheel.h"
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -28,83 +33,498 @@ void PrintPrime(LargeUInt* prime, FILE* out) {
   fprintf(out, "\n");
 }
 
-void FindNearbyPrime(LargeUInt* candidate) {
-  if (LargeUIntGetByte(0, candidate) % 2 == 0) {
-    LargeUIntIncrement(candidate);
+// Trial divisors are taken from the primes file itself, which holds every
+// prime found so far. They are kept as the gaps between consecutive primes,
+// in fixed size chunks so that they never move while other threads read
+// them. MAX_DIVISOR_CHUNKS reaches past the primes below 2^32, which are all
+// the divisors a candidate below 2^64 needs.
+#define DIVISOR_CHUNK_PRIMES (1 << 20)
+#define MAX_DIVISOR_CHUNKS 256
+
+// The primes below SIEVE_LIMIT also sieve whole blocks, for which the table
+// keeps the first candidate mod each of them. There are MAX_SIEVE_PRIMES odd
+// primes below SIEVE_LIMIT.
+#define SIEVE_LIMIT (1 << 20)
+#define MAX_SIEVE_PRIMES 82024
+
+// The odd primes from 3 up to last, read in order from the primes file. Only
+// the thread that commits blocks reads the file or adds primes, and it
+// publishes the count under lock. Every gap below the published count stays
+// valid. The table stops growing, leaving the wheel to supply any divisors
+// past it, if the file does not start with the first primes or holds one
+// that does not fit.
+typedef struct {
+  uint16_t* chunks[MAX_DIVISOR_CHUNKS];
+  size_t num_primes;
+  uint64_t last;
+  // Reads the primes file, or NULL once the table has stopped growing.
+  FILE* in;
+  LargeUIntBinaryReader reader;
+  // The size of the file before anything was appended to it in this run.
+  long start_size;
+  // base mod each prime below SIEVE_LIMIT, in the same order.
+  const LargeUInt* base;
+  uint32_t* residues;
+  pthread_mutex_t lock;
+  size_t published_primes;
+} DivisorTable;
+
+// Opens the primes file to read divisors from. Call this once the file has
+// been opened for appending and before anything is appended to it. base must
+// hold its final value by the time the table first grows.
+void DivisorTableOpen(char* filename, const LargeUInt* base,
+                      DivisorTable* table) {
+  table->base = base;
+  table->residues = malloc(MAX_SIEVE_PRIMES * sizeof(uint32_t));
+  if (table->residues == NULL) {
+    printf("Unable to allocate space for residues.\n");
+    exit(1);
+  }
+  table->in = fopen(filename, "rb");
+  if (table->in != NULL) {
+    fseek(table->in, 0, SEEK_END);
+    table->start_size = ftell(table->in);
+    rewind(table->in);
+    LargeUIntBinaryReaderInit(table->in, &table->reader);
+  }
+  pthread_mutex_init(&table->lock, NULL);
+}
+
+// Stops reading the primes file, so the table keeps what it has.
+void StopDivisorTable(DivisorTable* table) {
+  if (table->in != NULL) {
+    LargeUIntBinaryReaderClose(&table->reader);
+    fclose(table->in);
+    table->in = NULL;
+  }
+}
+
+void DivisorTableFree(DivisorTable* table) {
+  StopDivisorTable(table);
+  size_t i;
+  for (i = 0; i * DIVISOR_CHUNK_PRIMES < table->num_primes; i++) {
+    free(table->chunks[i]);
+  }
+  free(table->residues);
+  pthread_mutex_destroy(&table->lock);
+}
+
+// Reads the next prime in the file, leaving the file at the start of the line
+// or binary block after it. Returns 0 without reading once the file holds
+// nothing more before readable_end, past which lines may not be whole yet.
+int ReadDivisor(long readable_end, DivisorTable* table, LargeUInt* prime) {
+  if (ftell(table->in) >= readable_end) {
+    return 0;
+  }
+  LargeUIntBinaryRead(&table->reader, prime);
+  // Skip the comment that ends a text line.
+  int current = fgetc(table->in);
+  if (current == ' ' || current == '#' || current == '\r') {
+    while (current != '\n' && current != EOF) {
+      current = fgetc(table->in);
+    }
+  } else if (current != '\n' && current != EOF) {
+    ungetc(current, table->in);
   }
+  clearerr(table->in);
+  return LargeUIntNumBytes(prime) != 0;
+}
 
-  LargeUInt quotient;
-  LargeUInt remainder;
+// Adds primes from the file until the table reaches target, or until the
+// primes flushed to the file so far run out.
+void GrowDivisorTable(uint64_t target, long readable_end,
+                      DivisorTable* table) {
+  LargeUInt prime = {0};
+  while (table->in != NULL && table->last < target &&
+         ReadDivisor(readable_end, table, &prime)) {
+    uint64_t value = LargeUIntGetWord(&prime);
+    if (table->num_primes == 0 && value == 2 &&
+        LargeUIntNumBytes(&prime) == 1) {
+      continue;
+    }
+    if (LargeUIntNumBytes(&prime) > 8 || value <= table->last ||
+        value - table->last > UINT16_MAX ||
+        (table->num_primes == 0 && value != 3) ||
+        table->num_primes == MAX_DIVISOR_CHUNKS * DIVISOR_CHUNK_PRIMES ||
+        (table->num_primes >= MAX_SIEVE_PRIMES && value < SIEVE_LIMIT)) {
+      StopDivisorTable(table);
+      break;
+    }
+    size_t chunk = table->num_primes / DIVISOR_CHUNK_PRIMES;
+    if (table->num_primes % DIVISOR_CHUNK_PRIMES == 0) {
+      table->chunks[chunk] = malloc(DIVISOR_CHUNK_PRIMES * sizeof(uint16_t));
+      if (table->chunks[chunk] == NULL) {
+        printf("Unable to allocate space for divisors.\n");
+        exit(1);
+      }
+    }
+    table->chunks[chunk][table->num_primes % DIVISOR_CHUNK_PRIMES] =
+        value - table->last;
+    if (value < SIEVE_LIMIT) {
+      table->residues[table->num_primes] =
+          LargeUIntModWord(table->base, value);
+    }
+    table->num_primes++;
+    table->last = value;
+  }
+  LargeUIntFree(&prime);
+  pthread_mutex_lock(&table->lock);
+  table->published_primes = table->num_primes;
+  pthread_mutex_unlock(&table->lock);
+}
 
-  LargeUInt max_divisor;
+// Returns how many primes of the table can be read.
+size_t GetDivisors(DivisorTable* table) {
+  pthread_mutex_lock(&table->lock);
+  size_t num_primes = table->published_primes;
+  pthread_mutex_unlock(&table->lock);
+  return num_primes;
+}
+
+// The table's primes below 2^32 are tried this many at a time.
+#define SMALL_DIVISOR_BATCH 64
+
+// Returns 1 if the candidate, which has no factor up to prime_before, has no
+// divisor up to its square root. The primes in the table from first_index up
+// to num_primes are tried first, then divisors on the wheel past them.
+// prime_before is at least 7, and it is the prime just before first_index
+// whenever there are primes left to try in the table.
+int IsPrime(const LargeUInt* candidate, const DivisorTable* table,
+            size_t num_primes, size_t first_index, uint64_t prime_before) {
+  LargeUInt max_divisor = {0};
   LargeUIntApproximateSquareRoot(candidate, &max_divisor);
-  LargeUInt divisor;
-  LargeUIntInit(1, &divisor);
-  LargeUIntSetByte(3, 0, &divisor);
+  uint64_t max_word = LargeUIntNumBytes(&max_divisor) <= 8 ?
+                      LargeUIntGetWord(&max_divisor) : UINT64_MAX;
+  uint64_t prime = prime_before;
+  size_t i = first_index;
+  int has_factor = 0;
+  int past_root = 0;
+  while (i < num_primes && !has_factor && !past_root) {
+    // Primes below 2^32 are tried a batch at a time, each batch reducing the
+    // candidate in one pass. Any past that are tried one by one.
+    uint32_t divisors[SMALL_DIVISOR_BATCH];
+    uint32_t residues[SMALL_DIVISOR_BATCH];
+    int count = 0;
+    while (count < SMALL_DIVISOR_BATCH && i < num_primes) {
+      uint64_t next = prime +
+          table->chunks[i / DIVISOR_CHUNK_PRIMES][i % DIVISOR_CHUNK_PRIMES];
+      if (next > max_word) {
+        past_root = 1;
+        break;
+      }
+      if (next > UINT32_MAX && count > 0) {
+        break;
+      }
+      prime = next;
+      i++;
+      if (next > UINT32_MAX) {
+        has_factor = LargeUIntModWord(candidate, prime) == 0;
+        break;
+      }
+      divisors[count++] = prime;
+    }
+    LargeUIntModSmall(candidate, divisors, count, residues);
+    int j;
+    for (j = 0; j < count; j++) {
+      if (residues[j] == 0) {
+        has_factor = 1;
+      }
+    }
+  }
+  if (has_factor || past_root) {
+    LargeUIntFree(&max_divisor);
+    return !has_factor;
+  }
+
+  uint64_t first_divisor = prime < WHEEL_FIRST_DIVISOR ?
+                           WHEEL_FIRST_DIVISOR : prime + 1;
+  Wheel wheel;
+  first_divisor += WheelStart(first_divisor % WHEEL_MODULUS, &wheel);
+  LargeUInt divisor = {0};
+  LargeUIntSetWord(first_divisor, &divisor);
+  int is_prime = 1;
   while (LargeUIntCompare(&divisor, &max_divisor) >= 0) {
-    LargeUIntDivide(candidate, &divisor, &quotient, &remainder);
-    if (LargeUIntNumBytes(&remainder) == 0) {
-      LargeUIntAddByte(2, candidate);
-      LargeUIntInit(1, &divisor);
-      LargeUIntSetByte(3, 0, &divisor);
-      LargeUIntApproximateSquareRoot(candidate, &max_divisor);
+    if (LargeUIntIsDivisibleBy(candidate, &divisor)) {
+      is_prime = 0;
+      break;
+    }
+    LargeUIntAddByte(WheelNext(&wheel), &divisor);
+  }
+  LargeUIntFree(&max_divisor);
+  LargeUIntFree(&divisor);
+  return is_prime;
+}
+
+// Each block covers this many numbers, which are sieved together before the
+// ones left are tested.
+#define BLOCK_NUMBERS (1 << 16)
+
+// By default the primes file is flushed to disk after this many new primes,
+// or this long after the first of them was found.
+#define DEFAULT_FLUSH_PRIMES 1000
+#define DEFAULT_FLUSH_MS 1000
+
+typedef struct {
+  int num_threads;
+  int flush_primes;
+  int flush_ms;
+  int probable;
+} Options;
+
+typedef struct {
+  BatchWriter writer;
+  // The first odd number after the highest prime already in the file.
+  LargeUInt first;
+  DivisorTable divisors;
+  // Set to give the numbers left after sieving a Baillie-PSW test in place of
+  // trial division.
+  int probable;
+} Finder;
+
+// Adds the line for prime in the primes file format to output.
+void StorePrime(const LargeUInt* prime, BlockOutput* output) {
+  int size = LargeUIntBufferSize(prime) + 1;
+  int base_10_size = LargeUIntBase10BufferSize(prime);
+  char* buffer = malloc(size > base_10_size ? size : base_10_size);
+  if (buffer == NULL) {
+    printf("Unable to allocate space for a prime.\n");
+    exit(1);
+  }
+  LargeUIntStore(prime, size, buffer);
+  BlockOutputAppend(buffer, strlen(buffer), output);
+  BlockOutputAppend(" # int value: ", 14, output);
+  LargeUIntBase10Store(prime, base_10_size, buffer);
+  BlockOutputAppend(buffer, strlen(buffer), output);
+  BlockOutputAppend("\n", 1, output);
+  free(buffer);
+}
+
+// Crosses the odd multiples of prime, other than prime itself, off the sieve
+// of a block. Bit i of the sieve stands for start + 2 * i, where start is odd
+// and residue is start mod prime. start_word is start if it fits in a word.
+void CrossOff(uint64_t prime, uint64_t residue, uint64_t start_word,
+              uint64_t* sieve) {
+  uint64_t offset;
+  if (prime * prime > start_word) {
+    offset = prime * prime - start_word;
+  } else {
+    offset = (prime - residue) % prime;
+    if (offset % 2 == 1) {
+      offset += prime;
+    }
+  }
+  uint64_t bit;
+  for (bit = offset / 2; bit < BLOCK_NUMBERS / 2; bit += prime) {
+    sieve[bit / 64] |= (uint64_t) 1 << (bit % 64);
+  }
+}
+
+// Sieves the odd numbers among the BLOCK_NUMBERS that make up the block with
+// the table's primes below SIEVE_LIMIT, then adds the lines for the primes
+// among the numbers left to output. Those only need trial division, or the
+// probable prime test, when the sieve stopped short of the square root of the
+// block's end. There is no end to the range, so this only returns 0 once
+// asked to stop.
+int SearchBlock(long block, void* context, BlockOutput* output) {
+  Finder* finder = context;
+  const DivisorTable* table = &finder->divisors;
+  uint64_t offset = (uint64_t) BLOCK_NUMBERS * block;
+  LargeUInt candidate = {0};
+  LargeUIntSetWord(offset, &candidate);
+  LargeUIntAdd(&finder->first, &candidate);
+  uint64_t start_word = LargeUIntNumBytes(&candidate) <= 8 ?
+                        LargeUIntGetWord(&candidate) : UINT64_MAX;
+  LargeUInt end = {0};
+  LargeUInt root = {0};
+  LargeUIntSetWord(BLOCK_NUMBERS, &end);
+  LargeUIntAdd(&candidate, &end);
+  LargeUIntApproximateSquareRoot(&end, &root);
+  uint64_t max_prime = LargeUIntNumBytes(&root) <= 8 ?
+                       LargeUIntGetWord(&root) : UINT64_MAX;
+  LargeUIntFree(&end);
+  LargeUIntFree(&root);
+
+  // 3, 5 and 7 are always sieved, and the table starts with them when it has
+  // anything at all. The other primes use the residues kept in the table, so
+  // no large number arithmetic is needed for them.
+  uint64_t sieve[BLOCK_NUMBERS / 128];
+  memset(sieve, 0, sizeof(sieve));
+  uint64_t prime;
+  for (prime = 3; prime <= 7; prime += 2) {
+    CrossOff(prime, LargeUIntModWord(&candidate, prime), start_word, sieve);
+  }
+  prime = 7;
+  size_t num_divisors = GetDivisors(&finder->divisors);
+  size_t num_sieved = num_divisors < 3 ? num_divisors : 3;
+  int sieved_to_root = max_prime <= prime;
+  while (num_sieved < num_divisors && !sieved_to_root) {
+    uint64_t next = prime + table->chunks[num_sieved / DIVISOR_CHUNK_PRIMES]
+                                         [num_sieved % DIVISOR_CHUNK_PRIMES];
+    if (next > max_prime) {
+      sieved_to_root = 1;
+    } else if (next >= SIEVE_LIMIT) {
+      break;
     } else {
-      LargeUIntAddByte(2, &divisor);
+      CrossOff(next, (table->residues[num_sieved] + offset % next) % next,
+               start_word, sieve);
+      prime = next;
+      num_sieved++;
     }
   }
 
-  // We ran out of divisors so the value stored in candidate is prime.
+  LargeUInt step = {0};
+  uint64_t last_bit = 0;
+  uint64_t bit;
+  int stopped = 0;
+  for (bit = 0; bit < BLOCK_NUMBERS / 2 && !stopped; bit++) {
+    if (sieve[bit / 64] >> (bit % 64) & 1) {
+      continue;
+    }
+    LargeUIntSetWord(2 * (bit - last_bit), &step);
+    LargeUIntAdd(&step, &candidate);
+    last_bit = bit;
+    stopped = BatchWriterStopRequested();
+    if (!stopped &&
+        (sieved_to_root ||
+         (finder->probable ? LargeUIntIsProbablePrime(&candidate) :
+                             IsPrime(&candidate, table, num_divisors,
+                                     num_sieved, prime)))) {
+      StorePrime(&candidate, output);
+    }
+  }
+  LargeUIntFree(&step);
+  LargeUIntFree(&candidate);
+  return !stopped;
 }
 
-void LoadNextPrime(FILE* primes, LargeUInt* prime) {
-  LargeUIntRead(primes, prime);
+// Worker threads never see their pools again once they exit.
+void ReleaseWorkerPool(void* context) {
+  LargeUIntReleasePool();
 }
 
-void FindHighestPrime(char* filename, LargeUInt* prime) {
-  FILE* primes = fopen(filename, "r");
-  if (primes == NULL) {
-    LargeUIntInit(0, prime);
+// Grows the divisor table to twice the square root of end, which leaves
+// room for the blocks being tested ahead of it. Probable primes are only
+// sieved, so then the table stops at SIEVE_LIMIT.
+void GrowDivisors(const LargeUInt* end, Finder* finder) {
+  if (finder->divisors.in == NULL) {
     return;
   }
-
-  LargeUInt next_prime;
-  LoadNextPrime(primes, &next_prime);
-  while (LargeUIntNumBytes(&next_prime) != 0) {
-    LargeUIntClone(&next_prime, prime);
-    LoadNextPrime(primes, &next_prime);
+  LargeUInt root = {0};
+  LargeUIntApproximateSquareRoot(end, &root);
+  uint64_t target = LargeUIntNumBytes(&root) <= 7 ?
+                    2 * LargeUIntGetWord(&root) : UINT64_MAX;
+  LargeUIntFree(&root);
+  if (finder->probable && target > SIEVE_LIMIT) {
+    target = SIEVE_LIMIT;
   }
-  fclose(primes);
-  return;
+  GrowDivisorTable(target, finder->divisors.start_size +
+                   (long) BatchWriterFlushedBytes(&finder->writer),
+                   &finder->divisors);
 }
 
-void AppendPrime(char* filename, LargeUInt* prime) {
-  FILE* primes = fopen(filename, "a");
-  PrintPrime(prime, primes);
-  fclose(primes);
+// Queues the lines of a finished block to be appended to the primes file, and
+// grows the divisor table to keep ahead of the blocks still being tested.
+void CommitBlock(long block, const BlockOutput* output, void* context) {
+  Finder* finder = context;
+  BatchWriterAppend(output->data, output->size, &finder->writer);
+  LargeUInt end = {0};
+  LargeUIntSetWord((uint64_t) BLOCK_NUMBERS * (block + 1), &end);
+  LargeUIntAdd(&finder->first, &end);
+  GrowDivisors(&end, finder);
+  LargeUIntFree(&end);
 }
 
-void GeneratePrimes(char* filename) {
+// Appends primes to the file from the first one after the highest prime in
+// it. Blocks of candidates are tested on several threads at once and
+// appended in order, so the file always ends on a whole block. SIGINT and
+// SIGTERM stop the search once the blocks before are written.
+void GeneratePrimes(char* filename, const Options* options) {
   // Start by finding the higest prime that we have so far.
-  LargeUInt candidate;
+  Finder finder = {0};
+  finder.probable = options->probable;
   printf("Looking for highest prime already found.\n");
-  FindHighestPrime(filename, &candidate);
+  ReadHighestPrime(filename, &finder.first);
   printf("Starting from highest prime found so far: ");
-  PrintPrime(&candidate, stdout);
+  PrintPrime(&finder.first, stdout);
   printf("\n");
 
   // Add two to start trying new primes.
-  LargeUIntAddByte(2, &candidate);
+  LargeUIntAddByte(2, &finder.first);
+  if (LargeUIntGetByte(0, &finder.first) % 2 == 0) {
+    LargeUIntIncrement(&finder.first);
+  }
 
-  while(1) {
-    FindNearbyPrime(&candidate);
-    AppendPrime(filename, &candidate);
-    printf("Found prime: ");
-    PrintPrime(&candidate, stdout);
-    LargeUIntAddByte(2, &candidate);
+  BatchWriterOpen(filename, options->flush_primes, options->flush_ms,
+                  &finder.writer);
+  BatchWriterCatchSignals();
+  DivisorTableOpen(filename, &finder.first, &finder.divisors);
+
+  // The wheel steps over 3, 5 and 7, so they are written here and the
+  // search starts past them.
+  if (LargeUIntNumBytes(&finder.first) <= 1 &&
+      LargeUIntGetWord(&finder.first) <= 7) {
+    BlockOutput output = {0};
+    LargeUInt prime = {0};
+    LargeUIntInit(1, &prime);
+    int value;
+    for (value = WheelSmallOddPrime(LargeUIntGetWord(&finder.first));
+         value <= 7; value = WheelSmallOddPrime(value + 1)) {
+      LargeUIntSetByte(value, 0, &prime);
+      StorePrime(&prime, &output);
+    }
+    BatchWriterAppend(output.data, output.size, &finder.writer);
+    free(output.data);
+    LargeUIntFree(&prime);
+    LargeUIntSetByte(9, 0, &finder.first);
   }
+  GrowDivisors(&finder.first, &finder);
+  RunBlockPipeline(options->num_threads, SearchBlock, CommitBlock,
+                   ReleaseWorkerPool, &finder);
+  BatchWriterClose(&finder.writer);
+  printf("Stopped, every prime found has been saved.\n");
+  LargeUIntFree(&finder.first);
+  DivisorTableFree(&finder.divisors);
 }
 
-int main() {
-  GeneratePrimes("primes");
+// Returns the value of text as a count, or -1 if it is not one.
+int ParseCount(char* text) {
+  char* end;
+  long value = strtol(text, &end, 10);
+  if (end == text || *end != '\0' || value < 0 || value > INT32_MAX) {
+    return -1;
+  }
+  return value;
 }
 
+int main(int argc, char *argv[]) {
+  Options options = {1, DEFAULT_FLUSH_PRIMES, DEFAULT_FLUSH_MS, 0};
+  int i;
+  for (i = 1; i < argc; i++) {
+    int value = i + 1 < argc ? ParseCount(argv[i + 1]) : -1;
+    if (strcmp(argv[i], "-j") == 0 && value > 0) {
+      options.num_threads = value;
+      i++;
+    } else if (strcmp(argv[i], "--flush-primes") == 0 && value >= 0) {
+      options.flush_primes = value;
+      i++;
+    } else if (strcmp(argv[i], "--flush-ms") == 0 && value >= 0) {
+      options.flush_ms = value;
+      i++;
+    } else if (strcmp(argv[i], "--probable") == 0) {
+      options.probable = 1;
+    } else {
+      printf("Usage: %s [-j threads] [--flush-primes count]"
+             " [--flush-ms milliseconds] [--probable]\n", argv[0]);
+      printf("With -j, blocks of candidates are tested on that many "
+             "threads.\n");
+      printf("New primes are flushed to disk once --flush-primes are\n");
+      printf("waiting or --flush-ms after the first, by default %d or %d.\n",
+             DEFAULT_FLUSH_PRIMES, DEFAULT_FLUSH_MS);
+      printf("Either may be 0 to leave it out.\n");
+      printf("With --probable, the numbers left after sieving are given a\n");
+      printf("Baillie-PSW test in place of trial division.\n");
+      return 1;
+    }
+  }
+  GeneratePrimes("primes", &options);
+}
@@ -27,13 +27,13 @@ void Check(int condition, char* message) {
 }
 
 void CheckLargeUInt(char* expected, LargeUInt* this, char* message) {
-  char buffer[65];
-  LargeUIntStore(this, 65, buffer);
-  Check(0 == strncmp(expected, buffer, 65), message);
+  char buffer[256];
+  LargeUIntStore(this, 256, buffer);
+  Check(0 == strncmp(expected, buffer, 256), message);
 }
 
 void TestGetSetAndNumBytes() {
-  LargeUInt num;
+  LargeUInt num = {0};
   LargeUIntInit(3, &num);
   Check(3 == LargeUIntNumBytes(&num), "Num should be 3 bytes long.");
   LargeUIntSetByte(255, 0, &num);
@@ -42,11 +42,28 @@ void TestGetSetAndNumBytes() {
   Check(255 == LargeUIntGetByte(0, &num), "Num byte 0 should be 255");
   Check(1 == LargeUIntGetByte(1, &num), "Num byte 0 should be 1");
   Check(76 == LargeUIntGetByte(2, &num), "Num byte 0 should be 76");
+
+  LargeUIntInit(12, &num);
+  LargeUIntSetByte(171, 8, &num);
+  LargeUIntSetByte(7, 11, &num);
+  Check(171 == LargeUIntGetByte(8, &num), "Num byte 8 should be 171");
+  Check(0 == LargeUIntGetByte(9, &num), "Num byte 9 should be 0");
+  Check(7 == LargeUIntGetByte(11, &num), "Num byte 11 should be 7");
+  CheckLargeUInt("0C00_0000000000000000AB000007", &num,
+                 "Bytes should be stored across two limbs");
+
+  LargeUIntSetWord(0x3FF, &num);
+  CheckLargeUInt("0200_FF03", &num, "Word should take only the bytes it needs");
+  LargeUIntSetWord(UINT64_MAX, &num);
+  Check(8 == LargeUIntNumBytes(&num) && LargeUIntGetWord(&num) == UINT64_MAX,
+        "Largest word should take 8 bytes");
+  LargeUIntSetWord(0, &num);
+  Check(0 == LargeUIntNumBytes(&num), "Zero word should take no bytes");
 }
 
 void TestLoadAndStore() {
   char a_str[30];
-  LargeUInt a_int;
+  LargeUInt a_int = {0};
   LargeUIntInit(2, &a_int);
   LargeUIntSetByte(12, 0, &a_int); 
   LargeUIntSetByte(99, 1, &a_int);
@@ -76,7 +93,7 @@ void TestLoadAndStore() {
 }
 
 void TestGrowAndTrim() {
-  LargeUInt num;
+  LargeUInt num = {0};
   char* numstr = "0300_000001";
   LargeUIntLoad(strlen(numstr), numstr, &num);
   Check(3 == LargeUIntNumBytes(&num), "Initially should have 3 bytes");
@@ -91,7 +108,8 @@ void TestGrowAndTrim() {
 }
 
 void TestCompare() {
-  LargeUInt a, b;
+  LargeUInt a = {0};
+  LargeUInt b = {0};
   LargeUIntLoad(11, "0300_431232", &a);
   LargeUIntLoad(9, "0200_4312", &b);
   Check(-1 == LargeUIntCompare(&a, &b),
@@ -128,14 +146,15 @@ void TestCompare() {
 }
 
 void TestClone() {
-  LargeUInt a, b;
+  LargeUInt a = {0};
+  LargeUInt b = {0};
   LargeUIntLoad(11, "0300_AABBCC", &a);
   LargeUIntClone(&a, &b);
   Check(0 == LargeUIntCompare(&a, &b), "Cloned int should equal original");
 }
 
 void TestShift() {
-  LargeUInt a;
+  LargeUInt a = {0};
   LargeUIntLoad(11, "0300_AABBCC", &a);
   LargeUIntByteShiftInc(&a);
   CheckLargeUInt("0400_00AABBCC", &a, "Shift should add low order zero");
@@ -176,7 +195,8 @@ void TestShift() {
 }
 
 void TestAddAndIncrement() {
-  LargeUInt a, b;
+  LargeUInt a = {0};
+  LargeUInt b = {0};
   LargeUIntLoad(11, "0300_FFFFFF", &a);
   LargeUIntLoad(7, "0100_02", &b);
   LargeUIntAdd(&b, &a);
@@ -195,10 +215,23 @@ void TestAddAndIncrement() {
   LargeUIntLoad(11, "0300_FFFFFF", &a);
   LargeUIntAddByte(3, &a);
   CheckLargeUInt("0400_02000001", &a, "Add byte 2 should carry to grow a");
+
+  // Carries have to cross from one 8 byte limb into the next.
+  LargeUIntLoad(21, "0800_FFFFFFFFFFFFFFFF", &a);
+  LargeUIntIncrement(&a);
+  CheckLargeUInt("0900_000000000000000001", &a,
+                 "Increment should carry into a second limb");
+
+  LargeUIntLoad(25, "0A00_FFFFFFFFFFFFFFFFFF01", &a);
+  LargeUIntLoad(21, "0800_0100000000000000", &b);
+  LargeUIntAdd(&b, &a);
+  CheckLargeUInt("0A00_00000000000000000002", &a,
+                 "Add should carry across the limb boundary");
 }
 
 void TestSubAndDecrement() {
-  LargeUInt a, b;
+  LargeUInt a = {0};
+  LargeUInt b = {0};
   LargeUIntLoad(11, "0300_00000F", &a);
   LargeUIntLoad(7, "0100_03", &b);
   LargeUIntSub(&b, &a); // 983040 - 3 = 983037
@@ -218,10 +251,23 @@ void TestSubAndDecrement() {
   LargeUIntLoad(7, "0100_01", &a);
   LargeUIntDecrement(&a);
   CheckLargeUInt("0000_", &a, "After decrement should be 0");
+
+  // Borrows have to cross from one 8 byte limb into the next.
+  LargeUIntLoad(23, "0900_000000000000000001", &a);
+  LargeUIntDecrement(&a);
+  CheckLargeUInt("0800_FFFFFFFFFFFFFFFF", &a,
+                 "Decrement should borrow from the second limb");
+
+  LargeUIntLoad(25, "0A00_00000000000000000002", &a);
+  LargeUIntLoad(7, "0100_01", &b);
+  LargeUIntSub(&b, &a);
+  CheckLargeUInt("0A00_FFFFFFFFFFFFFFFFFF01", &a,
+                 "Sub should borrow across the limb boundary");
 }
 
 void TestMultiply() {
-  LargeUInt a, b;
+  LargeUInt a = {0};
+  LargeUInt b = {0};
   LargeUIntLoad(7, "0100_05", &a);
   LargeUIntLoad(7, "0100_03", &b);
   LargeUIntMultiply(&b, &a);
@@ -234,10 +280,49 @@ void TestMultiply() {
   LargeUIntMultiply(&b, &a);
   CheckLargeUInt("0700_A0079200AB9C01", &a,
                  "Result should be 453,733,239,621,536");
-} 
+
+  // Multipliers this large would never finish with repeated addition.
+  // In base 16: 0x123456789ABCDEF0011223344556677 *
+  //              0xFEDCBA98765432100F1E2D3C4B5A
+  LargeUIntLoad(37, "1000_7766554433221100EFCDAB8967452301", &a);
+  LargeUIntLoad(33, "0E00_5A4B3C2D1E0F1032547698BADCFE", &b);
+  LargeUIntMultiply(&b, &a);
+  CheckLargeUInt(
+      "1E00_D6E2EEF9030D85BA7AE13A42B349E1E14A4FAB1A592242D777AD00FA2101", &a,
+      "Result should be the full 30 byte product");
+
+  LargeUIntLoad(7, "0100_07", &a);
+  LargeUIntLoad(5, "0000_", &b);
+  LargeUIntMultiply(&b, &a);
+  CheckLargeUInt("0000_", &a, "Multiplying by zero should give zero");
+}
+
+void TestMultiplyFull() {
+  LargeUInt a = {0};
+  LargeUInt product = {0};
+  // (2^240 - 1)^2 = 2^480 - 2^241 + 1
+  char* max_value =
+      "1E00_FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF";
+  LargeUIntLoad(strlen(max_value), max_value, &a);
+  LargeUIntMultiplyFull(&a, &a, &product);
+  CheckLargeUInt(
+      "3C00_01000000000000000000000000000000000000000000000000000000"
+      "0000FEFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF",
+      &product, "Full product of the largest values should be 60 bytes");
+  CheckLargeUInt(max_value, &a, "Inputs should be unchanged");
+
+  LargeUIntMultiplyFull(&a, &a, &a);
+  CheckLargeUInt(
+      "3C00_01000000000000000000000000000000000000000000000000000000"
+      "0000FEFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF",
+      &a, "Product may be stored over an input");
+}
 
 void TestDivide() {
-  LargeUInt n, d, q, r;
+  LargeUInt n = {0};
+  LargeUInt d = {0};
+  LargeUInt q = {0};
+  LargeUInt r = {0};
   LargeUIntLoad(7, "0100_0F", &n);
   LargeUIntLoad(7, "0100_05", &d);
   LargeUIntDivide(&n, &d, &q, &r);
@@ -301,10 +386,41 @@ void TestDivide() {
   LargeUIntDivide(&n, &d, &q, &r);
   CheckLargeUInt("0300_230328", &q, "Quotient should be 2,622,243");
   CheckLargeUInt("0100_5E", &r, "Remainder should be 94");
+
+  // Divisors spanning more than one limb.
+  // In base 16: (2^240 - 0x3039) / 0xFEDCBA9876543210123456789ABCDEF1
+  char* numerator =
+      "1E00_C7CFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF";
+  LargeUIntLoad(strlen(numerator), numerator, &n);
+  LargeUIntLoad(37, "1000_F1DEBC9A785634121032547698BADCFE", &d);
+  LargeUIntDivide(&n, &d, &q, &r);
+  CheckLargeUInt("0F00_7D68AC0F8D6D244992244992240101", &q,
+                 "Quotient by a two limb divisor");
+  CheckLargeUInt("1000_1A0C49CE8C5860F7A2182BC0EC34E362", &r,
+                 "Remainder by a two limb divisor");
+
+  // In base 16: (2^200 + 2^128) / (2^128 - 1) = 2^72 + 1 r 2^72 + 1
+  LargeUIntLoad(57, "1A00_0000000000000000000000000000000001000000000000000001",
+                &n);
+  LargeUIntLoad(37, "1000_FFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF", &d);
+  LargeUIntDivide(&n, &d, &q, &r);
+  CheckLargeUInt("0A00_01000000000000000001", &q,
+                 "Quotient should be 2^72 + 1");
+  CheckLargeUInt("0A00_01000000000000000001", &r,
+                 "Remainder should be 2^72 + 1");
+
+  // The quotient and remainder may replace the inputs.
+  LargeUIntLoad(13, "0400_993F6B29", &n);
+  LargeUIntLoad(9, "0200_0901", &d);
+  LargeUIntDivide(&n, &d, &n, &d);
+  CheckLargeUInt("0300_230328", &n, "Quotient should replace the numerator");
+  CheckLargeUInt("0100_5E", &d, "Remainder should replace the denominator");
 }
 
 void TestMod() {
-  LargeUInt n, d, r;
+  LargeUInt n = {0};
+  LargeUInt d = {0};
+  LargeUInt r = {0};
   LargeUIntLoad(7, "0100_0F", &n);
   LargeUIntLoad(7, "0100_05", &d);
   LargeUIntMod(&n, &d, &r);
@@ -344,10 +460,231 @@ void TestMod() {
   LargeUIntLoad(13, "0400_49531D1C", &d);
   LargeUIntMod(&n, &d, &r);
   CheckLargeUInt("0400_20BE900B", &r, "Mod remainder should be 194,035,232");
+
+  char* numerator =
+      "1E00_C7CFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF";
+  LargeUIntLoad(strlen(numerator), numerator, &n);
+  LargeUIntLoad(37, "1000_F1DEBC9A785634121032547698BADCFE", &d);
+  LargeUIntMod(&n, &d, &r);
+  CheckLargeUInt("1000_1A0C49CE8C5860F7A2182BC0EC34E362", &r,
+                 "Mod remainder by a two limb divisor");
+}
+
+void TestModWord() {
+  LargeUInt n = {0};
+  LargeUInt d = {0};
+  LargeUInt r = {0};
+  LargeUIntLoad(13, "0400_993F6B29", &n);
+  Check(41 == LargeUIntModWord(&n, 53), "694894489 mod 53 should be 41");
+  Check(0 == LargeUIntModWord(&n, 1), "Anything mod 1 should be 0");
+
+  LargeUIntLoad(5, "0000_", &n);
+  Check(0 == LargeUIntModWord(&n, 7), "0 mod 7 should be 0");
+
+  // Divisors of every bit length should agree with LargeUIntMod.
+  char* numerator =
+      "1E00_C7CFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF";
+  LargeUIntLoad(strlen(numerator), numerator, &n);
+  uint64_t divisor = 3;
+  int i;
+  for (i = 0; i < 63; i++) {
+    LargeUIntSetWord(divisor, &d);
+    LargeUIntMod(&n, &d, &r);
+    Check(LargeUIntGetWord(&r) == LargeUIntModWord(&n, divisor),
+          "Single word remainder should match LargeUIntMod");
+    Check(LargeUIntIsDivisibleBy(&n, &d) == (LargeUIntNumBytes(&r) == 0),
+          "Divisibility should match the remainder");
+    if (i < 62) {
+      divisor = divisor * 2 + (i % 2);
+    }
+  }
+  Check(1 == divisor >> 63, "Divisor should have reached the full 64 bits");
+  LargeUIntSetWord(1, &d);
+  Check(LargeUIntIsDivisibleBy(&n, &d), "1 should divide anything");
+  Check(LargeUIntIsDivisibleBy(&n, &n), "A long value should divide itself");
+}
+
+void TestModSmall() {
+  LargeUInt n = {0};
+  char* numerator =
+      "1E00_C7CFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF";
+  LargeUIntLoad(strlen(numerator), numerator, &n);
+  uint32_t divisors[20] = {1, 2, 3, 53, 65537, 4294967291u, 4294967295u};
+  uint32_t residues[20];
+  int i;
+  for (i = 7; i < 20; i++) {
+    divisors[i] = divisors[i - 1] / 3 + 7;
+  }
+  LargeUIntModSmall(&n, divisors, 20, residues);
+  for (i = 0; i < 20; i++) {
+    Check(residues[i] == LargeUIntModWord(&n, divisors[i]),
+          "Each small remainder should match LargeUIntModWord");
+  }
+
+  LargeUIntLoad(5, "0000_", &n);
+  LargeUIntModSmall(&n, divisors, 3, residues);
+  Check(residues[0] == 0 && residues[1] == 0 && residues[2] == 0,
+        "0 mod anything should be 0");
+}
+
+// Fills this with num_bytes pseudorandom bytes from the given state, with a
+// non-zero top byte.
+void RandomLargeUInt(int num_bytes, uint64_t* state, LargeUInt* this) {
+  LargeUIntInit(num_bytes, this);
+  int i;
+  for (i = 0; i < num_bytes; i++) {
+    *state = *state * 6364136223846793005ull + 1442695040888963407ull;
+    int byte = *state >> 56;
+    if (i == num_bytes - 1 && byte == 0) {
+      byte = 1;
+    }
+    LargeUIntSetByte(byte, i, this);
+  }
+}
+
+void TestBarrett() {
+  LargeUInt d = {0};
+  LargeUInt n = {0};
+  LargeUInt expected = {0};
+  LargeUInt r = {0};
+  LargeUIntBarrettCtx ctx = {0};
+  uint64_t state = 1;
+
+  LargeUIntLoad(7, "0100_07", &d);
+  LargeUIntBarrettInit(&d, &ctx);
+  LargeUIntLoad(9, "0200_E803", &n);
+  LargeUIntBarrettMod(&n, &ctx, &r);
+  CheckLargeUInt("0100_06", &r, "1000 mod 7 should be 6");
+  LargeUIntLoad(5, "0000_", &n);
+  LargeUIntBarrettMod(&n, &ctx, &r);
+  CheckLargeUInt("0000_", &r, "0 mod 7 should be 0");
+  LargeUIntBarrettFree(&ctx);
+
+  // Divisors on either side of the Karatsuba threshold, against values from
+  // shorter than the divisor to longer than twice its length.
+  int divisor_bytes;
+  for (divisor_bytes = 1; divisor_bytes < 700; divisor_bytes += 37) {
+    RandomLargeUInt(divisor_bytes, &state, &d);
+    LargeUIntBarrettCtx sized = {0};
+    LargeUIntBarrettInit(&d, &sized);
+    int value_bytes;
+    for (value_bytes = 1; value_bytes < 2 * divisor_bytes + 20;
+         value_bytes += 1 + divisor_bytes / 8) {
+      RandomLargeUInt(value_bytes, &state, &n);
+      LargeUIntMod(&n, &d, &expected);
+      LargeUIntBarrettMod(&n, &sized, &r);
+      Check(LargeUIntEqual(&expected, &r),
+            "Barrett remainder should match LargeUIntMod");
+    }
+    LargeUIntBarrettFree(&sized);
+  }
+
+  // The largest value below the square of an all ones divisor.
+  LargeUIntInit(256, &d);
+  LargeUIntInit(512, &n);
+  int i;
+  for (i = 0; i < 512; i++) {
+    if (i < 256) {
+      LargeUIntSetByte(0xFF, i, &d);
+    }
+    LargeUIntSetByte(0xFF, i, &n);
+  }
+  LargeUIntBarrettInit(&d, &ctx);
+  LargeUIntMod(&n, &d, &expected);
+  LargeUIntBarrettMod(&n, &ctx, &n);
+  Check(LargeUIntEqual(&expected, &n),
+        "Barrett remainder may replace the value");
+  LargeUIntBarrettFree(&ctx);
+}
+
+void TestGcd() {
+  LargeUInt a = {0};
+  LargeUInt b = {0};
+  LargeUInt c = {0};
+  LargeUInt g = {0};
+  LargeUIntLoad(7, "0100_0C", &a);
+  LargeUIntLoad(7, "0100_12", &b);
+  LargeUIntGcd(&a, &b, &g);
+  CheckLargeUInt("0100_06", &g, "gcd(12, 18) should be 6");
+  LargeUIntLoad(5, "0000_", &b);
+  LargeUIntGcd(&b, &a, &g);
+  CheckLargeUInt("0100_0C", &g, "gcd(0, 12) should be 12");
+  LargeUIntGcd(&a, &b, &a);
+  CheckLargeUInt("0100_0C", &a, "gcd(12, 0) should be 12");
+
+  // gcd(35 * c, 22 * c) = c
+  uint64_t state = 7;
+  RandomLargeUInt(300, &state, &c);
+  LargeUIntLoad(7, "0100_23", &a);
+  LargeUIntLoad(7, "0100_16", &b);
+  LargeUIntMultiplyFull(&a, &c, &a);
+  LargeUIntMultiplyFull(&b, &c, &b);
+  LargeUIntGcd(&a, &b, &g);
+  Check(LargeUIntEqual(&c, &g), "gcd(35 * c, 22 * c) should be c");
+}
+
+void TestMontgomery() {
+  LargeUInt m = {0};
+  LargeUInt a = {0};
+  LargeUInt b = {0};
+  LargeUInt a_mont = {0};
+  LargeUInt b_mont = {0};
+  LargeUInt result = {0};
+  LargeUIntMontCtx ctx = {0};
+
+  // 5 * 7 mod 13 = 9 and 5 * 5 mod 13 = 12
+  LargeUIntLoad(7, "0100_0D", &m);
+  LargeUIntLoad(7, "0100_05", &a);
+  LargeUIntLoad(7, "0100_07", &b);
+  LargeUIntMontInit(&m, &ctx);
+  LargeUIntToMont(&a, &ctx, &a_mont);
+  LargeUIntToMont(&b, &ctx, &b_mont);
+  LargeUIntMontMul(&a_mont, &b_mont, &ctx, &result);
+  LargeUIntFromMont(&result, &ctx, &result);
+  CheckLargeUInt("0100_09", &result, "5 * 7 mod 13 should be 9");
+  LargeUIntMontSqr(&a_mont, &ctx, &result);
+  LargeUIntFromMont(&result, &ctx, &result);
+  CheckLargeUInt("0100_0C", &result, "5 * 5 mod 13 should be 12");
+
+  // In base 16: m = 2^239 + 0x2468ACF, a = 2^238 + 0xDB4DA5F7EF412B1,
+  // b = 2^200 + 0x6B14E9F812F366E83
+  char* m_str =
+      "1E00_CF8A46020000000000000000000000000000000000000000000000000080";
+  char* a_str =
+      "1E00_B112F47E5FDAB40D00000000000000000000000000000000000000000040";
+  char* b_str = "1A00_836AF30D9B9F4EB1060000000000000000000000000000000001";
+  LargeUIntLoad(strlen(m_str), m_str, &m);
+  LargeUIntLoad(strlen(a_str), a_str, &a);
+  LargeUIntLoad(strlen(b_str), b_str, &b);
+  LargeUIntMontInit(&m, &ctx);
+  LargeUIntToMont(&a, &ctx, &a_mont);
+  LargeUIntFromMont(&a_mont, &ctx, &result);
+  CheckLargeUInt(a_str, &result, "Montgomery form should convert back");
+
+  LargeUIntToMont(&b, &ctx, &b_mont);
+  LargeUIntMontMul(&a_mont, &b_mont, &ctx, &result);
+  LargeUIntFromMont(&result, &ctx, &result);
+  CheckLargeUInt(
+      "1E00_A9359DC13404D142B341DB22DF5EBB5B00000000000000008049CDD07D1F",
+      &result, "Montgomery product should match a * b mod m");
+
+  LargeUIntMontSqr(&a_mont, &ctx, &result);
+  LargeUIntFromMont(&result, &ctx, &result);
+  CheckLargeUInt(
+      "1E00_CE6EA003551DCB6260E85683F1DDBB000000000000000000000000000020",
+      &result, "Montgomery square should match a * a mod m");
+
+  // Values of at least the modulus are reduced on the way in.
+  LargeUIntLoad(strlen(a_str), a_str, &a);
+  LargeUIntAdd(&m, &a);
+  LargeUIntToMont(&a, &ctx, &result);
+  Check(LargeUIntEqual(&result, &a_mont),
+        "a + m should have the same Montgomery form as a");
 }
 
 void TestApproximateSquareRoot() {
-  LargeUInt n, root;
+  LargeUInt n = {0};
+  LargeUInt root = {0};
 
   LargeUIntLoad(7, "0100_04", &n);
   LargeUIntApproximateSquareRoot(&n, &root);
@@ -383,6 +720,333 @@ void TestApproximateSquareRoot() {
                  "Root of 1,934,725,265,902,145 should be 43,985,513");
 }
 
+void TestSquareRoot() {
+  LargeUInt n = {0};
+  LargeUInt root = {0};
+  LargeUInt expected = {0};
+  LargeUInt square = {0};
+
+  LargeUIntInit(0, &n);
+  Check(LargeUIntSqrt(&n, &root), "0 should be a perfect square");
+  CheckLargeUInt("0000_", &root, "Root of 0 should be 0");
+
+  LargeUIntLoad(7, "0100_02", &n);
+  Check(!LargeUIntSqrt(&n, &root), "2 should not be a perfect square");
+  CheckLargeUInt("0100_01", &root, "Root of 2 should round down to 1");
+  LargeUIntApproximateSquareRoot(&n, &root);
+  CheckLargeUInt("0100_02", &root, "Approximate root of 2 should be 2");
+
+  LargeUIntLoad(7, "0100_63", &n);
+  Check(!LargeUIntSqrt(&n, &root), "99 should not be a perfect square");
+  CheckLargeUInt("0100_09", &root, "Root of 99 should round down to 9");
+
+  // Squares of a multi-limb root, and their neighbours on either side.
+  for (int num_bytes = 1; num_bytes <= 30; num_bytes++) {
+    LargeUIntInit(num_bytes, &expected);
+    for (int i = 0; i < num_bytes; i++) {
+      LargeUIntSetByte(0x80 | ((i * 37 + num_bytes) & 0x7F), i, &expected);
+    }
+    LargeUIntMultiplyFull(&expected, &expected, &square);
+
+    Check(LargeUIntSqrt(&square, &root), "Square should be perfect");
+    Check(LargeUIntEqual(&root, &expected), "Root of square should be exact");
+
+    LargeUIntDecrement(&square);
+    Check(!LargeUIntSqrt(&square, &root), "Square - 1 should not be perfect");
+    LargeUIntIncrement(&root);
+    Check(LargeUIntEqual(&root, &expected),
+          "Root of square - 1 should round down");
+
+    // (r + 1)^2 - 1 = r^2 + 2r is the largest value with root r.
+    LargeUIntIncrement(&square);
+    LargeUIntAdd(&expected, &square);
+    LargeUIntAdd(&expected, &square);
+    Check(!LargeUIntSqrt(&square, &root), "Square + 2r should not be perfect");
+    Check(LargeUIntEqual(&root, &expected),
+          "Root of square + 2r should round down");
+    LargeUIntApproximateSquareRoot(&square, &root);
+    LargeUIntDecrement(&root);
+    Check(LargeUIntEqual(&root, &expected),
+          "Approximate root of square + 2r should round up");
+  }
+}
+
+// Returns 1 if value is prime, by trial division.
+int IsPrimeByDivision(uint64_t value) {
+  uint64_t divisor;
+  for (divisor = 2; divisor * divisor <= value; divisor++) {
+    if (value % divisor == 0) {
+      return 0;
+    }
+  }
+  return value >= 2;
+}
+
+void TestIsProbablePrime() {
+  LargeUInt n = {0};
+
+  // Among these are the strong pseudoprimes to base 2, 2047, 3277, 4033, 4681,
+  // 8321 and 15841, and the strong Lucas pseudoprimes 5459, 5777, 10877,
+  // 16109 and 18971, each of which only the other half of the test catches.
+  int all_match = 1;
+  uint64_t i;
+  for (i = 0; i < 20000; i++) {
+    LargeUIntInit(2, &n);
+    LargeUIntSetByte(i & 0xFF, 0, &n);
+    LargeUIntSetByte(i >> 8, 1, &n);
+    if (LargeUIntIsProbablePrime(&n) != IsPrimeByDivision(i)) {
+      all_match = 0;
+    }
+  }
+  Check(all_match, "Probable primes below 20000 should be the primes");
+
+  // 3825123056546413051 and 318665857834031151167461 are strong pseudoprimes
+  // to every prime base up to 23 and 37 respectively.
+  LargeUIntLoad(21, "0800_FBF99A4F27911535", &n);
+  Check(!LargeUIntIsProbablePrime(&n),
+        "3825123056546413051 should be composite");
+  LargeUIntLoad(25, "0A00_E5B785FCF91728E97A43", &n);
+  Check(!LargeUIntIsProbablePrime(&n),
+        "318665857834031151167461 should be composite");
+
+  // 2^127 - 1, 2^255 - 19 and 2^521 - 1 are prime.
+  char* m127 = "1000_FFFFFFFFFFFFFFFFFFFFFFFFFFFFFF7F";
+  LargeUIntLoad(strlen(m127), m127, &n);
+  Check(LargeUIntIsProbablePrime(&n), "2^127 - 1 should be prime");
+  char* p25519 =
+      "2000_EDFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFF7F";
+  LargeUIntLoad(strlen(p25519), p25519, &n);
+  Check(LargeUIntIsProbablePrime(&n), "2^255 - 19 should be prime");
+  LargeUIntInit(66, &n);
+  for (i = 0; i < 65; i++) {
+    LargeUIntSetByte(0xFF, i, &n);
+  }
+  LargeUIntSetByte(0x01, 65, &n);
+  Check(LargeUIntIsProbablePrime(&n), "2^521 - 1 should be prime");
+
+  // 2^128 + 1, (2^61 - 1)^2 and (2^89 - 1) * (2^127 - 1) are not.
+  LargeUIntLoad(39, "1100_0100000000000000000000000000000001", &n);
+  Check(!LargeUIntIsProbablePrime(&n), "2^128 + 1 should be composite");
+  LargeUIntLoad(37, "1000_01000000000000C0FFFFFFFFFFFFFF03", &n);
+  Check(!LargeUIntIsProbablePrime(&n), "A square should be composite");
+  char* semiprime =
+      "1B00_0100000000000000000000FEFFFFFF7FFFFFFFFFFFFFFFFFFFFFFF";
+  LargeUIntLoad(strlen(semiprime), semiprime, &n);
+  Check(!LargeUIntIsProbablePrime(&n),
+        "A product of two large primes should be composite");
+  LargeUIntFree(&n);
+}
+
+void TestBeyondInlineStorage() {
+  LargeUInt a = {0};
+  LargeUInt b = {0};
+  LargeUInt product = {0};
+  LargeUInt q = {0};
+  LargeUInt r = {0};
+  int i;
+
+  Check(sizeof(LargeUInt) <= 64, "Small values should fit in a cache line");
+
+  // Growing past the inline limbs keeps the value.
+  LargeUIntInit(8 * LARGE_U_INT_INLINE_LIMBS, &a);
+  LargeUIntSetByte(0x11, 0, &a);
+  LargeUIntSetByte(0x22, 8 * LARGE_U_INT_INLINE_LIMBS - 1, &a);
+  LargeUIntGrow(&a);
+  LargeUIntSetByte(0x33, 8 * LARGE_U_INT_INLINE_LIMBS, &a);
+  Check(LargeUIntGetByte(0, &a) == 0x11, "Grow should keep the low byte");
+  Check(LargeUIntGetByte(8 * LARGE_U_INT_INLINE_LIMBS - 1, &a) == 0x22,
+        "Grow should keep the old top byte");
+  LargeUIntMultiByteShiftInc(100, &a);
+  Check(LargeUIntNumBytes(&a) == 8 * LARGE_U_INT_INLINE_LIMBS + 101,
+        "Shifting up should grow a spilled value");
+  Check(LargeUIntGetByte(100, &a) == 0x11, "Shifting up should move bytes");
+  LargeUIntMultiByteShiftDec(100, &a);
+  Check(LargeUIntGetByte(0, &a) == 0x11, "Shifting down should move bytes");
+
+  // 2^256 is past the old 30 byte limit.
+  LargeUIntInit(33, &a);
+  LargeUIntSetByte(1, 32, &a);
+  char a_str[100];
+  LargeUIntBase10Store(&a, 100, a_str);
+  Check(0 == strcmp(a_str, "11579208923731619542357098500868790785326998466"
+                           "5640564039457584007913129639936"),
+        "Base 10 of 2^256");
+
+  // Products, quotients and remainders of 100 and 150 byte values.
+  LargeUIntInit(100, &a);
+  LargeUIntInit(150, &b);
+  for (i = 0; i < 150; i++) {
+    if (i < 100) {
+      LargeUIntSetByte((i * 89 + 7) & 0xFF, i, &a);
+    }
+    LargeUIntSetByte((i * 53 + 201) & 0xFF, i, &b);
+  }
+  LargeUIntMultiplyFull(&a, &b, &product);
+  Check(LargeUIntNumBytes(&product) == 250, "Product should have 250 bytes");
+  LargeUIntAddByte(5, &product);
+  LargeUIntDivide(&product, &a, &q, &r);
+  Check(LargeUIntEqual(&q, &b), "Product / a should be b");
+  Check(LargeUIntGetWord(&r) == 5 && LargeUIntNumBytes(&r) == 1,
+        "Remainder of product + 5 should be 5");
+
+  LargeUIntMultiplyFull(&b, &b, &q);
+  Check(LargeUIntSqrt(&q, &r), "Square of b should be perfect");
+  Check(LargeUIntEqual(&r, &b), "Root of the square of b should be b");
+
+  // A freed value is empty and can be used again.
+  LargeUIntFree(&product);
+  Check(LargeUIntNumBytes(&product) == 0, "Freed value should be zero");
+  LargeUIntClone(&b, &product);
+  Check(LargeUIntEqual(&product, &b), "Freed value should be reusable");
+
+  LargeUIntFree(&a);
+  LargeUIntFree(&b);
+  LargeUIntFree(&product);
+  LargeUIntFree(&q);
+  LargeUIntFree(&r);
+  LargeUIntReleasePool();
+}
+
+void TestBinaryFormat() {
+  LargeUInt a = {0};
+  LargeUInt read = {0};
+  LargeUIntBinaryReader reader;
+  LargeUIntBinaryWriter writer;
+  FILE* file = tmpfile();
+  int i;
+  Check(file != NULL, "Temporary file should open");
+
+  // Values from 1 to 3 bytes long, with enough 2 byte values to fill more
+  // than one block, then one value past the inline limbs.
+  LargeUIntBinaryWriterInit(file, &writer);
+  for (i = 1; i <= 70000; i++) {
+    LargeUIntInit(3, &a);
+    LargeUIntSetByte(i & 0xFF, 0, &a);
+    LargeUIntSetByte(i >> 8 & 0xFF, 1, &a);
+    LargeUIntSetByte(i >> 16, 2, &a);
+    LargeUIntTrim(&a);
+    LargeUIntBinaryWrite(&a, &writer);
+  }
+  LargeUIntInit(150, &a);
+  LargeUIntSetByte(0x5A, 0, &a);
+  LargeUIntSetByte(0xA5, 149, &a);
+  LargeUIntBinaryWrite(&a, &writer);
+  LargeUIntBinaryWriterClose(&writer);
+  // Text may follow the binary blocks.
+  fprintf(file, "0200_317F # int value: 32561\n");
+  rewind(file);
+
+  LargeUIntBinaryReaderInit(file, &reader);
+  int all_match = 1;
+  for (i = 1; i <= 70000; i++) {
+    LargeUIntBinaryRead(&reader, &read);
+    if (LargeUIntGetWord(&read) != i ||
+        LargeUIntNumBytes(&read) != (i < 256 ? 1 : i < 65536 ? 2 : 3)) {
+      all_match = 0;
+    }
+  }
+  Check(all_match, "Binary values should read back in order");
+  LargeUIntBinaryRead(&reader, &read);
+  Check(LargeUIntEqual(&a, &read), "Long binary value should read back");
+  LargeUIntBinaryRead(&reader, &read);
+  Check(LargeUIntGetWord(&read) == 32561, "Text should follow binary");
+  LargeUIntBinaryRead(&reader, &read);
+  Check(LargeUIntNumBytes(&read) == 0, "End of file should read as empty");
+  LargeUIntBinaryReaderClose(&reader);
+  fclose(file);
+  LargeUIntFree(&a);
+  LargeUIntFree(&read);
+}
+
+void TestBinaryReaders() {
+  LargeUInt a = {0};
+  LargeUInt read = {0};
+  LargeUIntBinaryReader readers[10];
+  LargeUIntBinaryWriter writer;
+  FILE* files[10];
+  int i;
+  // Each reader keeps its own block, however many files are open at once.
+  for (i = 0; i < 10; i++) {
+    files[i] = tmpfile();
+    Check(files[i] != NULL, "Temporary file should open");
+    LargeUIntBinaryWriterInit(files[i], &writer);
+    LargeUIntInit(1, &a);
+    LargeUIntSetByte(i, 0, &a);
+    LargeUIntBinaryWrite(&a, &writer);
+    LargeUIntSetByte(i + 100, 0, &a);
+    LargeUIntBinaryWrite(&a, &writer);
+    LargeUIntBinaryWriterClose(&writer);
+    fprintf(files[i], "0100_07\n");
+    rewind(files[i]);
+    LargeUIntBinaryReaderInit(files[i], &readers[i]);
+  }
+  int all_match = 1;
+  for (i = 0; i < 10; i++) {
+    LargeUIntBinaryRead(&readers[i], &read);
+    all_match = all_match && LargeUIntGetWord(&read) == (uint64_t) i;
+  }
+  for (i = 0; i < 10; i++) {
+    LargeUIntBinaryRead(&readers[i], &read);
+    all_match = all_match && LargeUIntGetWord(&read) == (uint64_t) i + 100;
+  }
+  Check(all_match, "Readers should not share blocks");
+
+  // Closing a reader part way through a block drops the rest of it, and a new
+  // reader starts from wherever the file is.
+  rewind(files[0]);
+  LargeUIntBinaryReaderClose(&readers[0]);
+  LargeUIntBinaryReaderInit(files[0], &readers[0]);
+  LargeUIntBinaryRead(&readers[0], &read);
+  LargeUIntBinaryReaderClose(&readers[0]);
+  LargeUIntBinaryReaderInit(files[0], &readers[0]);
+  LargeUIntBinaryRead(&readers[0], &read);
+  Check(LargeUIntGetWord(&read) == 7, "Closed reader's block should be dropped");
+  for (i = 0; i < 10; i++) {
+    LargeUIntBinaryReaderClose(&readers[i]);
+    fclose(files[i]);
+  }
+  LargeUIntFree(&a);
+  LargeUIntFree(&read);
+}
+
+void TestSkipBinary() {
+  LargeUInt a = {0};
+  LargeUInt last = {0};
+  LargeUIntBinaryWriter writer;
+  FILE* file = tmpfile();
+  int i;
+  Check(file != NULL, "Temporary file should open");
+  fprintf(file, "0100_05\n");
+  rewind(file);
+  LargeUIntSkipBinary(file, &last);
+  Check(LargeUIntNumBytes(&last) == 0 && ftell(file) == 0,
+        "Text file has no binary blocks to skip");
+
+  // Two blocks, as the value length changes, then text.
+  rewind(file);
+  LargeUIntBinaryWriterInit(file, &writer);
+  for (i = 250; i <= 300; i++) {
+    LargeUIntInit(2, &a);
+    LargeUIntSetByte(i & 0xFF, 0, &a);
+    LargeUIntSetByte(i >> 8, 1, &a);
+    LargeUIntTrim(&a);
+    LargeUIntBinaryWrite(&a, &writer);
+  }
+  LargeUIntBinaryWriterClose(&writer);
+  long text_start = ftell(file);
+  fprintf(file, "0200_317F\n");
+  rewind(file);
+  LargeUIntSkipBinary(file, &last);
+  Check(LargeUIntGetWord(&last) == 300 && LargeUIntNumBytes(&last) == 2,
+        "Last binary value should be found");
+  Check(ftell(file) == text_start, "File should be left at the text");
+  LargeUIntRead(file, &a);
+  Check(LargeUIntGetWord(&a) == 32561, "Text should follow skipped blocks");
+  fclose(file);
+  LargeUIntFree(&a);
+  LargeUIntFree(&last);
+}
+
 int main(void) {
   TestGetSetAndNumBytes();
   TestLoadAndStore();
@@ -393,8 +1057,20 @@ int main(void) {
   TestAddAndIncrement();
   TestSubAndDecrement();
   TestMultiply();
+  TestMultiplyFull();
   TestDivide();
   TestMod();
+  TestModWord();
+  TestModSmall();
+  TestMontgomery();
+  TestBarrett();
+  TestGcd();
   TestApproximateSquareRoot();
+  TestSquareRoot();
+  TestIsProbablePrime();
+  TestBeyondInlineStorage();
+  TestBinaryFormat();
+  TestBinaryReaders();
+  TestSkipBinary();
   printf("All tests passed\n");
 }
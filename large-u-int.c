@@ -15,6 +15,7 @@
  */
 
 #include "large-u-int.h"
+#include "large-u-int-limbs.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -39,23 +40,208 @@ static int HexCharToNibble(char hex_char) {
   }
 }
 
+// The largest number of limbs a value may use.
+#define MAX_NUM_LARGE_U_INT_LIMBS ((MAX_NUM_LARGE_U_INT_BYTES + 7) / 8)
+
+// Buffers come from per-thread free lists, one for each size class of
+// POOL_MIN_LIMBS << class limbs. Released buffers go back on their list, so
+// after the first few values of a size the hot loops never call malloc. A
+// free buffer holds the link to the next one in its first limb.
+#define POOL_MIN_LIMBS 8
+#define NUM_POOL_CLASSES 16
+
+static __thread uint64_t* pool[NUM_POOL_CLASSES];
+
+static int PoolClass(int len) {
+  int size_class = 0;
+  while ((POOL_MIN_LIMBS << size_class) < len) {
+    size_class++;
+  }
+  if (size_class >= NUM_POOL_CLASSES) {
+    ErrorOut("Unable to allocate such a large buffer.");
+  }
+  return size_class;
+}
+
+// Returns a buffer of at least len limbs, storing its actual size in
+// capacity. Release it with PoolFree.
+static uint64_t* PoolAlloc(int len, int* capacity) {
+  int size_class = PoolClass(len);
+  *capacity = POOL_MIN_LIMBS << size_class;
+  uint64_t* limbs = pool[size_class];
+  if (limbs != NULL) {
+    memcpy(&pool[size_class], limbs, sizeof(uint64_t*));
+    return limbs;
+  }
+  limbs = malloc(*capacity * sizeof(uint64_t));
+  if (limbs == NULL) {
+    ErrorOut("Unable to allocate space for a large integer.");
+  }
+  return limbs;
+}
+
+static void PoolFree(uint64_t* limbs, int capacity) {
+  int size_class = PoolClass(capacity);
+  memcpy(limbs, &pool[size_class], sizeof(uint64_t*));
+  pool[size_class] = limbs;
+}
+
+void LargeUIntReleasePool(void) {
+  int i;
+  for (i = 0; i < NUM_POOL_CLASSES; i++) {
+    while (pool[i] != NULL) {
+      uint64_t* limbs = pool[i];
+      memcpy(&pool[i], limbs, sizeof(uint64_t*));
+      free(limbs);
+    }
+  }
+}
+
+// The number of limbs needed to hold num_bytes_ bytes.
+static int NumLimbs(const LargeUInt* this) {
+  return (this->num_bytes_ + 7) >> 3;
+}
+
+// Makes room for at least num_limbs limbs, keeping as much of the current
+// value as was stored. Values start out in the inline buffer and move to the
+// pool once they outgrow it.
+static void Reserve(int num_limbs, LargeUInt* this) {
+  if (this->limbs_ != NULL && num_limbs <= this->capacity_) {
+    return;
+  }
+  if (this->limbs_ == NULL && num_limbs <= LARGE_U_INT_INLINE_LIMBS) {
+    this->limbs_ = this->inline_;
+    this->capacity_ = LARGE_U_INT_INLINE_LIMBS;
+    return;
+  }
+  if (num_limbs > MAX_NUM_LARGE_U_INT_LIMBS) {
+    ErrorOut("Unable to grow large integer.");
+  }
+
+  int capacity;
+  uint64_t* limbs = PoolAlloc(num_limbs, &capacity);
+  if (this->limbs_ != NULL) {
+    int kept_limbs = NumLimbs(this);
+    if (kept_limbs > this->capacity_) {
+      kept_limbs = this->capacity_;
+    }
+    memcpy(limbs, this->limbs_, kept_limbs * sizeof(uint64_t));
+    if (this->limbs_ != this->inline_) {
+      PoolFree(this->limbs_, this->capacity_);
+    }
+  }
+  this->limbs_ = limbs;
+  this->capacity_ = capacity;
+}
+
+static int ByteAt(int index, const LargeUInt* this) {
+  return (this->limbs_[index >> 3] >> ((index & 7) << 3)) & 0xFF;
+}
+
+static void PutByte(int value, int index, LargeUInt* this) {
+  int shift = (index & 7) << 3;
+  uint64_t* limb = &this->limbs_[index >> 3];
+  *limb = (*limb & ~((uint64_t) 0xFF << shift)) | ((uint64_t) value << shift);
+}
+
+// Sets num_bytes_ to the trimmed length of the value held in the lowest
+// num_limbs limbs.
+static void TrimLimbs(int num_limbs, LargeUInt* this) {
+  while (num_limbs > 0 && this->limbs_[num_limbs - 1] == 0) {
+    num_limbs--;
+  }
+  if (num_limbs == 0) {
+    this->num_bytes_ = 0;
+    return;
+  }
+  int top_bits = 64 - __builtin_clzll(this->limbs_[num_limbs - 1]);
+  this->num_bytes_ = (num_limbs - 1) * 8 + (top_bits + 7) / 8;
+}
+
+// Moves the value up by num_bytes whole bytes, growing num_bytes_ to match.
+static void ShiftBytesUp(int num_bytes, LargeUInt* this) {
+  int old_limbs = NumLimbs(this);
+  int limb_shift = num_bytes >> 3;
+  int bit_shift = (num_bytes & 7) << 3;
+  this->num_bytes_ += num_bytes;
+  int i;
+  for (i = NumLimbs(this) - 1; i >= 0; i--) {
+    int source = i - limb_shift;
+    uint64_t value = 0;
+    if (source >= 0 && source < old_limbs) {
+      value = this->limbs_[source] << bit_shift;
+    }
+    if (bit_shift > 0 && source - 1 >= 0 && source - 1 < old_limbs) {
+      value |= this->limbs_[source - 1] >> (64 - bit_shift);
+    }
+    this->limbs_[i] = value;
+  }
+}
+
+// Moves the value down by num_bytes whole bytes, dropping the low order bytes
+// and shrinking num_bytes_ to match.
+static void ShiftBytesDown(int num_bytes, LargeUInt* this) {
+  int old_limbs = NumLimbs(this);
+  int limb_shift = num_bytes >> 3;
+  int bit_shift = (num_bytes & 7) << 3;
+  this->num_bytes_ -= num_bytes;
+  int i;
+  for (i = 0; i < NumLimbs(this); i++) {
+    int source = i + limb_shift;
+    uint64_t value = this->limbs_[source] >> bit_shift;
+    if (bit_shift > 0 && source + 1 < old_limbs) {
+      value |= this->limbs_[source + 1] << (64 - bit_shift);
+    }
+    this->limbs_[i] = value;
+  }
+}
+
+// Copies the value into exactly len limbs, padding with zero limbs.
+static void PadLimbs(const LargeUInt* this, int len, uint64_t* limbs) {
+  int num_limbs = NumLimbs(this);
+  while (num_limbs > 0 && this->limbs_[num_limbs - 1] == 0) {
+    num_limbs--;
+  }
+  if (num_limbs > len) {
+    ErrorOut("Value is too long for the modulus.");
+  }
+  memcpy(limbs, this->limbs_, num_limbs * sizeof(uint64_t));
+  memset(limbs + num_limbs, 0, (len - num_limbs) * sizeof(uint64_t));
+}
+
+// Sets the value from len limbs.
+static void StoreLimbs(const uint64_t* limbs, int len, LargeUInt* this) {
+  // Nothing needs to be kept when moving to a bigger buffer.
+  this->num_bytes_ = 0;
+  Reserve(len, this);
+  memmove(this->limbs_, limbs, len * sizeof(uint64_t));
+  TrimLimbs(len, this);
+}
+
 void LargeUIntPrint(const LargeUInt* this, FILE* out) {
   int i;
+  int byte;
   fprintf(out, "%c%c%c%c_",
           kHexBytes[this->num_bytes_ >> 4 & 0x0F],
           kHexBytes[this->num_bytes_ & 0x0F], 
           kHexBytes[this->num_bytes_ >> 12 & 0x0F],
           kHexBytes[this->num_bytes_ >> 8 & 0x0F]);
   for (i = 0; i < this->num_bytes_; i++) {
-    fprintf(out, "%c%c", kHexBytes[this->bytes_[i] >> 4 & 0x0F],
-            kHexBytes[this->bytes_[i] & 0x0F]);
+    byte = ByteAt(i, this);
+    fprintf(out, "%c%c", kHexBytes[byte >> 4 & 0x0F],
+            kHexBytes[byte & 0x0F]);
   }
 }
 
 void LargeUIntBase10Print(const LargeUInt* this, FILE* out) {
-  char str_buffer[BASE_10_LARGE_U_INT_BUFFER_SIZE];
-  LargeUIntBase10Store(this, BASE_10_LARGE_U_INT_BUFFER_SIZE, str_buffer);
+  int buffer_size = LargeUIntBase10BufferSize(this);
+  char* str_buffer = malloc(buffer_size);
+  if (str_buffer == NULL) {
+    ErrorOut("Unable to allocate space for base ten string.");
+  }
+  LargeUIntBase10Store(this, buffer_size, str_buffer);
   fprintf(out, "%s", str_buffer);
+  free(str_buffer);
 }
 
 // Processes one input character to set the value of this. Returns 1 to
@@ -103,15 +289,19 @@ static int ParseCharacter(int current, LargeUInt* this, int* state) {
       return 1;
     case -4:  // Looking for char 4 of 4 in num_bytes.
       this->num_bytes_ += current_value << 8;
+      Reserve(NumLimbs(this), this);
+      // Bytes are filled in one at a time, so start from all zero limbs.
+      memset(this->limbs_, 0, NumLimbs(this) * sizeof(uint64_t));
       *state = -5;  // Reached the end of num_bytes.
       return 1;
   }
 
   if (*state % 2 == 0) {
-    this->bytes_[*state / 2] = current_value << 4;
+    PutByte(current_value << 4, *state / 2, this);
     (*state)++;  // Has read the upper nibble of the byte.
   } else {
-    this->bytes_[(*state - 1) / 2] += current_value;
+    PutByte(ByteAt((*state - 1) / 2, this) + current_value, (*state - 1) / 2,
+            this);
     (*state)++;
     if ((*state / 2) >= this->num_bytes_) {
       return 0;
@@ -120,12 +310,212 @@ static int ParseCharacter(int current, LargeUInt* this, int* state) {
   return 1;
 }
 
-void LargeUIntRead(FILE* in, LargeUInt* this) {
+#define BINARY_HEADER_BYTES 8
+#define BINARY_BLOCK_HEADER_BYTES 12
+// Blocks hold up to this many bytes of values, or one value if it is longer.
+#define BINARY_BLOCK_BYTES 65536
+
+static uint32_t Adler32(const unsigned char* data, size_t size) {
+  uint32_t a = 1;
+  uint32_t b = 0;
+  while (size > 0) {
+    // 5552 bytes is the most that can be summed before b could overflow.
+    size_t chunk = size < 5552 ? size : 5552;
+    size -= chunk;
+    while (chunk > 0) {
+      a += *data;
+      b += a;
+      data++;
+      chunk--;
+    }
+    a %= 65521;
+    b %= 65521;
+  }
+  return b << 16 | a;
+}
+
+static uint32_t LoadLittleEndian(const unsigned char* bytes, int num_bytes) {
+  uint32_t value = 0;
+  int i;
+  for (i = num_bytes - 1; i >= 0; i--) {
+    value = value << 8 | bytes[i];
+  }
+  return value;
+}
+
+static void StoreLittleEndian(uint32_t value, int num_bytes,
+                              unsigned char* bytes) {
+  int i;
+  for (i = 0; i < num_bytes; i++) {
+    bytes[i] = value >> (8 * i) & 0xFF;
+  }
+}
+
+// Sets the value from num_bytes little endian bytes.
+static void LoadBytes(const unsigned char* bytes, int num_bytes,
+                      LargeUInt* this) {
+  this->num_bytes_ = num_bytes;
+  Reserve(NumLimbs(this), this);
+  if (num_bytes == 0) {
+    return;
+  }
+  this->limbs_[NumLimbs(this) - 1] = 0;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  memcpy(this->limbs_, bytes, num_bytes);
+#else
+  int i;
+  for (i = 0; i < num_bytes; i++) {
+    PutByte(bytes[i], i, this);
+  }
+#endif
+}
+
+// Reads the rest of the file header after its marker and checks it.
+static void ReadBinaryHeader(FILE* in) {
+  unsigned char header[BINARY_HEADER_BYTES];
+  if (fread(header + 2, 1, BINARY_HEADER_BYTES - 2, in) !=
+          BINARY_HEADER_BYTES - 2 ||
+      header[2] != 'P' || header[3] != 'F') {
+    ErrorOut("Binary header is invalid.");
+  }
+  if (LoadLittleEndian(header + 4, 4) != LARGE_U_INT_BINARY_VERSION) {
+    ErrorOut("Binary format version is not supported.");
+  }
+}
+
+// Reads the rest of a block header after its marker.
+static void ReadBinaryBlockHeader(FILE* in, unsigned char* header) {
+  if (fread(header + 2, 1, BINARY_BLOCK_HEADER_BYTES - 2, in) !=
+      BINARY_BLOCK_HEADER_BYTES - 2) {
+    ErrorOut("Binary block header is cut short.");
+  }
+}
+
+// Reads the rest of a block after its marker into the reader's buffer.
+static void ReadBinaryBlock(LargeUIntBinaryReader* reader) {
+  unsigned char header[BINARY_BLOCK_HEADER_BYTES];
+  ReadBinaryBlockHeader(reader->in_, header);
+  reader->record_bytes_ = LoadLittleEndian(header + 2, 2);
+  uint32_t num_records = LoadLittleEndian(header + 4, 4);
+  if (num_records == 0 || (uint64_t) num_records * reader->record_bytes_ >
+                              BINARY_BLOCK_BYTES + MAX_NUM_LARGE_U_INT_BYTES) {
+    ErrorOut("Binary block header is invalid.");
+  }
+  size_t size = (size_t) num_records * reader->record_bytes_;
+  free(reader->data_);
+  reader->data_ = malloc(size > 0 ? size : 1);
+  if (reader->data_ == NULL) {
+    ErrorOut("Unable to allocate space for a binary block.");
+  }
+  if (fread(reader->data_, 1, size, reader->in_) != size) {
+    ErrorOut("Binary block is cut short.");
+  }
+  if (Adler32(reader->data_, size) != LoadLittleEndian(header + 8, 4)) {
+    ErrorOut("Binary block checksum does not match.");
+  }
+  reader->remaining_ = num_records;
+  reader->next_ = reader->data_;
+}
+
+void LargeUIntBinaryReaderInit(FILE* in, LargeUIntBinaryReader* reader) {
   if (in == NULL) {
     ErrorOut("Invalid file, unable to read LargeUInt.");
   }
+  reader->in_ = in;
+  reader->record_bytes_ = 0;
+  reader->remaining_ = 0;
+  reader->data_ = NULL;
+  reader->next_ = NULL;
+}
+
+void LargeUIntBinaryRead(LargeUIntBinaryReader* reader, LargeUInt* this) {
+  while (reader->remaining_ == 0) {
+    int current = fgetc(reader->in_);
+    if (current != LARGE_U_INT_BINARY_MARKER) {
+      if (current != EOF) {
+        ungetc(current, reader->in_);
+      }
+      LargeUIntRead(reader->in_, this);
+      return;
+    }
+    current = fgetc(reader->in_);
+    if (current == 'B') {
+      ReadBinaryBlock(reader);
+    } else if (current == 'L') {
+      ReadBinaryHeader(reader->in_);
+    } else {
+      ErrorOut("Unrecognized binary data.");
+    }
+  }
+
+  LoadBytes(reader->next_, reader->record_bytes_, this);
+  reader->next_ += reader->record_bytes_;
+  reader->remaining_--;
+}
+
+void LargeUIntBinaryReaderClose(LargeUIntBinaryReader* reader) {
+  free(reader->data_);
+  reader->data_ = NULL;
+  reader->remaining_ = 0;
+}
+
+void LargeUIntSkipBinary(FILE* in, LargeUInt* last) {
+  if (fseek(in, 0, SEEK_END) != 0) {
+    ErrorOut("Unable to seek in binary file.");
+  }
+  long size = ftell(in);
+  rewind(in);
+  long last_block = -1;
+  while (1) {
+    long position = ftell(in);
+    int current = fgetc(in);
+    if (current != LARGE_U_INT_BINARY_MARKER) {
+      fseek(in, position, SEEK_SET);
+      break;
+    }
+    current = fgetc(in);
+    if (current == 'B') {
+      unsigned char header[BINARY_BLOCK_HEADER_BYTES];
+      ReadBinaryBlockHeader(in, header);
+      long block_bytes = (long) LoadLittleEndian(header + 2, 2) *
+                         LoadLittleEndian(header + 4, 4);
+      if (block_bytes > size - ftell(in)) {
+        ErrorOut("Binary block is cut short.");
+      }
+      fseek(in, block_bytes, SEEK_CUR);
+      last_block = position;
+    } else if (current == 'L') {
+      ReadBinaryHeader(in);
+    } else {
+      ErrorOut("Unrecognized binary data.");
+    }
+  }
 
+  last->num_bytes_ = 0;
+  if (last_block >= 0) {
+    // Only the last block is read in, which checks it before its last value
+    // is taken.
+    long text_start = ftell(in);
+    fseek(in, last_block + 2, SEEK_SET);
+    LargeUIntBinaryReader reader;
+    LargeUIntBinaryReaderInit(in, &reader);
+    ReadBinaryBlock(&reader);
+    LoadBytes(reader.data_ + (size_t) (reader.remaining_ - 1) *
+                  reader.record_bytes_,
+              reader.record_bytes_, last);
+    LargeUIntBinaryReaderClose(&reader);
+    fseek(in, text_start, SEEK_SET);
+  }
+}
+
+void LargeUIntRead(FILE* in, LargeUInt* this) {
+  if (in == NULL) {
+    ErrorOut("Invalid file, unable to read LargeUInt.");
+  }
   int current = fgetc(in);
+  if (current == LARGE_U_INT_BINARY_MARKER) {
+    ErrorOut("Binary data must be read with LargeUIntBinaryRead.");
+  }
   int state = -1;  // start state
   this->num_bytes_ = 0; 
 
@@ -142,6 +532,70 @@ void LargeUIntRead(FILE* in, LargeUInt* this) {
   }
 }
 
+// Writes out the values collected so far as one block.
+static void WriteBinaryBlock(LargeUIntBinaryWriter* writer) {
+  if (writer->num_records_ == 0) {
+    return;
+  }
+  size_t size = (size_t) writer->num_records_ * writer->record_bytes_;
+  unsigned char header[BINARY_BLOCK_HEADER_BYTES] = {LARGE_U_INT_BINARY_MARKER, 'B'};
+  StoreLittleEndian(writer->record_bytes_, 2, header + 2);
+  StoreLittleEndian(writer->num_records_, 4, header + 4);
+  StoreLittleEndian(Adler32(writer->data_, size), 4, header + 8);
+  if (fwrite(header, 1, BINARY_BLOCK_HEADER_BYTES, writer->out_) !=
+          BINARY_BLOCK_HEADER_BYTES ||
+      fwrite(writer->data_, 1, size, writer->out_) != size) {
+    ErrorOut("Unable to write binary block.");
+  }
+  writer->num_records_ = 0;
+}
+
+void LargeUIntBinaryWriterInit(FILE* out, LargeUIntBinaryWriter* writer) {
+  writer->out_ = out;
+  writer->record_bytes_ = 0;
+  writer->num_records_ = 0;
+  writer->max_records_ = 0;
+  writer->data_ = malloc(BINARY_BLOCK_BYTES + MAX_NUM_LARGE_U_INT_BYTES);
+  if (writer->data_ == NULL) {
+    ErrorOut("Unable to allocate space for a binary block.");
+  }
+  unsigned char header[BINARY_HEADER_BYTES] = {LARGE_U_INT_BINARY_MARKER, 'L', 'P', 'F'};
+  StoreLittleEndian(LARGE_U_INT_BINARY_VERSION, 4, header + 4);
+  if (fwrite(header, 1, BINARY_HEADER_BYTES, out) != BINARY_HEADER_BYTES) {
+    ErrorOut("Unable to write binary header.");
+  }
+}
+
+void LargeUIntBinaryWrite(const LargeUInt* this,
+                          LargeUIntBinaryWriter* writer) {
+  if (this->num_bytes_ != writer->record_bytes_ ||
+      writer->num_records_ == writer->max_records_) {
+    WriteBinaryBlock(writer);
+    writer->record_bytes_ = this->num_bytes_;
+    writer->max_records_ = this->num_bytes_ == 0
+        ? BINARY_BLOCK_BYTES : (BINARY_BLOCK_BYTES - 1) / this->num_bytes_ + 1;
+  }
+  unsigned char* record =
+      writer->data_ + (size_t) writer->num_records_ * this->num_bytes_;
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  if (this->num_bytes_ > 0) {
+    memcpy(record, this->limbs_, this->num_bytes_);
+  }
+#else
+  int i;
+  for (i = 0; i < this->num_bytes_; i++) {
+    record[i] = ByteAt(i, this);
+  }
+#endif
+  writer->num_records_++;
+}
+
+void LargeUIntBinaryWriterClose(LargeUIntBinaryWriter* writer) {
+  WriteBinaryBlock(writer);
+  free(writer->data_);
+  writer->data_ = NULL;
+}
+
 int LargeUIntBufferSize(const LargeUInt* this) {
   return 5 + 2 * this->num_bytes_;
 }
@@ -159,32 +613,41 @@ void LargeUIntStore(const LargeUInt* this, int buffer_size, char* buffer) {
 
   int i = 0;
   int j = 5;
+  int byte;
   for (; i < this->num_bytes_; i++) {
-    buffer[j] = kHexBytes[this->bytes_[i] >> 4 & 0x0F];
+    byte = ByteAt(i, this);
+    buffer[j] = kHexBytes[byte >> 4 & 0x0F];
     j++;
-    buffer[j] = kHexBytes[this->bytes_[i] & 0x0F];
+    buffer[j] = kHexBytes[byte & 0x0F];
     j++;
   }
   buffer[j] = '\0';
 }
 
+int LargeUIntBase10BufferSize(const LargeUInt* this) {
+  return 3 * this->num_bytes_ + 1;
+}
+
 void LargeUIntBase10Store(
     const LargeUInt* this, int buffer_size, char* buffer) {
-  char internal_buffer[BASE_10_LARGE_U_INT_BUFFER_SIZE];
+  char* internal_buffer = malloc(LargeUIntBase10BufferSize(this));
+  if (internal_buffer == NULL) {
+    ErrorOut("Unable to allocate space for base ten digits.");
+  }
   int num_digits = 0;
-  LargeUInt reduced_this;
-  LargeUInt quotient;
-  LargeUInt remainder;
-  LargeUInt ten;
-  ten.num_bytes_ = 1;
-  ten.bytes_[0] = 10;
+  LargeUInt reduced_this = {0};
+  LargeUInt quotient = {0};
+  LargeUInt remainder = {0};
+  LargeUInt ten = {0};
+  LargeUIntInit(1, &ten);
+  LargeUIntSetByte(10, 0, &ten);
 
   LargeUIntDivide(this, &ten, &quotient, &remainder);
   while (remainder.num_bytes_ > 0 || quotient.num_bytes_ > 0) {
     if (remainder.num_bytes_ == 0) {
       internal_buffer[num_digits] = 0;
     } else {
-      internal_buffer[num_digits] = remainder.bytes_[0];
+      internal_buffer[num_digits] = remainder.limbs_[0];
     }
     LargeUIntClone(&quotient, &reduced_this);
     num_digits++;
@@ -200,6 +663,12 @@ void LargeUIntBase10Store(
     buffer[i] = '0' + internal_buffer[num_digits - i - 1];
   }
   buffer[i] = '\0';
+
+  free(internal_buffer);
+  LargeUIntFree(&reduced_this);
+  LargeUIntFree(&quotient);
+  LargeUIntFree(&remainder);
+  LargeUIntFree(&ten);
 }
 
 void LargeUIntLoad(int buffer_size, char* buffer, LargeUInt* this) {
@@ -220,20 +689,37 @@ void LargeUIntInit(int starting_size, LargeUInt* this) {
   if (starting_size < 0 || starting_size > MAX_NUM_LARGE_U_INT_BYTES) {
     ErrorOut("Invalis size when initializing a large integer.");
   }
+  // Nothing needs to be kept when moving to a bigger buffer.
+  this->num_bytes_ = 0;
+  Reserve((starting_size + 7) >> 3, this);
   this->num_bytes_ = starting_size;
+  memset(this->limbs_, 0, NumLimbs(this) * sizeof(uint64_t));
+}
+
+void LargeUIntFree(LargeUInt* this) {
+  if (this->limbs_ != NULL && this->limbs_ != this->inline_) {
+    PoolFree(this->limbs_, this->capacity_);
+  }
+  this->num_bytes_ = 0;
+  this->capacity_ = 0;
+  this->limbs_ = NULL;
 }
 
 void LargeUIntGrow(LargeUInt* this) {
   if (this->num_bytes_ == MAX_NUM_LARGE_U_INT_BYTES) {
     ErrorOut("Unable to grow large integer.");
   }
+  // Starting a new limb, the bytes above num_bytes_ in the old top limb are
+  // already zero.
+  if ((this->num_bytes_ & 7) == 0) {
+    Reserve(NumLimbs(this) + 1, this);
+    this->limbs_[this->num_bytes_ >> 3] = 0;
+  }
   this->num_bytes_++;
 }
 
 void LargeUIntTrim(LargeUInt* this) {
-  while (this->num_bytes_ > 0 && this->bytes_[this->num_bytes_ - 1] == 0) {
-    this->num_bytes_--;
-  }
+  TrimLimbs(NumLimbs(this), this);
 }
 
 void LargeUIntSetByte(int value, int index, LargeUInt* this) {
@@ -243,20 +729,28 @@ void LargeUIntSetByte(int value, int index, LargeUInt* this) {
   if (value < 0 || value > 255) {
     ErrorOut("Invalid value when setting byte.");
   }
-  this->bytes_[index] = value;
+  PutByte(value, index, this);
 }
 
 int LargeUIntGetByte(int index, const LargeUInt* this) {
   if (index < 0 || index >= this->num_bytes_) {
     ErrorOut("Index out of bounds when getting byte.");
   }
-  return this->bytes_[index];
+  return ByteAt(index, this);
 }
 
 int LargeUIntNumBytes(const LargeUInt* this) {
   return this->num_bytes_;
 }
 
+uint64_t LargeUIntGetWord(const LargeUInt* this) {
+  return this->num_bytes_ == 0 ? 0 : this->limbs_[0];
+}
+
+void LargeUIntSetWord(uint64_t value, LargeUInt* this) {
+  StoreLimbs(&value, 1, this);
+}
+
 int LargeUIntCompare(const LargeUInt* this, const LargeUInt* that) {
   if (this->num_bytes_ > that->num_bytes_) {
     return -1;
@@ -264,11 +758,11 @@ int LargeUIntCompare(const LargeUInt* this, const LargeUInt* that) {
     return 1;
   } else {
     int i;
-    // Start with the most significant byte.
-    for (i = this->num_bytes_ - 1; i >= 0; i--) {
-      if (this->bytes_[i] > that->bytes_[i]) {
+    // Start with the most significant limb.
+    for (i = NumLimbs(this) - 1; i >= 0; i--) {
+      if (this->limbs_[i] > that->limbs_[i]) {
         return -1;
-      } else if (this->bytes_[i] < that->bytes_[i]) {
+      } else if (this->limbs_[i] < that->limbs_[i]) {
         return 1;
       }
     }
@@ -289,20 +783,21 @@ int LargeUIntEqual(const LargeUInt* this, const LargeUInt* that) {
 }
 
 void LargeUIntClone(const LargeUInt* that, LargeUInt* this) {
+  if (this == that) {
+    return;
+  }
+  this->num_bytes_ = 0;
+  Reserve(NumLimbs(that), this);
   this->num_bytes_ = that->num_bytes_;
-  memmove(this->bytes_, that->bytes_, this->num_bytes_);
+  memcpy(this->limbs_, that->limbs_, NumLimbs(this) * sizeof(uint64_t));
 }
 
 void LargeUIntByteShiftInc(LargeUInt* this) {
   if (this->num_bytes_ == MAX_NUM_LARGE_U_INT_BYTES) {
     ErrorOut("Unable to byte shift large integer.");
   }
-  int i;
-  for (i = this->num_bytes_; i > 0; i--) {
-    this->bytes_[i] = this->bytes_[i - 1];
-  }
-  this->num_bytes_++;
-  this->bytes_[0] = 0;
+  Reserve((this->num_bytes_ + 8) >> 3, this);
+  ShiftBytesUp(1, this);
   LargeUIntTrim(this);
 }
 
@@ -311,12 +806,8 @@ int LargeUIntByteShiftDec(LargeUInt* this) {
     ErrorOut("Unable to decrease shift an integer of zero.");
   }
 
-  int lowest_byte = this->bytes_[0];
-  int i;
-  for (i = 0; i < this->num_bytes_ - 1; i++) {
-    this->bytes_[i] = this->bytes_[i + 1];
-  }
-  this->num_bytes_--;
+  int lowest_byte = ByteAt(0, this);
+  ShiftBytesDown(1, this);
   return lowest_byte;
 }
 
@@ -327,74 +818,62 @@ void LargeUIntMultiByteShiftInc(int num_bytes, LargeUInt* this) {
   if (this->num_bytes_ == 0) {
     return;
   }
-  int i;
-  for (i = this->num_bytes_ - 1; i >= 0; i--) {
-    this->bytes_[i + num_bytes] = this->bytes_[i];
-  }
-  this->num_bytes_ += num_bytes;
-  memset(this->bytes_, 0, num_bytes);
+  Reserve((this->num_bytes_ + num_bytes + 7) >> 3, this);
+  ShiftBytesUp(num_bytes, this);
 }
 
 void LargeUIntMultiByteShiftDec(int num_bytes, LargeUInt* this) {
   if (this->num_bytes_ - num_bytes < 0) {
     ErrorOut("Unable to decrease shift an integer by this many bytes.");
   }
-  this->num_bytes_ -= num_bytes;
-  int i;
-  for (i = 0; i < this->num_bytes_; i++) {
-    this->bytes_[i] = this->bytes_[i + num_bytes];
-  }
+  ShiftBytesDown(num_bytes, this);
 }
 
 void LargeUIntAdd(const LargeUInt* that, LargeUInt* this) {
-  int carry = 0;
-  int value = 0;
-  for (int i = 0; i < this->num_bytes_ || i < that->num_bytes_; i++) {
-    if (i >= this->num_bytes_) {
-      value = that->bytes_[i] + carry;
-      LargeUIntGrow(this);
-    } else if (i < that->num_bytes_) {
-      value = this->bytes_[i] + that->bytes_[i] + carry;
-    } else if (carry > 0) {
-      value = this->bytes_[i] + carry;
-    } else {
-      value = this->bytes_[i];
-    }
-    if (value > 255) {
-      value -= 256;
-      carry = 1;
-    } else {
-      carry = 0;
-    }
-    this->bytes_[i] = value;
-    value = 0;
+  int this_limbs = NumLimbs(this);
+  int that_limbs = NumLimbs(that);
+  uint64_t carry;
+  int num_limbs;
+  // Reserved before reading that, which may be the same value as this.
+  Reserve(that_limbs, this);
+  if (this_limbs >= that_limbs) {
+    num_limbs = this_limbs;
+    carry = LimbsAdd(this->limbs_, this_limbs, that->limbs_, that_limbs,
+                     this->limbs_);
+  } else {
+    num_limbs = that_limbs;
+    carry = LimbsAdd(that->limbs_, that_limbs, this->limbs_, this_limbs,
+                     this->limbs_);
   }
   if (carry > 0) {
-    LargeUIntGrow(this);
-    this->bytes_[this->num_bytes_ - 1] = carry;
+    // Keeps every limb of the sum when moving to a bigger buffer.
+    this->num_bytes_ = num_limbs * 8;
+    Reserve(num_limbs + 1, this);
+    this->limbs_[num_limbs] = carry;
+    num_limbs++;
   }
+  TrimLimbs(num_limbs, this);
 }
 
 void LargeUIntAddByte(int byte, LargeUInt* this) {
   if (byte < 0 || byte > 255) {
     ErrorOut("Byte value in addition should be between 0 and 255.");
   }
-  int carry = byte;
-  int value = 0;
-  for (int i = 0; i < this->num_bytes_ && carry > 0; i++) {
-    value = this->bytes_[i] + carry;
-    if (value > 255) {
-      value -= 256;
-      carry = 1;
-    } else {
-      carry = 0;
-    }
-    this->bytes_[i] = value;
+  int num_limbs = NumLimbs(this);
+  uint64_t carry = byte;
+  int i;
+  for (i = 0; i < num_limbs && carry > 0; i++) {
+    this->limbs_[i] += carry;
+    carry = this->limbs_[i] < carry;
   }
-  if (carry == 1) {
-    LargeUIntGrow(this);
-    this->bytes_[this->num_bytes_ - 1] = carry;
+  if (carry > 0) {
+    // Keeps every limb of the sum when moving to a bigger buffer.
+    this->num_bytes_ = num_limbs * 8;
+    Reserve(num_limbs + 1, this);
+    this->limbs_[num_limbs] = carry;
+    num_limbs++;
   }
+  TrimLimbs(num_limbs, this);
 }
 
 void LargeUIntIncrement(LargeUInt* this) {
@@ -411,192 +890,697 @@ void LargeUIntSub(const LargeUInt* that, LargeUInt* this) {
   }
 
   // We now know that this is larger than that.
-  int borrow = 0;
-  int value = 0;
-  for (int i = 0; i < this->num_bytes_; i++) {
-    if (i < that->num_bytes_) {
-      value = this->bytes_[i] - that->bytes_[i] - borrow;
-    } else {
-      value = this->bytes_[i] - borrow;
-    }
-    if (value < 0) {
-      value += 256;
-      borrow = 1;
-    } else {
-      borrow = 0;
-    }
-    this->bytes_[i] = value;
-  }
-  while (this->num_bytes_ > 0 && this->bytes_[this->num_bytes_ - 1] == 0) {
-    this->num_bytes_--;
-  }
+  int num_limbs = NumLimbs(this);
+  LimbsSub(this->limbs_, num_limbs, that->limbs_, NumLimbs(that),
+           this->limbs_);
+  TrimLimbs(num_limbs, this);
 }
 
 void LargeUIntDecrement(LargeUInt* this) {
-  while (this->num_bytes_ > 0 && this->bytes_[this->num_bytes_ - 1] == 0) {
-    this->num_bytes_--;
-  }
+  LargeUIntTrim(this);
   if (this->num_bytes_ == 0) {
     ErrorOut("Unable to decrement an integer of value 0.");
   }
 
-  int borrow = 1;
-  int value = 0;
-  for (int i = 0; i < this->num_bytes_ && borrow == 1; i++) {
-    value = this->bytes_[i] - borrow;
-    if (value < 0) {
-      value += 256;
-      borrow = 1;
-    } else {
-      borrow = 0;
-    }
-    this->bytes_[i] = value;
-  }
-
-  while (this->num_bytes_ > 0 && this->bytes_[this->num_bytes_ - 1] == 0) {
-    this->num_bytes_--;
+  int num_limbs = NumLimbs(this);
+  int i;
+  for (i = 0; i < num_limbs && this->limbs_[i] == 0; i++) {
+    this->limbs_[i] = UINT64_MAX;
   }
+  this->limbs_[i]--;
+  TrimLimbs(num_limbs, this);
 }
 
 void LargeUIntMultiply(const LargeUInt* that, LargeUInt* this) {
-  // Multiply by zero sets this to zero.
-  if (that->num_bytes_ == 0) {
-    this->num_bytes_ = 0;
-  }
+  LargeUIntMultiplyFull(this, that, this);
+}
 
-  // Multiplied based on repeated additions. Inefficient, but easy to verify.
-  LargeUInt value;
-  LargeUIntClone(this, &value);
+void LargeUIntMultiplyFull(const LargeUInt* this, const LargeUInt* that,
+                           LargeUInt* product) {
+  int this_limbs = NumLimbs(this);
+  int that_limbs = NumLimbs(that);
+  int num_limbs = this_limbs + that_limbs;
+  int scratch_len =
+      LimbsMulScratchSize(this_limbs > that_limbs ? this_limbs : that_limbs);
+  // Computed into a separate buffer so the product may replace an input.
+  int capacity;
+  uint64_t* result = PoolAlloc(num_limbs + scratch_len, &capacity);
+  LimbsMul(this->limbs_, this_limbs, that->limbs_, that_limbs, result,
+           scratch_len == 0 ? NULL : result + num_limbs);
+
+  while (num_limbs > 0 && result[num_limbs - 1] == 0) {
+    num_limbs--;
+  }
+  if (num_limbs > MAX_NUM_LARGE_U_INT_LIMBS) {
+    ErrorOut("Product is too big to store in a large integer.");
+  }
+  StoreLimbs(result, num_limbs, product);
+  PoolFree(result, capacity);
+}
 
-  LargeUInt additions;
-  LargeUIntClone(that, &additions);
-  // Decrement since this is already value multiplied by one.
-  LargeUIntDecrement(&additions);
+// Divides numerator by denominator, storing the quotient unless it is NULL,
+// and the remainder. The outputs may be the same as the inputs.
+static void DivideLimbs(const LargeUInt* numerator,
+                        const LargeUInt* denominator, LargeUInt* quotient,
+                        LargeUInt* remainder) {
+  int numerator_len = NumLimbs(numerator);
+  int denominator_len = NumLimbs(denominator);
+  while (numerator_len > 0 && numerator->limbs_[numerator_len - 1] == 0) {
+    numerator_len--;
+  }
+  while (denominator_len > 0 &&
+         denominator->limbs_[denominator_len - 1] == 0) {
+    denominator_len--;
+  }
+  if (denominator_len == 0) {
+    ErrorOut("Unable to divide by zero.");
+  }
+  if (numerator_len < denominator_len) {
+    LargeUIntClone(numerator, remainder);
+    LargeUIntTrim(remainder);
+    if (quotient != NULL) {
+      LargeUIntInit(0, quotient);
+    }
+    return;
+  }
 
-  while(additions.num_bytes_ > 0) {
-    LargeUIntDecrement(&additions);
-    LargeUIntAdd(&value, this);
+  int quotient_len = numerator_len - denominator_len + 1;
+  int capacity;
+  uint64_t* quotient_limbs = PoolAlloc(
+      quotient_len + denominator_len +
+          LimbsDivRemScratchSize(numerator_len, denominator_len),
+      &capacity);
+  uint64_t* remainder_limbs = quotient_limbs + quotient_len;
+  uint64_t* scratch = remainder_limbs + denominator_len;
+  LimbsDivRem(numerator->limbs_, numerator_len, denominator->limbs_,
+              denominator_len, quotient == NULL ? NULL : quotient_limbs,
+              remainder_limbs, scratch);
+
+  if (quotient != NULL) {
+    StoreLimbs(quotient_limbs, quotient_len, quotient);
   }
+  StoreLimbs(remainder_limbs, denominator_len, remainder);
+  PoolFree(quotient_limbs, capacity);
 }
 
 void LargeUIntDivide(const LargeUInt* numerator, const LargeUInt* denominator,
                      LargeUInt* quotient, LargeUInt* remainder) {
-  quotient->num_bytes_ = 0;
-  if (numerator->num_bytes_ == 0) {
-    remainder->num_bytes_ = 0;
-    return;
-  }
+  DivideLimbs(numerator, denominator, quotient, remainder);
+}
 
-  // The remainder starts out with the full value of the numerator.
-  LargeUIntClone(numerator, remainder);
+void LargeUIntMod(const LargeUInt* numerator, const LargeUInt* divisor,
+                  LargeUInt* remainder) {
+  DivideLimbs(numerator, divisor, NULL, remainder);
+}
 
-  LargeUInt repeated_divisor;
-  LargeUIntClone(denominator, &repeated_divisor);
+// The number of limbs in the value without its leading zero limbs.
+static int TrimmedLimbs(const LargeUInt* this) {
+  int num_limbs = NumLimbs(this);
+  while (num_limbs > 0 && this->limbs_[num_limbs - 1] == 0) {
+    num_limbs--;
+  }
+  return num_limbs;
+}
 
-  LargeUInt quotient_segment;
-  int divisor_shifts;
+// Compares len limbs of a and b, returning -1, 0 or 1 as a is less than, equal
+// to or greater than b.
+static int CompareLimbs(const uint64_t* a, const uint64_t* b, int len) {
   int i;
-
-  while (LargeUIntLessThanOrEqual(denominator, remainder)) {
-    divisor_shifts = 0;
-    // We byte shift the divisor until it has the same number of bytes as
-    // the amount that we still have left from the numerator.
-    divisor_shifts = remainder->num_bytes_ - repeated_divisor.num_bytes_;
-    LargeUIntMultiByteShiftInc(divisor_shifts, &repeated_divisor);
-    // If using the same number of bytes means that we have multiplied the
-    // divisor too many times, backtrack on one of the shifts.
-    if (LargeUIntLessThan(remainder, &repeated_divisor)) {
-      divisor_shifts--;
-      LargeUIntByteShiftDec(&repeated_divisor);
-    }
-    // We translate the number of byte shifts performed into the number that
-    // we have multiplied the divisor by, to store in the quotient.
-    quotient_segment.num_bytes_ = 1;
-    quotient_segment.bytes_[0] = 0;
-    // Subtract the multiplied divisor into what is left of the numerator as
-    // many times as is possible while having a remainder left over.
-    while (LargeUIntLessThanOrEqual(&repeated_divisor, remainder)) {
-      LargeUIntSub(&repeated_divisor, remainder);
-      LargeUIntIncrement(&quotient_segment);
+  for (i = len - 1; i >= 0; i--) {
+    if (a[i] != b[i]) {
+      return a[i] < b[i] ? -1 : 1;
     }
-    // Reset the divisor to determine the next round of multiplications that
-    // can fit in the remainder left from this round.
-    LargeUIntClone(denominator, &repeated_divisor);
+  }
+  return 0;
+}
 
-    // Add the number of subtractions at the correct byte in the quotient.
-    LargeUIntMultiByteShiftInc(divisor_shifts, &quotient_segment);
-    LargeUIntAdd(&quotient_segment, quotient);
+void LargeUIntBarrettInit(const LargeUInt* divisor, LargeUIntBarrettCtx* ctx) {
+  LargeUIntClone(divisor, &ctx->divisor_);
+  LargeUIntTrim(&ctx->divisor_);
+  int len = TrimmedLimbs(&ctx->divisor_);
+  if (len == 0) {
+    ErrorOut("Unable to divide by zero.");
   }
+  ctx->num_limbs_ = len;
+
+  // 2^(128 * len) is the one limb 2 * len places up.
+  int capacity;
+  uint64_t* numerator = PoolAlloc(
+      4 * len + 3 + LimbsDivRemScratchSize(2 * len + 1, len), &capacity);
+  uint64_t* quotient = numerator + 2 * len + 1;
+  uint64_t* remainder = quotient + len + 2;
+  uint64_t* scratch = remainder + len;
+  memset(numerator, 0, 2 * len * sizeof(uint64_t));
+  numerator[2 * len] = 1;
+  LimbsDivRem(numerator, 2 * len + 1, ctx->divisor_.limbs_, len, quotient,
+              remainder, scratch);
+  StoreLimbs(quotient, len + 2, &ctx->reciprocal_);
+  PoolFree(numerator, capacity);
+}
 
-  LargeUIntTrim(quotient);
-  LargeUIntTrim(remainder);
+void LargeUIntBarrettFree(LargeUIntBarrettCtx* ctx) {
+  LargeUIntFree(&ctx->divisor_);
+  LargeUIntFree(&ctx->reciprocal_);
 }
 
-void LargeUIntMod(const LargeUInt* numerator, const LargeUInt* divisor,
-                  LargeUInt* remainder) {
-  if (numerator->num_bytes_ == 0) {
-    remainder->num_bytes_ = 0;
+void LargeUIntBarrettMod(const LargeUInt* this, const LargeUIntBarrettCtx* ctx,
+                         LargeUInt* remainder) {
+  int len = ctx->num_limbs_;
+  int this_len = TrimmedLimbs(this);
+  if (this_len < len) {
+    LargeUIntClone(this, remainder);
+    LargeUIntTrim(remainder);
+    return;
+  }
+  if (this_len > 2 * len) {
+    DivideLimbs(this, &ctx->divisor_, NULL, remainder);
     return;
   }
 
-  LargeUIntClone(numerator, remainder);
+  // The quotient estimate is the top this_len - len + 1 limbs of the value,
+  // times the reciprocal, shifted down by len + 1 limbs. It is at most 2 short
+  // of the true quotient.
+  const uint64_t* divisor = ctx->divisor_.limbs_;
+  const uint64_t* reciprocal = ctx->reciprocal_.limbs_;
+  int reciprocal_len = TrimmedLimbs(&ctx->reciprocal_);
+  int top_len = this_len - len + 1;
+  int estimate_len = top_len + reciprocal_len;
+  int product_len = top_len + len;
+  int scratch_len = LimbsMulScratchSize(len + 1);
+  int capacity;
+  uint64_t* estimate = PoolAlloc(
+      estimate_len + product_len + len + 1 + scratch_len, &capacity);
+  uint64_t* product = estimate + estimate_len;
+  uint64_t* result = product + product_len;
+  uint64_t* scratch = scratch_len == 0 ? NULL : result + len + 1;
+  LimbsMul(this->limbs_ + len - 1, top_len, reciprocal, reciprocal_len,
+           estimate, scratch);
+  uint64_t* quotient = estimate + len + 1;
+  int quotient_len = estimate_len - len - 1;
+  if (quotient_len > top_len) {
+    quotient_len = top_len;
+  }
 
-  LargeUInt repeated_divisor;
-  LargeUIntClone(divisor, &repeated_divisor);
-  while (LargeUIntLessThanOrEqual(divisor, remainder)) {
-    int bytes_diff = remainder->num_bytes_ - repeated_divisor.num_bytes_ - 1;
-    if (bytes_diff >= 1) {
-      LargeUIntMultiByteShiftInc(bytes_diff, &repeated_divisor);
-    }
-    while (LargeUIntLessThanOrEqual(&repeated_divisor, remainder)) {
-      LargeUIntSub(&repeated_divisor, remainder);
+  // The remainder is below 3 * divisor, so the low len + 1 limbs of the value
+  // less quotient * divisor are enough.
+  int low_len = this_len < len + 1 ? this_len : len + 1;
+  memset(result, 0, (len + 1) * sizeof(uint64_t));
+  memcpy(result, this->limbs_, low_len * sizeof(uint64_t));
+  if (quotient_len > 0) {
+    LimbsMul(quotient, quotient_len, divisor, len, product, scratch);
+    LimbsSub(result, len + 1, product, len + 1, result);
+  }
+  while (result[len] != 0 || CompareLimbs(result, divisor, len) >= 0) {
+    LimbsSub(result, len + 1, divisor, len, result);
+  }
+  StoreLimbs(result, len + 1, remainder);
+  PoolFree(estimate, capacity);
+}
+
+void LargeUIntGcd(const LargeUInt* this, const LargeUInt* that,
+                  LargeUInt* gcd) {
+  LargeUInt values[2] = {{0}, {0}};
+  LargeUInt* a = &values[0];
+  LargeUInt* b = &values[1];
+  LargeUIntClone(this, a);
+  LargeUIntClone(that, b);
+  LargeUIntTrim(a);
+  LargeUIntTrim(b);
+  // Euclid's algorithm, keeping the latest remainder in b.
+  while (b->num_bytes_ > 0) {
+    LargeUIntMod(a, b, a);
+    LargeUInt* swap = a;
+    a = b;
+    b = swap;
+  }
+  LargeUIntClone(a, gcd);
+  LargeUIntFree(&values[0]);
+  LargeUIntFree(&values[1]);
+}
+
+uint64_t LargeUIntModWord(const LargeUInt* this, uint64_t divisor) {
+  if (divisor == 0) {
+    ErrorOut("Unable to divide by zero.");
+  }
+  return LimbsDivRemLimb(this->limbs_, NumLimbs(this), divisor, NULL);
+}
+
+int LargeUIntIsDivisibleBy(const LargeUInt* this, const LargeUInt* divisor) {
+  if (LargeUIntNumBytes(divisor) <= 8) {
+    return LargeUIntModWord(this, LargeUIntGetWord(divisor)) == 0;
+  }
+  LargeUInt remainder = {0};
+  LargeUIntMod(this, divisor, &remainder);
+  int is_divisible = LargeUIntNumBytes(&remainder) == 0;
+  LargeUIntFree(&remainder);
+  return is_divisible;
+}
+
+void LargeUIntModSmall(const LargeUInt* this, const uint32_t* divisors,
+                       int count, uint32_t* residues) {
+  int i;
+  for (i = 0; i < count; i++) {
+    if (divisors[i] == 0) {
+      ErrorOut("Unable to divide by zero.");
     }
-    LargeUIntClone(divisor, &repeated_divisor);
   }
+  LimbsModSmall(this->limbs_, NumLimbs(this), divisors, count, residues);
+}
 
-  LargeUIntTrim(remainder);
+void LargeUIntMontInit(const LargeUInt* modulus, LargeUIntMontCtx* ctx) {
+  LargeUIntClone(modulus, &ctx->modulus_);
+  LargeUIntTrim(&ctx->modulus_);
+  if (ctx->modulus_.num_bytes_ == 0 || (ctx->modulus_.limbs_[0] & 1) == 0) {
+    ErrorOut("Montgomery arithmetic needs an odd modulus.");
+  }
+  int len = NumLimbs(&ctx->modulus_);
+  ctx->num_limbs_ = len;
+  ctx->inverse_ = LimbsMontInverse(ctx->modulus_.limbs_[0]);
+
+  // R^2 = 2^(128 * len) is the one limb 2 * len places up.
+  int capacity;
+  uint64_t* r_squared = PoolAlloc(
+      3 * len + 1 + LimbsDivRemScratchSize(2 * len + 1, len), &capacity);
+  uint64_t* remainder = r_squared + 2 * len + 1;
+  uint64_t* scratch = remainder + len;
+  memset(r_squared, 0, 2 * len * sizeof(uint64_t));
+  r_squared[2 * len] = 1;
+  LimbsDivRem(r_squared, 2 * len + 1, ctx->modulus_.limbs_, len, NULL,
+              remainder, scratch);
+  StoreLimbs(remainder, len, &ctx->r_squared_);
+  PoolFree(r_squared, capacity);
 }
 
-void LargeUIntApproximateSquareRoot(const LargeUInt* this, LargeUInt* root) {
-  LargeUInt two;
-  two.num_bytes_ = 1;
-  two.bytes_[0] = 2;
-
-  LargeUInt remainder;
-  LargeUInt estimate;
-  // Start by using an estimate of just above half of the input.
-  LargeUIntDivide(this, &two, &estimate, &remainder);
-  LargeUIntIncrement(&estimate);
-
-  LargeUInt quotient;
-  LargeUInt next_estimate;
-  next_estimate.num_bytes_ = 0;
-
-  int divided_evenly = 0;
-  int comparison;
+void LargeUIntMontFree(LargeUIntMontCtx* ctx) {
+  LargeUIntFree(&ctx->modulus_);
+  LargeUIntFree(&ctx->r_squared_);
+}
+
+// Multiplies or, when this and that are the same, squares two values in
+// Montgomery form.
+static void MontMultiply(const LargeUInt* this, const LargeUInt* that,
+                         const LargeUIntMontCtx* ctx, LargeUInt* product) {
+  int len = ctx->num_limbs_;
+  int scratch_len = LimbsMulScratchSize(len);
+  int capacity;
+  uint64_t* a = PoolAlloc(5 * len + scratch_len, &capacity);
+  uint64_t* b = a + len;
+  uint64_t* t = b + len;
+  uint64_t* result = t + 2 * len;
+  uint64_t* scratch = scratch_len == 0 ? NULL : result + len;
+  PadLimbs(this, len, a);
+  if (this == that) {
+    LimbsSqr(a, len, t, scratch);
+  } else {
+    PadLimbs(that, len, b);
+    LimbsMul(a, len, b, len, t, scratch);
+  }
+  LimbsMontRedc(t, ctx->modulus_.limbs_, len, ctx->inverse_, result);
+  StoreLimbs(result, len, product);
+  PoolFree(a, capacity);
+}
+
+void LargeUIntToMont(const LargeUInt* this, const LargeUIntMontCtx* ctx,
+                     LargeUInt* mont) {
+  if (LargeUIntLessThan(this, &ctx->modulus_)) {
+    MontMultiply(this, &ctx->r_squared_, ctx, mont);
+  } else {
+    LargeUInt reduced = {0};
+    LargeUIntMod(this, &ctx->modulus_, &reduced);
+    MontMultiply(&reduced, &ctx->r_squared_, ctx, mont);
+    LargeUIntFree(&reduced);
+  }
+}
+
+void LargeUIntFromMont(const LargeUInt* mont, const LargeUIntMontCtx* ctx,
+                       LargeUInt* this) {
+  // Reducing mont itself divides out the factor of R.
+  int len = ctx->num_limbs_;
+  int capacity;
+  uint64_t* t = PoolAlloc(3 * len, &capacity);
+  uint64_t* result = t + 2 * len;
+  PadLimbs(mont, 2 * len, t);
+  LimbsMontRedc(t, ctx->modulus_.limbs_, len, ctx->inverse_, result);
+  StoreLimbs(result, len, this);
+  PoolFree(t, capacity);
+}
+
+void LargeUIntMontMul(const LargeUInt* this, const LargeUInt* that,
+                      const LargeUIntMontCtx* ctx, LargeUInt* product) {
+  MontMultiply(this, that, ctx, product);
+}
+
+void LargeUIntMontSqr(const LargeUInt* this, const LargeUIntMontCtx* ctx,
+                      LargeUInt* square) {
+  MontMultiply(this, this, ctx, square);
+}
+
+// Floor of the square root of a 64 bit word by Newton's method.
+static uint64_t WordSqrt(uint64_t value) {
+  if (value < 2) {
+    return value;
+  }
+  int bits = 64 - __builtin_clzll(value);
+  uint64_t estimate = (uint64_t) 1 << ((bits + 1) / 2);
+  uint64_t next = (estimate + value / estimate) / 2;
+  while (next < estimate) {
+    estimate = next;
+    next = (estimate + value / estimate) / 2;
+  }
+  return estimate;
+}
+
+int LargeUIntSqrt(const LargeUInt* this, LargeUInt* root) {
+  int num_limbs = NumLimbs(this);
+  while (num_limbs > 0 && this->limbs_[num_limbs - 1] == 0) {
+    num_limbs--;
+  }
+  if (num_limbs == 0) {
+    LargeUIntInit(0, root);
+    return 1;
+  }
+
+  // Seed from the top bits: with n = top * 2^shift for an even shift and a
+  // top of at most 64 bits, (floor(sqrt(top)) + 1) * 2^(shift / 2) is above
+  // the root and already has its leading 32 bits right.
+  int bits = (num_limbs - 1) * 64 + 64 -
+             __builtin_clzll(this->limbs_[num_limbs - 1]);
+  int shift = bits > 64 ? bits - 64 : 0;
+  shift += shift & 1;
+  uint64_t top = this->limbs_[shift / 64] >> (shift % 64);
+  if (shift % 64 > 0 && shift / 64 + 1 < num_limbs) {
+    top |= this->limbs_[shift / 64 + 1] << (64 - shift % 64);
+  }
+  uint64_t top_root = WordSqrt(top) + 1;
+
+  LargeUInt estimate = {0};
+  int root_shift = shift / 2;
+  LargeUIntInit((root_shift + 64) / 8 + 1, &estimate);
+  estimate.limbs_[root_shift / 64] = top_root << (root_shift % 64);
+  if (root_shift % 64 > 0) {
+    estimate.limbs_[root_shift / 64 + 1] =
+        top_root >> (64 - root_shift % 64);
+  }
+  LargeUIntTrim(&estimate);
+
+  // Newton's method from above decreases to the floor of the root, which is
+  // reached when the next estimate stops getting smaller.
+  LargeUInt quotient = {0};
+  LargeUInt remainder = {0};
+  LargeUInt next_estimate = {0};
   while (1) {
     LargeUIntDivide(this, &estimate, &quotient, &remainder);
-    if (remainder.num_bytes_ == 0) {
-      divided_evenly = 1;
-    } else {
-      divided_evenly = 0;
-    }
-    LargeUIntAdd(&estimate, &quotient);
-    LargeUIntDivide(&quotient, &two, &next_estimate, &remainder);
-
-    comparison = LargeUIntCompare(&next_estimate, &estimate);
-    if (comparison < 1) {
-      if (comparison < 0) {
-        divided_evenly = 0;
-      }
+    LargeUIntClone(&quotient, &next_estimate);
+    LargeUIntAdd(&estimate, &next_estimate);
+    LimbsShiftRight(next_estimate.limbs_, NumLimbs(&next_estimate), 1,
+                    next_estimate.limbs_);
+    LargeUIntTrim(&next_estimate);
+    if (LargeUIntLessThanOrEqual(&estimate, &next_estimate)) {
       break;
     }
-
     LargeUIntClone(&next_estimate, &estimate);
   }
 
   LargeUIntClone(&estimate, root);
-  if (divided_evenly == 0) {
+  int is_square =
+      remainder.num_bytes_ == 0 && LargeUIntEqual(&quotient, &estimate);
+  LargeUIntFree(&estimate);
+  LargeUIntFree(&quotient);
+  LargeUIntFree(&remainder);
+  LargeUIntFree(&next_estimate);
+  return is_square;
+}
+
+void LargeUIntApproximateSquareRoot(const LargeUInt* this, LargeUInt* root) {
+  if (!LargeUIntSqrt(this, root)) {
     LargeUIntIncrement(root);
   }
 }
+
+// Bit index of this, which must be below the value's length in limbs.
+static int BitAt(int index, const LargeUInt* this) {
+  return this->limbs_[index >> 6] >> (index & 63) & 1;
+}
+
+// The length of a trimmed value in bits.
+static int NumBits(const LargeUInt* this) {
+  int num_limbs = NumLimbs(this);
+  if (num_limbs == 0) {
+    return 0;
+  }
+  return num_limbs * 64 - __builtin_clzll(this->limbs_[num_limbs - 1]);
+}
+
+// Adds that to this, where both are below the modulus, modulo the modulus.
+static void AddMod(const LargeUInt* that, const LargeUInt* modulus,
+                   LargeUInt* this) {
+  LargeUIntAdd(that, this);
+  if (!LargeUIntLessThan(this, modulus)) {
+    LargeUIntSub(modulus, this);
+  }
+}
+
+// Subtracts that from this, where both are below the modulus, modulo the
+// modulus.
+static void SubMod(const LargeUInt* that, const LargeUInt* modulus,
+                   LargeUInt* this) {
+  if (LargeUIntLessThan(this, that)) {
+    LargeUIntAdd(modulus, this);
+  }
+  LargeUIntSub(that, this);
+}
+
+// Halves this, which is below the odd modulus, modulo the modulus. Halving is
+// linear, so this works on values in Montgomery form too.
+static void HalveMod(const LargeUInt* modulus, LargeUInt* this) {
+  if (this->num_bytes_ > 0 && (this->limbs_[0] & 1) == 1) {
+    LargeUIntAdd(modulus, this);
+  }
+  int num_limbs = NumLimbs(this);
+  LimbsShiftRight(this->limbs_, num_limbs, 1, this->limbs_);
+  TrimLimbs(num_limbs, this);
+}
+
+// Stores the Montgomery form of a small signed value in mont.
+static void SmallToMont(int64_t value, const LargeUIntMontCtx* ctx,
+                        LargeUInt* mont) {
+  uint64_t magnitude = value < 0 ? -(uint64_t) value : (uint64_t) value;
+  StoreLimbs(&magnitude, 1, mont);
+  LargeUIntToMont(mont, ctx, mont);
+  if (value < 0 && mont->num_bytes_ > 0) {
+    LargeUInt negated = {0};
+    LargeUIntClone(&ctx->modulus_, &negated);
+    LargeUIntSub(mont, &negated);
+    LargeUIntClone(&negated, mont);
+    LargeUIntFree(&negated);
+  }
+}
+
+// Jacobi symbol (a / m) for an odd m.
+static int WordJacobi(uint64_t a, uint64_t m) {
+  int result = 1;
+  a %= m;
+  while (a != 0) {
+    while ((a & 1) == 0) {
+      a >>= 1;
+      if ((m & 7) == 3 || (m & 7) == 5) {
+        result = -result;
+      }
+    }
+    uint64_t swap = a;
+    a = m;
+    m = swap;
+    if ((a & 3) == 3 && (m & 3) == 3) {
+      result = -result;
+    }
+    a %= m;
+  }
+  return m == 1 ? result : 0;
+}
+
+// Jacobi symbol (d / n) for an odd d and an odd n, by quadratic reciprocity.
+static int SmallJacobi(int64_t d, const LargeUInt* n) {
+  uint64_t magnitude = d < 0 ? -(uint64_t) d : (uint64_t) d;
+  int n_mod_4 = n->limbs_[0] & 3;
+  int result = 1;
+  if (d < 0 && n_mod_4 == 3) {
+    result = -result;
+  }
+  if ((magnitude & 3) == 3 && n_mod_4 == 3) {
+    result = -result;
+  }
+  return result * WordJacobi(LargeUIntModWord(n, magnitude), magnitude);
+}
+
+// Strong probable prime test to base 2 of the context's modulus n: with
+// n - 1 = d * 2^s for an odd d, n passes if 2^d = 1 or 2^(d * 2^r) = -1 for
+// some r < s.
+static int IsStrongProbablePrimeBase2(const LargeUIntMontCtx* ctx) {
+  const LargeUInt* n = &ctx->modulus_;
+  LargeUInt n_minus_1 = {0};
+  LargeUIntClone(n, &n_minus_1);
+  LargeUIntDecrement(&n_minus_1);
+  int s = 0;
+  while (!BitAt(s, &n_minus_1)) {
+    s++;
+  }
+
+  LargeUInt one = {0};
+  LargeUInt minus_one = {0};
+  LargeUInt x = {0};
+  SmallToMont(1, ctx, &one);
+  SmallToMont(-1, ctx, &minus_one);
+  // Left to right over the bits of d, where multiplying by the base is
+  // doubling.
+  LargeUIntClone(&one, &x);
+  int i;
+  for (i = NumBits(&n_minus_1) - 1; i >= s; i--) {
+    LargeUIntMontSqr(&x, ctx, &x);
+    if (BitAt(i, &n_minus_1)) {
+      AddMod(&x, n, &x);
+    }
+  }
+
+  int is_probable_prime =
+      LargeUIntEqual(&x, &one) || LargeUIntEqual(&x, &minus_one);
+  for (i = 1; i < s && !is_probable_prime; i++) {
+    LargeUIntMontSqr(&x, ctx, &x);
+    is_probable_prime = LargeUIntEqual(&x, &minus_one);
+  }
+  LargeUIntFree(&n_minus_1);
+  LargeUIntFree(&one);
+  LargeUIntFree(&minus_one);
+  LargeUIntFree(&x);
+  return is_probable_prime;
+}
+
+// Strong Lucas probable prime test of the context's modulus n with P = 1 and
+// Q = (1 - d) / 4, where (d / n) = -1. With n + 1 = k * 2^s for an odd k, n
+// passes if U_k = 0 or V_(k * 2^r) = 0 for some r < s.
+static int IsStrongLucasProbablePrime(int64_t d, const LargeUIntMontCtx* ctx) {
+  const LargeUInt* n = &ctx->modulus_;
+  LargeUInt n_plus_1 = {0};
+  LargeUIntClone(n, &n_plus_1);
+  LargeUIntIncrement(&n_plus_1);
+  int s = 0;
+  while (!BitAt(s, &n_plus_1)) {
+    s++;
+  }
+
+  LargeUInt d_mont = {0};
+  LargeUInt q = {0};
+  LargeUInt u = {0};
+  LargeUInt v = {0};
+  LargeUInt q_k = {0};
+  LargeUInt t = {0};
+  SmallToMont(d, ctx, &d_mont);
+  SmallToMont((1 - d) / 4, ctx, &q);
+  // Start from U_1 = 1, V_1 = P = 1 and Q^1, then go left to right over the
+  // rest of the bits of k.
+  SmallToMont(1, ctx, &u);
+  LargeUIntClone(&u, &v);
+  LargeUIntClone(&q, &q_k);
+  int i;
+  for (i = NumBits(&n_plus_1) - 2; i >= s; i--) {
+    // U_2j = U_j * V_j, V_2j = V_j^2 - 2 * Q^j.
+    LargeUIntMontMul(&u, &v, ctx, &u);
+    LargeUIntMontSqr(&v, ctx, &v);
+    SubMod(&q_k, n, &v);
+    SubMod(&q_k, n, &v);
+    LargeUIntMontSqr(&q_k, ctx, &q_k);
+    if (BitAt(i, &n_plus_1)) {
+      // U_(j+1) = (U_j + V_j) / 2, V_(j+1) = (d * U_j + V_j) / 2.
+      LargeUIntClone(&u, &t);
+      AddMod(&v, n, &t);
+      HalveMod(n, &t);
+      LargeUIntMontMul(&d_mont, &u, ctx, &u);
+      AddMod(&u, n, &v);
+      HalveMod(n, &v);
+      LargeUIntClone(&t, &u);
+      LargeUIntMontMul(&q_k, &q, ctx, &q_k);
+    }
+  }
+
+  int is_probable_prime = u.num_bytes_ == 0 || v.num_bytes_ == 0;
+  for (i = 1; i < s && !is_probable_prime; i++) {
+    LargeUIntMontSqr(&v, ctx, &v);
+    SubMod(&q_k, n, &v);
+    SubMod(&q_k, n, &v);
+    LargeUIntMontSqr(&q_k, ctx, &q_k);
+    is_probable_prime = v.num_bytes_ == 0;
+  }
+  LargeUIntFree(&n_plus_1);
+  LargeUIntFree(&d_mont);
+  LargeUIntFree(&q);
+  LargeUIntFree(&u);
+  LargeUIntFree(&v);
+  LargeUIntFree(&q_k);
+  LargeUIntFree(&t);
+  return is_probable_prime;
+}
+
+// The odd primes below 100. Any candidate below 101^2 with none of them as a
+// factor is prime.
+static const uint32_t kSmallOddPrimes[] = {3, 5, 7, 11, 13, 17, 19, 23, 29, 31,
+                                           37, 41, 43, 47, 53, 59, 61, 67, 71,
+                                           73, 79, 83, 89, 97};
+#define NUM_SMALL_ODD_PRIMES \
+    (sizeof(kSmallOddPrimes) / sizeof(kSmallOddPrimes[0]))
+
+// A perfect square has no d with (d / n) = -1, so after this many tries the
+// candidate is checked for being one.
+#define SQUARE_CHECK_TRIES 8
+
+int LargeUIntIsProbablePrime(const LargeUInt* this) {
+  LargeUInt n = {0};
+  LargeUIntClone(this, &n);
+  LargeUIntTrim(&n);
+  uint64_t word = LargeUIntGetWord(&n);
+  int small = n.num_bytes_ <= 2;
+  if ((word & 1) == 0 || (small && word < 3)) {
+    LargeUIntFree(&n);
+    return small && word == 2;
+  }
+  uint32_t residues[NUM_SMALL_ODD_PRIMES];
+  LargeUIntModSmall(&n, kSmallOddPrimes, NUM_SMALL_ODD_PRIMES, residues);
+  int i;
+  for (i = 0; i < NUM_SMALL_ODD_PRIMES; i++) {
+    if (residues[i] == 0) {
+      LargeUIntFree(&n);
+      return small && word == kSmallOddPrimes[i];
+    }
+  }
+  if (small && word < 101 * 101) {
+    LargeUIntFree(&n);
+    return 1;
+  }
+
+  LargeUIntMontCtx ctx = {0};
+  LargeUIntMontInit(&n, &ctx);
+  int is_probable_prime = IsStrongProbablePrimeBase2(&ctx);
+  if (is_probable_prime) {
+    // Selfridge's choice of d: the first of 5, -7, 9, -11, ... with
+    // (d / n) = -1. As n has no factor below 100, a d with (d / n) = 0 is
+    // smaller than n and shares a factor with it.
+    int64_t d = 5;
+    int tries = 0;
+    int jacobi;
+    while ((jacobi = SmallJacobi(d, &n)) == 1) {
+      if (++tries == SQUARE_CHECK_TRIES) {
+        LargeUInt root = {0};
+        int is_square = LargeUIntSqrt(&n, &root);
+        LargeUIntFree(&root);
+        if (is_square) {
+          jacobi = 0;
+          break;
+        }
+      }
+      d = d < 0 ? 2 - d : -d - 2;
+    }
+    is_probable_prime =
+        jacobi == -1 && IsStrongLucasProbablePrime(d, &ctx);
+  }
+  LargeUIntMontFree(&ctx);
+  LargeUIntFree(&n);
+  return is_probable_prime;
+}
@@ -20,18 +20,80 @@
 #include <stdio.h>
 #include <stdint.h>
 
-#define MAX_NUM_LARGE_U_INT_BYTES 30
-
-// A string buffer to hold a LargeUInt's base 10 represenation could be up to
-// three times the number of bytes with one more byte for the trailing null
-// terminator. This should be a safe overestimate.
-#define BASE_10_LARGE_U_INT_BUFFER_SIZE MAX_NUM_LARGE_U_INT_BYTES * 3 + 1
-
+// The text format records the number of bytes in 4 hexidecimal digits, which
+// limits values to this many bytes.
+#define MAX_NUM_LARGE_U_INT_BYTES 0xFFFF
+
+// Values of up to this many limbs are held inside the LargeUInt itself. Larger
+// values spill over to a buffer from a per-thread pool. Six limbs keep the
+// whole struct to 64 bytes.
+#define LARGE_U_INT_INLINE_LIMBS 6
+
+// The value is held in little endian order in 64 bit limbs, so byte i of the
+// number is found in bits 8 * (i % 8) and up of limbs_[i / 8]. num_bytes_ is
+// still the length of the number in bytes. Any bytes of the highest limb at or
+// above num_bytes_ are always zero.
+//
+// limbs_ points at capacity_ limbs, either inline_ or a pooled buffer, and is
+// NULL until the first value is stored. A LargeUInt must therefore start out
+// zeroed, as in LargeUInt value = {0};, and is released with LargeUIntFree.
+// Since limbs_ may point into the struct, copy values with LargeUIntClone
+// rather than by assignment.
 typedef struct {
   int num_bytes_;
-  uint8_t bytes_[MAX_NUM_LARGE_U_INT_BYTES];
+  int capacity_;
+  uint64_t* limbs_;
+  uint64_t inline_[LARGE_U_INT_INLINE_LIMBS];
 } LargeUInt;
 
+// Precomputed values for Montgomery arithmetic modulo one odd modulus. Set up
+// once with LargeUIntMontInit, then used for any number of LargeUIntMontMul
+// and LargeUIntMontSqr calls, none of which divide.
+typedef struct {
+  LargeUInt modulus_;
+  // The modulus length in limbs, so R = 2^(64 * num_limbs_).
+  int num_limbs_;
+  // -1 / modulus mod 2^64.
+  uint64_t inverse_;
+  // R^2 mod modulus, for converting into Montgomery form.
+  LargeUInt r_squared_;
+} LargeUIntMontCtx;
+
+// Precomputed values for reducing many values modulo one divisor with
+// multiplications in place of long division (Barrett reduction). Set up once
+// with LargeUIntBarrettInit, then used for any number of LargeUIntBarrettMod
+// calls.
+typedef struct {
+  LargeUInt divisor_;
+  // The divisor length in limbs.
+  int num_limbs_;
+  // floor(2^(128 * num_limbs_) / divisor).
+  LargeUInt reciprocal_;
+} LargeUIntBarrettCtx;
+
+// Collects values into blocks for the binary format. Set up with
+// LargeUIntBinaryWriterInit and finished with LargeUIntBinaryWriterClose.
+typedef struct {
+  FILE* out_;
+  // The length of every value in the current block.
+  int record_bytes_;
+  int num_records_;
+  int max_records_;
+  unsigned char* data_;
+} LargeUIntBinaryWriter;
+
+// Reads values from a file of either format, keeping the binary block it is
+// part way through in its own buffer. Set up with LargeUIntBinaryReaderInit
+// and finished with LargeUIntBinaryReaderClose.
+typedef struct {
+  FILE* in_;
+  // The length of every value in the current block, and how many are left.
+  int record_bytes_;
+  int remaining_;
+  unsigned char* data_;
+  unsigned char* next_;
+} LargeUIntBinaryReader;
+
 // The human readable format for large ints is in the following form: The
 // number of bytes is listed first in hexidecimal using 2 bytes in little
 // endian order. So for example 0A00 means that the number's value fits in 10
@@ -46,10 +108,54 @@ void LargeUIntPrint(const LargeUInt* this, FILE* out);
 // typically see an integer written.
 void LargeUIntBase10Print(const LargeUInt* this, FILE* out);
 
-// Reads the next available LargeUInt from the file and stores the value in
-// the provided LargeUInt.
+// Reads the next available LargeUInt in the text format from the file and
+// stores the value in the provided LargeUInt. The value has zero bytes once
+// the end of the file is reached. Files that may hold the binary format are
+// read with LargeUIntBinaryRead, and this exits if it meets a binary marker.
 void LargeUIntRead(FILE* in, LargeUInt* this);
 
+// Moves past the binary header and blocks at the start of the file by their
+// lengths, without reading the values in them, and leaves the file at the
+// text after them. Only the last block is read and checked, and its last value
+// is stored in last, which has zero bytes if the file has no blocks.
+void LargeUIntSkipBinary(FILE* in, LargeUInt* last);
+
+// The binary format starts with an 8 byte header: 0x89, "LPF" and the
+// version as a 32 bit little endian number. Blocks of values follow, each
+// with a 12 byte header: 0x89, 'B', the length of its values in bytes as 16
+// bits, the number of values as 32 bits and the Adler-32 checksum of the
+// values as 32 bits, all little endian. Then come the values themselves,
+// each in exactly that many little endian bytes. Readers check the checksum
+// before returning any value from a block.
+#define LARGE_U_INT_BINARY_VERSION 1
+
+// Marks the start of the binary header and of each block. It can never
+// appear in the text format, so a file starting with it is binary.
+#define LARGE_U_INT_BINARY_MARKER 0x89
+
+// Prepares the reader for the values in the file from its current position.
+void LargeUIntBinaryReaderInit(FILE* in, LargeUIntBinaryReader* reader);
+
+// Reads the next value like LargeUIntRead, from either format, and text may
+// follow binary blocks in the same file. Each block is read in whole and its
+// checksum checked before any of its values is returned.
+void LargeUIntBinaryRead(LargeUIntBinaryReader* reader, LargeUInt* this);
+
+// Releases the reader's buffer, along with the rest of any block it was part
+// way through. The file is left open.
+void LargeUIntBinaryReaderClose(LargeUIntBinaryReader* reader);
+
+// Writes the binary header to out and prepares the writer for values.
+void LargeUIntBinaryWriterInit(FILE* out, LargeUIntBinaryWriter* writer);
+
+// Adds the value to the writer, which writes out a block whenever the value
+// length changes or the block is full.
+void LargeUIntBinaryWrite(const LargeUInt* this, LargeUIntBinaryWriter* writer);
+
+// Writes out the last block and releases the writer's buffer. The file is
+// left open.
+void LargeUIntBinaryWriterClose(LargeUIntBinaryWriter* writer);
+
 // Provides the number of characters required for the text representation
 // of this large unsigned integer.
 int LargeUIntBufferSize(const LargeUInt* this);
@@ -58,6 +164,11 @@ int LargeUIntBufferSize(const LargeUInt* this);
 // provided string buffer.
 void LargeUIntStore(const LargeUInt* this, int buffer_size, char* buffer);
 
+// Provides a safe overestimate of the number of characters required for the
+// base 10 representation, including the null terminator. Each byte needs
+// fewer than three digits.
+int LargeUIntBase10BufferSize(const LargeUInt* this);
+
 // Writes the number as decimal text, with the high order digits listed
 // first.
 void LargeUIntBase10Store(
@@ -70,6 +181,14 @@ void LargeUIntLoad(int buffer_size, char* buffer, LargeUInt* this);
 // Initializes the large unsigned integer to be ready to store a value.
 void LargeUIntInit(int starting_size, LargeUInt* this);
 
+// Returns any spilled storage to the pool and leaves the value zeroed, ready
+// for reuse.
+void LargeUIntFree(LargeUInt* this);
+
+// Frees the buffers the calling thread's pool is holding for reuse. Threads
+// that worked with large values call this before exiting.
+void LargeUIntReleasePool(void);
+
 // Increases available size in the large unisigned integer's internal storage.
 void LargeUIntGrow(LargeUInt* this);
 
@@ -86,6 +205,14 @@ int LargeUIntGetByte(int index, const LargeUInt* this);
 // Reports the number of bytes currently in the large unsiged integer.
 int LargeUIntNumBytes(const LargeUInt* this);
 
+// Retrieves the low order 64 bits of the large unsigned integer, which is the
+// whole value when it has no more than 8 bytes.
+uint64_t LargeUIntGetWord(const LargeUInt* this);
+
+// Sets the large unsigned integer to a value that fits in one 64 bit word,
+// trimmed to the bytes the value needs.
+void LargeUIntSetWord(uint64_t value, LargeUInt* this);
+
 // Compares two large unsigned integers, returning 0 if they are equal, 1 if
 // the second is greater than the first, and -1 if the first is greater than
 // the second.
@@ -149,6 +276,11 @@ void LargeUIntDecrement(LargeUInt* this);
 // if the result is too big to store in a large unsigned integer.
 void LargeUIntMultiply(const LargeUInt* that, LargeUInt* this);
 
+// Multiplies the first two arguments and stores the full product in the third
+// argument, which may be the same as either input.
+void LargeUIntMultiplyFull(const LargeUInt* this, const LargeUInt* that,
+                           LargeUInt* product);
+
 // Divides the numerator by the denominator storing the results in the
 // quotient and remainder.
 void LargeUIntDivide(const LargeUInt* numerator, const LargeUInt* denominator,
@@ -159,9 +291,84 @@ void LargeUIntDivide(const LargeUInt* numerator, const LargeUInt* denominator,
 void LargeUIntMod(const LargeUInt* numerator, const LargeUInt* divisor,
                   LargeUInt* remainder);
 
-// Finds an integer that is close to the square root of the first argument
-// without being less than the actual square root. Intended for a rough
-// overestimate of the square root.
+// Prepares a Montgomery context for the given modulus, which must be odd. The
+// context must start out zeroed like a LargeUInt.
+void LargeUIntMontInit(const LargeUInt* modulus, LargeUIntMontCtx* ctx);
+
+// Releases the values held by a Montgomery context.
+void LargeUIntMontFree(LargeUIntMontCtx* ctx);
+
+// Converts the first argument into Montgomery form (this * R mod modulus),
+// storing it in the last argument. The input may be any size; the output may
+// be the same as the input.
+void LargeUIntToMont(const LargeUInt* this, const LargeUIntMontCtx* ctx,
+                     LargeUInt* mont);
+
+// Converts a value in Montgomery form back to an ordinary value modulo the
+// context's modulus. The output may be the same as the input.
+void LargeUIntFromMont(const LargeUInt* mont, const LargeUIntMontCtx* ctx,
+                       LargeUInt* this);
+
+// Multiplies two values in Montgomery form, storing their product, also in
+// Montgomery form, in the last argument. Both inputs must be less than the
+// modulus. The output may be the same as either input.
+void LargeUIntMontMul(const LargeUInt* this, const LargeUInt* that,
+                      const LargeUIntMontCtx* ctx, LargeUInt* product);
+
+// Squares a value in Montgomery form. Cheaper than LargeUIntMontMul of a value
+// with itself since each cross product is only computed once.
+void LargeUIntMontSqr(const LargeUInt* this, const LargeUIntMontCtx* ctx,
+                      LargeUInt* square);
+
+// Prepares a Barrett context for the given non-zero divisor. The context must
+// start out zeroed like a LargeUInt.
+void LargeUIntBarrettInit(const LargeUInt* divisor, LargeUIntBarrettCtx* ctx);
+
+// Releases the values held by a Barrett context.
+void LargeUIntBarrettFree(LargeUIntBarrettCtx* ctx);
+
+// Stores the first argument modulo the context's divisor in the last argument,
+// which may be the same as the first. Values of up to twice the divisor's
+// length cost two multiplications, which use Karatsuba for long divisors;
+// longer values fall back to LargeUIntMod.
+void LargeUIntBarrettMod(const LargeUInt* this, const LargeUIntBarrettCtx* ctx,
+                         LargeUInt* remainder);
+
+// Stores the greatest common divisor of the first two arguments in the third,
+// which may be the same as either input. The gcd of 0 and x is x.
+void LargeUIntGcd(const LargeUInt* this, const LargeUInt* that,
+                  LargeUInt* gcd);
+
+// Returns the remainder of the first argument modulo a divisor that fits in
+// one 64 bit word. Much faster than LargeUIntMod for such divisors.
+uint64_t LargeUIntModWord(const LargeUInt* this, uint64_t divisor);
+
+// Returns 1 if the divisor divides the first argument with no remainder.
+// Divisors that fit in one word take the fast LargeUIntModWord path.
+int LargeUIntIsDivisibleBy(const LargeUInt* this, const LargeUInt* divisor);
+
+// Writes the remainder of the first argument modulo each of count divisors,
+// none of them 0, into residues. The value is read once for each vector of 8
+// or 16 divisors, using AVX2 or AVX-512 when the CPU has them, which makes
+// this much faster than LargeUIntModWord for screening against many small
+// primes.
+void LargeUIntModSmall(const LargeUInt* this, const uint32_t* divisors,
+                       int count, uint32_t* residues);
+
+// Stores the square root of the first argument, rounded down, in the second
+// argument. Returns 1 if the first argument is a perfect square, otherwise 0.
+int LargeUIntSqrt(const LargeUInt* this, LargeUInt* root);
+
+// Finds the smallest integer that is not less than the square root of the
+// first argument, i.e. the square root rounded up. Intended as a cap on the
+// divisors to try.
 void LargeUIntApproximateSquareRoot(const LargeUInt* this, LargeUInt* root);
 
+// Returns 1 if the argument is a Baillie-PSW probable prime, that is, it has
+// no factor below 100 and passes both a strong probable prime test to base 2
+// and a strong Lucas test with Selfridge's parameters. Otherwise returns 0,
+// and the argument is certainly composite. No composite below 2^64 passes,
+// and none is known above it, while a prime always does.
+int LargeUIntIsProbablePrime(const LargeUInt* this);
+
 #endif
@@ -15,37 +15,67 @@
  */
 
 #include "bit-u-int.h"
+#include "wheel.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 
+// Returns the remainder of dividing this by a small positive divisor.
+static int ModSmall(const BitUInt* this, int divisor) {
+  BitUInt modulus;
+  BitUInt remainder;
+  int i;
+  BitUIntLoad(0, "", &modulus);
+  for (i = 0; (divisor >> i) != 0; i++) {
+    BitUIntSetBit((divisor >> i) & 1, i, &modulus);
+  }
+  BitUIntMod(this, &modulus, &remainder);
+  int value = 0;
+  for (i = remainder.num_bits - 1; i >= 0; i--) {
+    value = (value << 1) | BitUIntGetBit(i, &remainder);
+  }
+  return value;
+}
+
+// Adds a small non-negative amount to this.
+static void AddSmall(int amount, BitUInt* this) {
+  while (amount-- > 0) {
+    BitUIntInc(this);
+  }
+}
+
 void FindNearbyPrime(BitUInt* candidate) {
-  // If the starting point is even, make it odd.
-  candidate->bits[0] = 1;
+  // The wheel steps over 3, 5 and 7, so small starting points are settled
+  // here.
+  if (candidate->num_bits <= 3) {
+    int prime = WheelSmallOddPrime(ModSmall(candidate, WHEEL_MODULUS));
+    BitUIntLoad(0, "", candidate);
+    AddSmall(prime, candidate);
+    return;
+  }
+
+  // Move up to the first candidate with no factor below 11, then only try
+  // candidates and divisors on the wheel.
+  Wheel candidate_wheel;
+  Wheel divisor_wheel;
+  AddSmall(WheelStart(ModSmall(candidate, WHEEL_MODULUS), &candidate_wheel),
+           candidate);
 
   BitUInt quotient;
   BitUInt remainder;
 
   // Establish the limit of the highest divisor we need to try.
   BitUInt max_divisor;
-  //LargeUIntApproximateSquareRoot(candidate, &max_divisor);
-  BitUIntClone(candidate, &max_divisor);
-  BitUIntHalve(&max_divisor);
+  BitUIntApproximateSquareRoot(candidate, &max_divisor);
 
   // To report progress, track when we have tried each 2% of the possible
   // divisors.
   BitUInt one_fiftieth_max;
   BitUInt next_reporting_milestone;
   BitUInt fifty;
-  fifty.num_bits = 6;
-  fifty.bits[0] = 0;
-  fifty.bits[1] = 1;
-  fifty.bits[2] = 0;
-  fifty.bits[3] = 0;
-  fifty.bits[4] = 1;
-  fifty.bits[5] = 1;
+  BitUIntLoad(6, "010011", &fifty);
   BitUIntDiv(&max_divisor, &fifty, &one_fiftieth_max, &remainder);
   BitUIntClone(&one_fiftieth_max, &next_reporting_milestone);
 
@@ -57,21 +87,18 @@ void FindNearbyPrime(BitUInt* candidate) {
   printf("\n           x");
   fflush(stdout);
 
-  // Try divisors starting with the smallest possible: 3.
+  // Try divisors starting with the smallest possible: 11.
   BitUInt divisor;
-  divisor.num_bits = 2;
-  divisor.bits[0] = 1;
-  divisor.bits[1] = 1;
+  BitUIntLoad(4, "1101", &divisor);
+  WheelStart(WHEEL_FIRST_DIVISOR, &divisor_wheel);
   while (BitUIntCompare(&divisor, &max_divisor) >= 0) {
     BitUIntMod(candidate, &divisor, &remainder);
     if (remainder.num_bits == 0) {
-      // Add two to the candidate to see if the next odd number is prime.
-      BitUIntInc(candidate);
-      BitUIntInc(candidate);
-      // Start over with the lowest possible divisor (3).
-      divisor.num_bits = 2;
-      divisor.bits[0] = 1;
-      divisor.bits[1] = 1;
+      // Move the candidate on to the next number on the wheel.
+      AddSmall(WheelNext(&candidate_wheel), candidate);
+      // Start over with the lowest possible divisor (11).
+      BitUIntLoad(4, "1101", &divisor);
+      WheelStart(WHEEL_FIRST_DIVISOR, &divisor_wheel);
 
       printf("\nTrying a new possible prime ");
       BitUIntBase10Print(candidate);
@@ -82,16 +109,13 @@ void FindNearbyPrime(BitUInt* candidate) {
       fflush(stdout);
 
       // New candidate so find a new cap for divisors.
-      //LargeUIntApproximateSquareRoot(candidate, &max_divisor);
-      BitUIntClone(candidate, &max_divisor);
-      BitUIntHalve(&max_divisor);
+      BitUIntApproximateSquareRoot(candidate, &max_divisor);
 
       // Report the new candidate and reset our progress reporting.
       BitUIntDiv(&max_divisor, &fifty, &one_fiftieth_max, &remainder);
       BitUIntClone(&one_fiftieth_max, &next_reporting_milestone);
     } else {
-      BitUIntInc(&divisor);
-      BitUIntInc(&divisor);
+      AddSmall(WheelNext(&divisor_wheel), &divisor);
       if (BitUIntCompare(&divisor, &next_reporting_milestone) < 1) {
         printf("x");
         fflush(stdout);
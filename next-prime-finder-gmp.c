@@ -1,24 +1,36 @@
 #include <stdio.h>
 #include <gmp.h>
 
+#include "wheel.h"
+
 void FindNearbyPrime(mpz_t candidate) {
   mpz_t divisor;
   mpz_t limit;
   mpz_init(divisor);
   mpz_init(limit);
-  mpz_set_ui(divisor, 2);
   mpz_t remainder;
   mpz_init(remainder);
 
-  mpz_mod(remainder, candidate, divisor);
-  if (mpz_size(remainder) == 0) {
-    mpz_add_ui(candidate, candidate, 1);
+  // The wheel steps over 3, 5 and 7, so small starting points are settled
+  // here.
+  if (mpz_cmp_ui(candidate, 7) <= 0) {
+    mpz_set_ui(candidate, WheelSmallOddPrime(mpz_get_ui(candidate)));
+    return;
   }
-  
-  // The candidate should now be odd.
+
+  // Move up to the first candidate with no factor below 11, then only try
+  // candidates and divisors on the wheel.
+  Wheel candidate_wheel;
+  Wheel divisor_wheel;
+  mpz_add_ui(candidate, candidate,
+             WheelStart(mpz_fdiv_ui(candidate, WHEEL_MODULUS),
+                        &candidate_wheel));
+
+  // The candidate now has no factor below 11.
   printf("Starting with possible prime %s\n", mpz_get_str(NULL, 10, candidate));
 
-  mpz_set_ui(divisor, 3);
+  mpz_set_ui(divisor, WHEEL_FIRST_DIVISOR);
+  WheelStart(WHEEL_FIRST_DIVISOR, &divisor_wheel);
   mpz_root(limit, candidate, 2);
   // Round up the square root (may not really be necessary).
   mpz_add_ui(limit, limit, 1);
@@ -27,15 +39,16 @@ void FindNearbyPrime(mpz_t candidate) {
     if (mpz_size(remainder) == 0) {
       printf("%s is not prime (divisible by %s)\n",
              mpz_get_str(NULL, 10, candidate), mpz_get_str(NULL, 10, divisor));
-      // Incremend the candidate by 2.
-      mpz_add_ui(candidate, candidate, 2);
-      // Start over with a divisor of 3.
-      mpz_set_ui(divisor, 3);
+      // Move the candidate on to the next number on the wheel.
+      mpz_add_ui(candidate, candidate, WheelNext(&candidate_wheel));
+      // Start over with a divisor of 11.
+      mpz_set_ui(divisor, WHEEL_FIRST_DIVISOR);
+      WheelStart(WHEEL_FIRST_DIVISOR, &divisor_wheel);
       mpz_root(limit, candidate, 2);
       mpz_add_ui(limit, limit, 1);
     } else {
-      // Try the next higher divisor (step by 2).
-      mpz_add_ui(divisor, divisor, 2);
+      // Try the next higher divisor on the wheel.
+      mpz_add_ui(divisor, divisor, WheelNext(&divisor_wheel));
     }
   }
 
@@ -14,101 +14,86 @@
  * limitations under the License.
  */
 
+#include "candidate-search.h"
 #include "large-u-int.h"
+#include "search-checkpoint.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
 
-void FindNearbyPrime(LargeUInt* candidate) {
-  if (LargeUIntGetByte(0, candidate) % 2 == 0) {
-    LargeUIntIncrement(candidate);
-  }
-
-  LargeUInt quotient;
-  LargeUInt remainder;
-
-  // Establish the limit of the highest divisor we need to try.
-  LargeUInt max_divisor;
-  LargeUIntApproximateSquareRoot(candidate, &max_divisor);
-
-  // To report progress, track when we have tried each 2% of the possible
-  // divisors.
-  LargeUInt one_fiftieth_max;
-  LargeUInt next_reporting_milestone;
-  LargeUInt fifty;
-  LargeUIntInit(1, &fifty);
-  LargeUIntSetByte(50, 0, &fifty);
-  LargeUIntDivide(&max_divisor, &fifty, &one_fiftieth_max, &remainder);
-  LargeUIntClone(&one_fiftieth_max, &next_reporting_milestone);
-
-  printf("Starting with possible prime ");
-  LargeUIntBase10Print(candidate, stdout);
-  printf("\nMaximum divisor: ");
-  LargeUIntPrint(&max_divisor, stdout);
-  printf("\nProgress: 0|-------20|-------40|-------60|-------80|------100|");
-  printf("\n           x");
-  fflush(stdout);
-
-  // Try divisors starting with the smallest possible: 3.
-  LargeUInt divisor;
-  LargeUIntInit(1, &divisor);
-  LargeUIntSetByte(3, 0, &divisor);
-  while (LargeUIntCompare(&divisor, &max_divisor) >= 0) {
-    LargeUIntMod(candidate, &divisor, &remainder);
-    if (LargeUIntNumBytes(&remainder) == 0) {
-      LargeUIntAddByte(2, candidate);
-      LargeUIntInit(1, &divisor);
-      LargeUIntSetByte(3, 0, &divisor);
-
-      printf("\nTrying a new possible prime ");
-      LargeUIntBase10Print(candidate, stdout);
-      printf("\nMaximum divisor: ");
-      LargeUIntPrint(&max_divisor, stdout);
-      printf("\nProgress: 0|-------20|-------40|-------60|-------80|");
-      printf("------100|\n           x");
-      fflush(stdout);
-
-      // New candidate so find a new cap for divisors.
-      LargeUIntApproximateSquareRoot(candidate, &max_divisor);
-
-      // Report the new candidate and reset our progress reporting.
-      LargeUIntDivide(&max_divisor, &fifty, &one_fiftieth_max, &remainder);
-      LargeUIntClone(&one_fiftieth_max, &next_reporting_milestone);
+int main(int argc, char *argv[]) {
+  int num_threads = 1;
+  char* checkpoint_file = NULL;
+  int resume = 0;
+  int probable = 0;
+  char* start = NULL;
+  int usage = 0;
+  int i;
+  for (i = 1; i < argc && !usage; i++) {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+      num_threads = atoi(argv[++i]);
+      usage = num_threads < 1;
+    } else if ((strcmp(argv[i], "--checkpoint") == 0 ||
+                strcmp(argv[i], "--resume") == 0) && i + 1 < argc) {
+      resume = strcmp(argv[i], "--resume") == 0;
+      checkpoint_file = argv[++i];
+    } else if (strcmp(argv[i], "--probable") == 0) {
+      probable = 1;
+    } else if (start == NULL) {
+      start = argv[i];
     } else {
-      LargeUIntAddByte(2, &divisor);
-      if (LargeUIntCompare(&divisor, &next_reporting_milestone) < 1) {
-        printf("x");
-        fflush(stdout);
-        LargeUIntAdd(&one_fiftieth_max, &next_reporting_milestone);
-      }
+      usage = 1;
     }
   }
-
-  // We ran out of divisors so the value stored in candidate is prime.
-}
-
-void PrintPrime(LargeUInt* prime, FILE* out) {
-  LargeUIntPrint(prime, out);
-  fprintf(out, " # int value: ");
-  LargeUIntBase10Print(prime, out);
-  fprintf(out, "\n");
-}
-
-int main(int argc, char *argv[]) {
-  if (argc < 2) {
-    printf("Usage: %s <starting number in LargeUInt format>\n", argv[0]);
+  if (usage || (start == NULL) != resume ||
+      (probable && (num_threads > 1 || checkpoint_file != NULL))) {
+    printf("Usage: %s [-j threads] [--checkpoint file] <starting number in "
+           "LargeUInt format>\n", argv[0]);
+    printf("       %s [-j threads] --resume file\n", argv[0]);
+    printf("       %s --probable <starting number in LargeUInt format>\n",
+           argv[0]);
     printf("For example %s 0100_0D\n", argv[0]);
+    printf("With -j, the divisors of each candidate are tried on that many "
+           "threads.\n");
+    printf("With --checkpoint, the progress is saved to the file every few "
+           "seconds,\nand --resume carries on from it.\n");
+    printf("With --probable, a Baillie-PSW test takes the place of trial "
+           "division.\n");
     return 1;
   }
-  LargeUInt prime;
-  LargeUIntLoad(strlen(argv[1]), argv[1], &prime);
-  FindNearbyPrime(&prime);
-  printf("\nPrime:\n");
-  PrintPrime(&prime, stdout);
+
+  LargeUInt prime = {0};
+  SearchCheckpoint checkpoint = {0};
+  if (resume) {
+    if (!SearchCheckpointLoad(checkpoint_file, CANDIDATE_SEARCH_CHECKPOINT_MS,
+                              &checkpoint)) {
+      printf("Unable to read the checkpoint %s\n", checkpoint_file);
+      return 1;
+    }
+    LargeUIntClone(&checkpoint.candidate, &prime);
+  } else {
+    LargeUIntLoad(strlen(start), start, &prime);
+    if (checkpoint_file != NULL) {
+      SearchCheckpointInit(checkpoint_file, CANDIDATE_SEARCH_CHECKPOINT_MS,
+                           &checkpoint);
+    }
+  }
+  if (probable) {
+    CandidateSearchProbablePrime(&prime);
+    printf("Probable prime:\n");
+  } else {
+    CandidateSearchPrime(num_threads,
+                         checkpoint_file == NULL ? NULL : &checkpoint, &prime);
+    printf("\nPrime:\n");
+  }
+  CandidateSearchPrintPrime(&prime, stdout);
   printf("\n");
+  LargeUIntFree(&prime);
+  if (checkpoint_file != NULL) {
+    SearchCheckpointFree(&checkpoint);
+  }
 
   return 0;
 }
-
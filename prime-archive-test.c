@@ -0,0 +1,141 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "prime-archive.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SIEVE_LIMIT 3000000
+
+void Check(int condition, char* message) {
+  if (!condition) {
+    fprintf(stderr, "Condition failed: %s\n", message);
+    exit(1);
+  }
+}
+
+// Fills primes with the primes below SIEVE_LIMIT and returns how many.
+long SmallPrimes(uint64_t* primes) {
+  char* composite = calloc(SIEVE_LIMIT, 1);
+  long num_primes = 0;
+  long i;
+  for (i = 2; i < SIEVE_LIMIT; i++) {
+    if (!composite[i]) {
+      primes[num_primes++] = i;
+      long j;
+      for (j = i * i; j < SIEVE_LIMIT; j += i) {
+        composite[j] = 1;
+      }
+    }
+  }
+  free(composite);
+  return num_primes;
+}
+
+// Returns 1 if the archive holds exactly the first num_primes of primes.
+int ArchiveMatches(char* filename, const uint64_t* primes, long num_primes) {
+  PrimeArchive archive;
+  PrimeArchiveOpen(filename, &archive);
+  uint64_t* decoded = malloc(PRIME_ARCHIVE_BLOCK_PRIMES * sizeof(uint64_t));
+  long total = 0;
+  int matches = 1;
+  long block;
+  for (block = 0; block < PrimeArchiveNumBlocks(&archive); block++) {
+    uint32_t count = PrimeArchiveReadBlock(block, &archive, decoded);
+    if (total + count > num_primes ||
+        memcmp(decoded, primes + total, count * sizeof(uint64_t)) != 0) {
+      matches = 0;
+      break;
+    }
+    total += count;
+  }
+  free(decoded);
+  PrimeArchiveClose(&archive);
+  return matches && total == num_primes;
+}
+
+long FileSize(char* filename) {
+  FILE* file = fopen(filename, "rb");
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fclose(file);
+  return size;
+}
+
+void TestArchive() {
+  uint64_t* primes = malloc(SIEVE_LIMIT / 2 * sizeof(uint64_t));
+  long num_primes = SmallPrimes(primes);
+  char filename[] = "/tmp/prime-archive-testXXXXXX";
+  close(mkstemp(filename));
+  unlink(filename);
+
+  // Write the first half, then resume and write the rest.
+  PrimeArchiveWriter writer;
+  PrimeArchiveWriterOpen(filename, &writer);
+  Check(PrimeArchiveWriterLastPrime(&writer) == 0, "New archive is empty");
+  long half = num_primes / 2;
+  long i;
+  for (i = 0; i < half; i++) {
+    PrimeArchiveWrite(primes[i], &writer);
+  }
+  PrimeArchiveWriterClose(&writer);
+  Check(ArchiveMatches(filename, primes, half), "First half should read back");
+
+  PrimeArchiveWriterOpen(filename, &writer);
+  Check(PrimeArchiveWriterLastPrime(&writer) == primes[half - 1],
+        "Reopened archive should know its last prime");
+  for (i = half; i < num_primes; i++) {
+    PrimeArchiveWrite(primes[i], &writer);
+  }
+  PrimeArchiveWriterClose(&writer);
+  Check(ArchiveMatches(filename, primes, num_primes),
+        "Every prime should read back");
+  Check(FileSize(filename) < 2 * num_primes,
+        "Small gaps should take about a byte each");
+
+  // Without its index, and with the last block cut short, the archive still
+  // reads back every whole block.
+  PrimeArchive archive;
+  PrimeArchiveOpen(filename, &archive);
+  long num_blocks = PrimeArchiveNumBlocks(&archive);
+  const PrimeArchiveBlock* last = PrimeArchiveGetBlock(num_blocks - 1,
+                                                       &archive);
+  long kept_primes = num_primes - last->num_primes;
+  long cut_size = last->offset + 20;
+  PrimeArchiveClose(&archive);
+  Check(truncate(filename, cut_size) == 0, "Archive should be cut");
+  Check(ArchiveMatches(filename, primes, kept_primes),
+        "Whole blocks should read back without the index");
+
+  PrimeArchiveWriterOpen(filename, &writer);
+  Check(PrimeArchiveWriterLastPrime(&writer) == primes[kept_primes - 1],
+        "Writer should resume after the last whole block");
+  for (i = kept_primes; i < num_primes; i++) {
+    PrimeArchiveWrite(primes[i], &writer);
+  }
+  PrimeArchiveWriterClose(&writer);
+  Check(ArchiveMatches(filename, primes, num_primes),
+        "Rewritten archive should read back");
+
+  unlink(filename);
+  free(primes);
+}
+
+int main() {
+  TestArchive();
+  printf("All tests passed\n");
+}
@@ -0,0 +1,350 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "prime-archive.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define HEADER_BYTES 8
+#define BLOCK_HEADER_BYTES 16
+#define INDEX_ENTRY_BYTES 24
+#define TRAILER_BYTES 16
+// A varint of a 64 bit value takes at most 10 bytes.
+#define MAX_VARINT_BYTES 10
+
+static const unsigned char kHeaderMagic[] = {0x89, 'P', 'G', 'A'};
+static const unsigned char kTrailerMagic[] = {'P', 'G', 'A', 'X'};
+
+// Exits the program after sending the message to stderr.
+static void ErrorOut(char* message) {
+  fprintf(stderr, "%s\n", message);
+  exit(1);
+}
+
+static uint64_t LoadLittleEndian(const unsigned char* bytes, int num_bytes) {
+  uint64_t value = 0;
+  int i;
+  for (i = num_bytes - 1; i >= 0; i--) {
+    value = value << 8 | bytes[i];
+  }
+  return value;
+}
+
+static void StoreLittleEndian(uint64_t value, int num_bytes,
+                              unsigned char* bytes) {
+  int i;
+  for (i = 0; i < num_bytes; i++) {
+    bytes[i] = value >> (8 * i) & 0xFF;
+  }
+}
+
+// Reads num_bytes at offset without moving the file position, so that
+// several threads can read the same file.
+static int ReadAt(FILE* file, uint64_t offset, size_t num_bytes,
+                  unsigned char* bytes) {
+  while (num_bytes > 0) {
+    ssize_t result = pread(fileno(file), bytes, num_bytes, offset);
+    if (result <= 0) {
+      return 0;
+    }
+    bytes += result;
+    offset += result;
+    num_bytes -= result;
+  }
+  return 1;
+}
+
+static void AddBlock(const PrimeArchiveBlock* block, PrimeArchiveBlock** blocks,
+                     long* num_blocks, long* capacity) {
+  if (*num_blocks == *capacity) {
+    *capacity = *capacity == 0 ? 64 : 2 * *capacity;
+    *blocks = realloc(*blocks, *capacity * sizeof(PrimeArchiveBlock));
+    if (*blocks == NULL) {
+      ErrorOut("Unable to allocate space for the archive index.");
+    }
+  }
+  (*blocks)[*num_blocks] = *block;
+  (*num_blocks)++;
+}
+
+// Loads the list of blocks, from the index if there is a whole one and by
+// scanning the blocks otherwise. Returns the offset just past the last
+// whole block, where more blocks can be written.
+static uint64_t LoadBlocks(FILE* file, PrimeArchiveBlock** blocks,
+                           long* num_blocks, long* capacity) {
+  unsigned char bytes[BLOCK_HEADER_BYTES];
+  if (!ReadAt(file, 0, HEADER_BYTES, bytes) ||
+      memcmp(bytes, kHeaderMagic, sizeof(kHeaderMagic)) != 0) {
+    ErrorOut("Not a prime archive.");
+  }
+  if (LoadLittleEndian(bytes + 4, 4) != PRIME_ARCHIVE_VERSION) {
+    ErrorOut("Prime archive version is not supported.");
+  }
+  if (fseek(file, 0, SEEK_END) != 0) {
+    ErrorOut("Unable to seek in the prime archive.");
+  }
+  uint64_t size = ftell(file);
+  *num_blocks = 0;
+
+  if (size >= HEADER_BYTES + TRAILER_BYTES &&
+      ReadAt(file, size - TRAILER_BYTES, TRAILER_BYTES, bytes) &&
+      memcmp(bytes + 12, kTrailerMagic, sizeof(kTrailerMagic)) == 0) {
+    uint64_t index_offset = LoadLittleEndian(bytes, 8);
+    uint64_t count = LoadLittleEndian(bytes + 8, 4);
+    if (index_offset + count * INDEX_ENTRY_BYTES + TRAILER_BYTES == size) {
+      unsigned char entry[INDEX_ENTRY_BYTES];
+      uint64_t i;
+      for (i = 0; i < count; i++) {
+        if (!ReadAt(file, index_offset + i * INDEX_ENTRY_BYTES,
+                    INDEX_ENTRY_BYTES, entry)) {
+          ErrorOut("Unable to read the archive index.");
+        }
+        PrimeArchiveBlock block;
+        block.anchor = LoadLittleEndian(entry, 8);
+        block.offset = LoadLittleEndian(entry + 8, 8);
+        block.num_primes = LoadLittleEndian(entry + 16, 4);
+        block.num_bytes = LoadLittleEndian(entry + 20, 4);
+        AddBlock(&block, blocks, num_blocks, capacity);
+      }
+      return index_offset;
+    }
+  }
+
+  // No whole index, so walk the blocks and stop at one that is cut short.
+  uint64_t offset = HEADER_BYTES;
+  while (offset + BLOCK_HEADER_BYTES <= size) {
+    if (!ReadAt(file, offset, BLOCK_HEADER_BYTES, bytes)) {
+      ErrorOut("Unable to read the prime archive.");
+    }
+    PrimeArchiveBlock block;
+    block.anchor = LoadLittleEndian(bytes, 8);
+    block.offset = offset;
+    block.num_primes = LoadLittleEndian(bytes + 8, 4);
+    block.num_bytes = LoadLittleEndian(bytes + 12, 4);
+    if (block.num_primes == 0 ||
+        offset + BLOCK_HEADER_BYTES + block.num_bytes > size) {
+      break;
+    }
+    AddBlock(&block, blocks, num_blocks, capacity);
+    offset += BLOCK_HEADER_BYTES + block.num_bytes;
+  }
+  return offset;
+}
+
+static uint32_t ReadBlock(FILE* file, const PrimeArchiveBlock* block,
+                          uint64_t* primes) {
+  unsigned char* payload = malloc(block->num_bytes + 1);
+  if (payload == NULL) {
+    ErrorOut("Unable to allocate space for an archive block.");
+  }
+  if (!ReadAt(file, block->offset + BLOCK_HEADER_BYTES, block->num_bytes,
+              payload)) {
+    ErrorOut("Unable to read an archive block.");
+  }
+  const unsigned char* next = payload;
+  const unsigned char* end = payload + block->num_bytes;
+  uint64_t prime = block->anchor;
+  primes[0] = prime;
+  uint32_t i;
+  for (i = 1; i < block->num_primes; i++) {
+    uint64_t half_gap = 0;
+    int shift = 0;
+    do {
+      if (next == end || shift >= 64) {
+        ErrorOut("Archive block is corrupt.");
+      }
+      half_gap |= (uint64_t) (*next & 0x7F) << shift;
+      shift += 7;
+    } while (*next++ & 0x80);
+    prime += half_gap == 0 ? 1 : 2 * half_gap;
+    primes[i] = prime;
+  }
+  free(payload);
+  return block->num_primes;
+}
+
+// Writes out the block being collected, if it has any primes.
+static void WriteBlock(PrimeArchiveWriter* writer) {
+  if (writer->num_primes_ == 0) {
+    return;
+  }
+  PrimeArchiveBlock block;
+  block.anchor = writer->anchor_;
+  block.offset = ftell(writer->file_);
+  block.num_primes = writer->num_primes_;
+  block.num_bytes = writer->num_bytes_;
+  unsigned char header[BLOCK_HEADER_BYTES];
+  StoreLittleEndian(block.anchor, 8, header);
+  StoreLittleEndian(block.num_primes, 4, header + 8);
+  StoreLittleEndian(block.num_bytes, 4, header + 12);
+  if (fwrite(header, 1, BLOCK_HEADER_BYTES, writer->file_) !=
+          BLOCK_HEADER_BYTES ||
+      fwrite(writer->payload_, 1, block.num_bytes, writer->file_) !=
+          block.num_bytes) {
+    ErrorOut("Unable to write an archive block.");
+  }
+  AddBlock(&block, &writer->blocks_, &writer->num_blocks_,
+           &writer->capacity_);
+  writer->num_primes_ = 0;
+  writer->num_bytes_ = 0;
+}
+
+void PrimeArchiveWriterOpen(char* filename, PrimeArchiveWriter* writer) {
+  writer->blocks_ = NULL;
+  writer->num_blocks_ = 0;
+  writer->capacity_ = 0;
+  writer->last_prime_ = 0;
+  writer->num_primes_ = 0;
+  writer->num_bytes_ = 0;
+  writer->payload_ =
+      malloc((size_t) PRIME_ARCHIVE_BLOCK_PRIMES * MAX_VARINT_BYTES);
+  if (writer->payload_ == NULL) {
+    ErrorOut("Unable to allocate space for an archive block.");
+  }
+
+  writer->file_ = fopen(filename, "r+b");
+  if (writer->file_ == NULL) {
+    writer->file_ = fopen(filename, "w+b");
+    if (writer->file_ == NULL) {
+      ErrorOut("Unable to open the prime archive.");
+    }
+    unsigned char header[HEADER_BYTES];
+    memcpy(header, kHeaderMagic, sizeof(kHeaderMagic));
+    StoreLittleEndian(PRIME_ARCHIVE_VERSION, 4, header + 4);
+    if (fwrite(header, 1, HEADER_BYTES, writer->file_) != HEADER_BYTES) {
+      ErrorOut("Unable to write the archive header.");
+    }
+    return;
+  }
+
+  // Drop the old index, or a block that was cut short, and add blocks from
+  // there.
+  uint64_t end = LoadBlocks(writer->file_, &writer->blocks_,
+                            &writer->num_blocks_, &writer->capacity_);
+  if (fflush(writer->file_) != 0 ||
+      ftruncate(fileno(writer->file_), end) != 0 ||
+      fseek(writer->file_, end, SEEK_SET) != 0) {
+    ErrorOut("Unable to prepare the prime archive for writing.");
+  }
+  if (writer->num_blocks_ > 0) {
+    const PrimeArchiveBlock* last = &writer->blocks_[writer->num_blocks_ - 1];
+    uint64_t* primes = malloc(last->num_primes * sizeof(uint64_t));
+    if (primes == NULL) {
+      ErrorOut("Unable to allocate space for an archive block.");
+    }
+    ReadBlock(writer->file_, last, primes);
+    writer->last_prime_ = primes[last->num_primes - 1];
+    free(primes);
+  }
+}
+
+uint64_t PrimeArchiveWriterLastPrime(const PrimeArchiveWriter* writer) {
+  return writer->last_prime_;
+}
+
+void PrimeArchiveWrite(uint64_t prime, PrimeArchiveWriter* writer) {
+  if (prime <= writer->last_prime_) {
+    ErrorOut("Primes must be added to the archive in increasing order.");
+  }
+  if (writer->num_primes_ == PRIME_ARCHIVE_BLOCK_PRIMES) {
+    WriteBlock(writer);
+  }
+  if (writer->num_primes_ == 0) {
+    writer->anchor_ = prime;
+  } else {
+    uint64_t gap = prime - writer->last_prime_;
+    if (gap % 2 == 1 && gap != 1) {
+      ErrorOut("Odd gap between archived primes.");
+    }
+    uint64_t half_gap = gap / 2;
+    unsigned char* next = writer->payload_ + writer->num_bytes_;
+    while (half_gap >= 0x80) {
+      *next++ = (half_gap & 0x7F) | 0x80;
+      half_gap >>= 7;
+    }
+    *next++ = half_gap;
+    writer->num_bytes_ = next - writer->payload_;
+  }
+  writer->num_primes_++;
+  writer->last_prime_ = prime;
+}
+
+void PrimeArchiveWriterClose(PrimeArchiveWriter* writer) {
+  WriteBlock(writer);
+  uint64_t index_offset = ftell(writer->file_);
+  unsigned char entry[INDEX_ENTRY_BYTES];
+  long i;
+  for (i = 0; i < writer->num_blocks_; i++) {
+    const PrimeArchiveBlock* block = &writer->blocks_[i];
+    StoreLittleEndian(block->anchor, 8, entry);
+    StoreLittleEndian(block->offset, 8, entry + 8);
+    StoreLittleEndian(block->num_primes, 4, entry + 16);
+    StoreLittleEndian(block->num_bytes, 4, entry + 20);
+    if (fwrite(entry, 1, INDEX_ENTRY_BYTES, writer->file_) !=
+        INDEX_ENTRY_BYTES) {
+      ErrorOut("Unable to write the archive index.");
+    }
+  }
+  unsigned char trailer[TRAILER_BYTES];
+  StoreLittleEndian(index_offset, 8, trailer);
+  StoreLittleEndian(writer->num_blocks_, 4, trailer + 8);
+  memcpy(trailer + 12, kTrailerMagic, sizeof(kTrailerMagic));
+  if (fwrite(trailer, 1, TRAILER_BYTES, writer->file_) != TRAILER_BYTES ||
+      fclose(writer->file_) != 0) {
+    ErrorOut("Unable to finish the prime archive.");
+  }
+  free(writer->blocks_);
+  free(writer->payload_);
+  writer->blocks_ = NULL;
+  writer->payload_ = NULL;
+}
+
+void PrimeArchiveOpen(char* filename, PrimeArchive* archive) {
+  archive->file_ = fopen(filename, "rb");
+  if (archive->file_ == NULL) {
+    ErrorOut("Unable to open the prime archive.");
+  }
+  archive->blocks_ = NULL;
+  long capacity = 0;
+  LoadBlocks(archive->file_, &archive->blocks_, &archive->num_blocks_,
+             &capacity);
+}
+
+long PrimeArchiveNumBlocks(const PrimeArchive* archive) {
+  return archive->num_blocks_;
+}
+
+const PrimeArchiveBlock* PrimeArchiveGetBlock(long block,
+                                              const PrimeArchive* archive) {
+  if (block < 0 || block >= archive->num_blocks_) {
+    ErrorOut("No such block in the prime archive.");
+  }
+  return &archive->blocks_[block];
+}
+
+uint32_t PrimeArchiveReadBlock(long block, const PrimeArchive* archive,
+                               uint64_t* primes) {
+  return ReadBlock(archive->file_, PrimeArchiveGetBlock(block, archive),
+                   primes);
+}
+
+void PrimeArchiveClose(PrimeArchive* archive) {
+  fclose(archive->file_);
+  free(archive->blocks_);
+  archive->blocks_ = NULL;
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PRIME_ARCHIVE_H
+#define PRIME_ARCHIVE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// A compact archive of consecutive 64 bit primes. Primes are grouped into
+// blocks. Each block stores its first prime, the anchor, in full and every
+// later prime as half the gap from the one before, written as a varint: 7
+// bits to a byte, low bits first, with the top bit set on all but the last
+// byte. The one odd gap, from 2 to 3, is written as 0. Most gaps below 2^64
+// take a single byte.
+//
+// The file starts with 0x89, "PGA" and the version as 32 bits. Each block
+// has a 16 byte header: the anchor as 64 bits and the number of primes and
+// of payload bytes as 32 bits each. An index of every block follows the
+// last one, then a trailer with the offset of the index as 64 bits, the
+// number of blocks as 32 bits and "PGAX". All numbers are little endian.
+// The index lets any block be found and decoded on its own. If the writer
+// was killed before writing it, the blocks are scanned instead, and a block
+// that was cut short is dropped.
+
+#define PRIME_ARCHIVE_VERSION 1
+
+// Blocks hold this many primes, apart from the last block of each run of the
+// writer.
+#define PRIME_ARCHIVE_BLOCK_PRIMES 65536
+
+typedef struct {
+  uint64_t anchor;
+  uint64_t offset;
+  uint32_t num_primes;
+  uint32_t num_bytes;
+} PrimeArchiveBlock;
+
+typedef struct {
+  FILE* file_;
+  PrimeArchiveBlock* blocks_;
+  long num_blocks_;
+  long capacity_;
+  // The last prime written, or 0 if there is none.
+  uint64_t last_prime_;
+  // The block being collected.
+  uint64_t anchor_;
+  uint32_t num_primes_;
+  unsigned char* payload_;
+  uint32_t num_bytes_;
+} PrimeArchiveWriter;
+
+typedef struct {
+  FILE* file_;
+  PrimeArchiveBlock* blocks_;
+  long num_blocks_;
+} PrimeArchive;
+
+// Opens the archive to add primes after the ones it holds, creating it if
+// needed.
+void PrimeArchiveWriterOpen(char* filename, PrimeArchiveWriter* writer);
+
+// Returns the highest prime in the archive, or 0 if it is empty.
+uint64_t PrimeArchiveWriterLastPrime(const PrimeArchiveWriter* writer);
+
+// Adds a prime, which must be the next prime after the last one written.
+void PrimeArchiveWrite(uint64_t prime, PrimeArchiveWriter* writer);
+
+// Writes out the last block and the index, then closes the file.
+void PrimeArchiveWriterClose(PrimeArchiveWriter* writer);
+
+// Opens an archive for reading.
+void PrimeArchiveOpen(char* filename, PrimeArchive* archive);
+
+long PrimeArchiveNumBlocks(const PrimeArchive* archive);
+
+// Describes one block, so callers can size its buffer or skip to the block
+// holding a value.
+const PrimeArchiveBlock* PrimeArchiveGetBlock(long block,
+                                              const PrimeArchive* archive);
+
+// Decodes the primes of one block into primes, which must have room for the
+// block's num_primes, and returns how many there are. Blocks may be decoded
+// on several threads at once.
+uint32_t PrimeArchiveReadBlock(long block, const PrimeArchive* archive,
+                               uint64_t* primes);
+
+void PrimeArchiveClose(PrimeArchive* archive);
+
+#endif
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "prime-certificate.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void Check(int condition, char* message) {
+  if (!condition) {
+    fprintf(stderr, "Condition failed: %s\n", message);
+    exit(1);
+  }
+}
+
+// 4294967291, the largest prime below 2^32.
+#define Q "0400_FBFFFFFF"
+// 8589934583 = 2 * Q + 1, with Q > sqrt(8589934583).
+#define N "0500_F7FFFFFF01"
+// 2 * m * N + 1, with N^2 <= M <= N^3.
+#define M "0900_95FFFFFF0500000004"
+// (30 * N + 1) * (42 * N + 1), for which N passes every check but the last.
+#define C "0A00_258C0100604FFFFFAF13"
+
+void TestSmallPrimes() {
+  PrimeCertificate certificate = {0};
+  Check(PrimeCertificateCheckLine("0100_02\n", &certificate),
+        "2 should be prime");
+  Check(PrimeCertificateCheckLine("0100_07 # 7\n", &certificate),
+        "7 should be prime");
+  Check(PrimeCertificateCheckLine(Q, &certificate),
+        "4294967291 should be prime");
+  Check(!PrimeCertificateCheckLine("0100_01", &certificate),
+        "1 should not be prime");
+  Check(!PrimeCertificateCheckLine("0100_09", &certificate),
+        "9 should not be prime");
+  Check(!PrimeCertificateCheckLine(N, &certificate),
+        "Primes past 2^32 need their factors");
+  Check(PrimeCertificateCheckLine("# Just a comment\n", &certificate) &&
+        PrimeCertificateCheckLine("\n", &certificate),
+        "Blank lines should be allowed");
+  Check(certificate.num_primes == 3, "Each prime should be kept");
+  PrimeCertificateFree(&certificate);
+}
+
+void TestPocklington() {
+  PrimeCertificate certificate = {0};
+  Check(PrimeCertificateCheckLine(N " 0100_05 0100_02 " Q, &certificate),
+        "2 * Q + 1 should be proven from 2 and Q");
+  Check(!PrimeCertificateCheckLine(N " 0100_01 0100_02 " Q, &certificate),
+        "1 should not be a witness");
+  Check(!PrimeCertificateCheckLine(N " 0100_05 0100_03 " Q, &certificate),
+        "Every factor should divide n - 1");
+  Check(!PrimeCertificateCheckLine(N " 0100_05", &certificate),
+        "A base without factors should prove nothing");
+  Check(!PrimeCertificateCheckLine(N " 0100_05 0100_02", &certificate),
+        "F = 2 should be too small");
+  Check(certificate.num_primes == 1, "Only the proven prime should be kept");
+  PrimeCertificateFree(&certificate);
+}
+
+void TestBrillhartLehmerSelfridge() {
+  PrimeCertificate certificate = {0};
+  Check(!PrimeCertificateCheckLine(M " 0100_02 " N, &certificate),
+        "Factors should be proven first");
+  Check(PrimeCertificateCheckLine(N " 0100_05 0100_02 " Q, &certificate),
+        "2 * Q + 1 should be proven");
+  Check(PrimeCertificateCheckLine(M " 0100_02 " N, &certificate),
+        "M should be proven from N alone, though N < sqrt(M)");
+  Check(!PrimeCertificateCheckLine(C " 0A00_EE01BF9F2B450E80EB0C " N,
+                                   &certificate),
+        "A product of two primes that are 1 mod N should not be proven");
+  PrimeCertificateFree(&certificate);
+}
+
+void TestFile() {
+  PrimeCertificate certificate = {0};
+  LargeUInt prime = {0};
+  LargeUInt expected = {0};
+  int bad_line = -1;
+  FILE* file = tmpfile();
+  Check(file != NULL, "Temporary file should open");
+  Check(!PrimeCertificateCheckFile(file, &certificate, &bad_line, &prime) &&
+        bad_line == 0, "An empty certificate should prove nothing");
+
+  fprintf(file, "# Primality certificate\n");
+  fprintf(file, "%s\n", Q);
+  fprintf(file, "%s 0100_05 0100_02 %s\n", N, Q);
+  fprintf(file, "%s 0100_02 %s\n", M, N);
+  rewind(file);
+  Check(PrimeCertificateCheckFile(file, &certificate, &bad_line, &prime),
+        "The certificate should check");
+  LargeUIntLoad(strlen(M), M, &expected);
+  Check(LargeUIntEqual(&prime, &expected), "The last prime should be proven");
+  PrimeCertificateFree(&certificate);
+
+  fprintf(file, "%s 0100_02 %s\n", C, N);
+  rewind(file);
+  Check(!PrimeCertificateCheckFile(file, &certificate, &bad_line, &prime) &&
+        bad_line == 5, "The bad line should be found");
+  fclose(file);
+  PrimeCertificateFree(&certificate);
+  LargeUIntFree(&prime);
+  LargeUIntFree(&expected);
+}
+
+int main(void) {
+  TestSmallPrimes();
+  TestPocklington();
+  TestBrillhartLehmerSelfridge();
+  TestFile();
+  printf("All tests passed\n");
+}
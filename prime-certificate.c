@@ -0,0 +1,300 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "prime-certificate.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void ErrorOut(char* message) {
+  fprintf(stderr, "%s\n", message);
+  exit(1);
+}
+
+// Returns 1 if the value is a prime below 2^32, by trial division.
+static int IsSmallPrime(const LargeUInt* value) {
+  if (LargeUIntNumBytes(value) > 4) {
+    return 0;
+  }
+  uint64_t word = LargeUIntGetWord(value);
+  if (word < 4) {
+    return word >= 2;
+  }
+  if (word % 2 == 0) {
+    return 0;
+  }
+  uint64_t divisor;
+  for (divisor = 3; divisor * divisor <= word; divisor += 2) {
+    if (word % divisor == 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// Returns 1 if the value is a small prime or one already proven.
+static int IsProven(const LargeUInt* value,
+                    const PrimeCertificate* certificate) {
+  if (LargeUIntNumBytes(value) <= 4) {
+    return IsSmallPrime(value);
+  }
+  int i;
+  for (i = 0; i < certificate->num_primes; i++) {
+    if (LargeUIntEqual(value, &certificate->primes[i])) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// Stores base^exponent mod the context's modulus in result, working left to
+// right over the bits of the exponent.
+static void PowMod(const LargeUInt* base, const LargeUInt* exponent,
+                   const LargeUIntMontCtx* ctx, LargeUInt* result) {
+  LargeUInt base_mont = {0};
+  LargeUInt power = {0};
+  LargeUIntToMont(base, ctx, &base_mont);
+  LargeUIntSetWord(1, &power);
+  LargeUIntToMont(&power, ctx, &power);
+  int i;
+  for (i = LargeUIntNumBytes(exponent) - 1; i >= 0; i--) {
+    int byte = LargeUIntGetByte(i, exponent);
+    int bit;
+    for (bit = 7; bit >= 0; bit--) {
+      LargeUIntMontSqr(&power, ctx, &power);
+      if (byte >> bit & 1) {
+        LargeUIntMontMul(&power, &base_mont, ctx, &power);
+      }
+    }
+  }
+  LargeUIntFromMont(&power, ctx, result);
+  LargeUIntFree(&base_mont);
+  LargeUIntFree(&power);
+}
+
+// Returns 1 if n, with base a and the proven prime factors of n - 1 in
+// factors, passes the Pocklington and Brillhart, Lehmer and Selfridge checks.
+static int CheckFactored(const LargeUInt* n, const LargeUInt* a,
+                         int num_factors, const LargeUInt* factors) {
+  if (LargeUIntNumBytes(n) == 0 || LargeUIntGetByte(0, n) % 2 == 0) {
+    return 0;
+  }
+  LargeUInt n_minus_1 = {0};
+  LargeUInt rest = {0};
+  LargeUInt f = {0};
+  LargeUInt quotient = {0};
+  LargeUInt remainder = {0};
+  LargeUInt power = {0};
+  LargeUInt one = {0};
+  LargeUIntMontCtx ctx = {0};
+  LargeUIntClone(n, &n_minus_1);
+  LargeUIntDecrement(&n_minus_1);
+  LargeUIntClone(&n_minus_1, &rest);
+  LargeUIntSetWord(1, &f);
+  LargeUIntSetWord(1, &one);
+  LargeUIntMontInit(n, &ctx);
+
+  // a^(n - 1) = 1 mod n.
+  PowMod(a, &n_minus_1, &ctx, &power);
+  int valid = LargeUIntEqual(&power, &one);
+  int i;
+  for (i = 0; i < num_factors && valid; i++) {
+    const LargeUInt* q = &factors[i];
+    LargeUIntMod(&n_minus_1, q, &remainder);
+    valid = LargeUIntLessThan(&one, q) && LargeUIntNumBytes(&remainder) == 0;
+    if (!valid) {
+      break;
+    }
+    // Take every power of q in n - 1 into F.
+    LargeUIntDivide(&rest, q, &quotient, &remainder);
+    while (LargeUIntNumBytes(&remainder) == 0) {
+      LargeUIntClone(&quotient, &rest);
+      LargeUIntMultiply(q, &f);
+      LargeUIntDivide(&rest, q, &quotient, &remainder);
+    }
+    // gcd(a^((n - 1) / q) - 1, n) = 1.
+    LargeUIntDivide(&n_minus_1, q, &quotient, &remainder);
+    PowMod(a, &quotient, &ctx, &power);
+    valid = LargeUIntNumBytes(&power) != 0;
+    if (valid) {
+      LargeUIntDecrement(&power);
+      LargeUIntGcd(&power, n, &power);
+      valid = LargeUIntEqual(&power, &one);
+    }
+  }
+
+  if (valid) {
+    // Every prime factor of n is 1 mod F, so with F^2 > n, n has just the
+    // one.
+    LargeUInt f_power = {0};
+    LargeUIntMultiplyFull(&f, &f, &f_power);
+    if (!LargeUIntLessThan(n, &f_power)) {
+      LargeUIntMultiply(&f, &f_power);
+      valid = !LargeUIntLessThan(&f_power, n);
+      if (valid) {
+        // With F^3 >= n, a composite n is (x * F + 1) * (y * F + 1) for some
+        // x and y, which are c1 = x + y and c2 = x * y.
+        LargeUInt c1 = {0};
+        LargeUInt c2 = {0};
+        LargeUInt four = {0};
+        LargeUIntDivide(&n_minus_1, &f, &quotient, &remainder);
+        LargeUIntDivide(&quotient, &f, &c2, &c1);
+        LargeUIntSetWord(4, &four);
+        LargeUIntMultiply(&four, &c2);
+        LargeUIntMultiplyFull(&c1, &c1, &c1);
+        if (!LargeUIntLessThan(&c1, &c2)) {
+          LargeUIntSub(&c2, &c1);
+          valid = !LargeUIntSqrt(&c1, &c2);
+        }
+        LargeUIntFree(&c1);
+        LargeUIntFree(&c2);
+        LargeUIntFree(&four);
+      }
+    }
+    LargeUIntFree(&f_power);
+  }
+  LargeUIntFree(&n_minus_1);
+  LargeUIntFree(&rest);
+  LargeUIntFree(&f);
+  LargeUIntFree(&quotient);
+  LargeUIntFree(&remainder);
+  LargeUIntFree(&power);
+  LargeUIntFree(&one);
+  LargeUIntMontFree(&ctx);
+  return valid;
+}
+
+// Appends a proven prime to the certificate.
+static void AddPrime(const LargeUInt* prime, PrimeCertificate* certificate) {
+  if (certificate->num_primes == certificate->max_primes_) {
+    // LargeUInts may point into themselves, so they are cloned into the
+    // bigger array rather than moved by realloc.
+    int max_primes = certificate->max_primes_ == 0
+                         ? 16
+                         : 2 * certificate->max_primes_;
+    LargeUInt* primes = calloc(max_primes, sizeof(LargeUInt));
+    if (primes == NULL) {
+      ErrorOut("Unable to allocate space for the certificate.");
+    }
+    int i;
+    for (i = 0; i < certificate->num_primes; i++) {
+      LargeUIntClone(&certificate->primes[i], &primes[i]);
+      LargeUIntFree(&certificate->primes[i]);
+    }
+    free(certificate->primes);
+    certificate->primes = primes;
+    certificate->max_primes_ = max_primes;
+  }
+  LargeUIntClone(prime, &certificate->primes[certificate->num_primes++]);
+}
+
+int PrimeCertificateCheckLine(const char* line,
+                              PrimeCertificate* certificate) {
+  char* text = strdup(line);
+  if (text == NULL) {
+    ErrorOut("Unable to allocate space for a certificate line.");
+  }
+  char* comment = strchr(text, '#');
+  if (comment != NULL) {
+    *comment = '\0';
+  }
+  // Each value is one word of the line.
+  const char* separators = " \t\r\n";
+  int num_values = 0;
+  char* word;
+  char* state;
+  char* counted = strdup(text);
+  if (counted == NULL) {
+    ErrorOut("Unable to allocate space for a certificate line.");
+  }
+  for (word = strtok_r(counted, separators, &state); word != NULL;
+       word = strtok_r(NULL, separators, &state)) {
+    num_values++;
+  }
+  free(counted);
+  if (num_values == 0) {
+    free(text);
+    return 1;
+  }
+
+  LargeUInt* values = calloc(num_values, sizeof(LargeUInt));
+  if (values == NULL) {
+    ErrorOut("Unable to allocate space for a certificate line.");
+  }
+  int i = 0;
+  for (word = strtok_r(text, separators, &state); word != NULL;
+       word = strtok_r(NULL, separators, &state)) {
+    LargeUIntLoad(strlen(word), word, &values[i]);
+    LargeUIntTrim(&values[i]);
+    i++;
+  }
+  int valid;
+  if (num_values == 1) {
+    valid = IsSmallPrime(&values[0]);
+  } else {
+    valid = num_values > 2;
+    for (i = 2; i < num_values && valid; i++) {
+      valid = IsProven(&values[i], certificate);
+    }
+    valid = valid &&
+            CheckFactored(&values[0], &values[1], num_values - 2, values + 2);
+  }
+  if (valid) {
+    AddPrime(&values[0], certificate);
+  }
+  for (i = 0; i < num_values; i++) {
+    LargeUIntFree(&values[i]);
+  }
+  free(values);
+  free(text);
+  return valid;
+}
+
+int PrimeCertificateCheckFile(FILE* in, PrimeCertificate* certificate,
+                              int* bad_line, LargeUInt* prime) {
+  char* line = NULL;
+  size_t size = 0;
+  int line_number = 0;
+  int valid = 1;
+  while (valid && getline(&line, &size, in) != -1) {
+    line_number++;
+    valid = PrimeCertificateCheckLine(line, certificate);
+  }
+  free(line);
+  if (!valid) {
+    *bad_line = line_number;
+    return 0;
+  }
+  if (certificate->num_primes == 0) {
+    *bad_line = 0;
+    return 0;
+  }
+  LargeUIntClone(&certificate->primes[certificate->num_primes - 1], prime);
+  return 1;
+}
+
+void PrimeCertificateFree(PrimeCertificate* certificate) {
+  int i;
+  for (i = 0; i < certificate->num_primes; i++) {
+    LargeUIntFree(&certificate->primes[i]);
+  }
+  free(certificate->primes);
+  certificate->primes = NULL;
+  certificate->num_primes = 0;
+  certificate->max_primes_ = 0;
+}
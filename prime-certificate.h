@@ -0,0 +1,62 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PRIME_CERTIFICATE_H
+#define PRIME_CERTIFICATE_H
+
+#include "large-u-int.h"
+
+#include <stdio.h>
+
+// A primality certificate proves a prime from smaller ones. Each line holds
+// values in the LargeUInt text format, and anything after a # is a comment.
+// A line with a single value below 2^32 is checked by trial division. Any
+// other line is
+//
+//   n a q1 q2 ...
+//
+// where each q is below 2^32 or the prime of an earlier line, each divides
+// n - 1, and together, raised to their full powers in n - 1, they make up F.
+// a^(n - 1) = 1 mod n and gcd(a^((n - 1) / q) - 1, n) = 1 for each q show
+// that every prime factor of n is 1 mod F (Pocklington). n is then prime if
+// F^2 > n. Otherwise F^3 >= n, and writing n = c2 * F^2 + c1 * F + 1, n is
+// prime if c1^2 - 4 * c2 is not a square (Brillhart, Lehmer and Selfridge).
+// The last line's prime is the one the certificate proves.
+
+typedef struct {
+  // The primes proven so far, one for each line.
+  int num_primes;
+  LargeUInt* primes;
+  int max_primes_;
+} PrimeCertificate;
+
+// Checks one line of a certificate against the lines before it, adding its
+// prime to the certificate. Returns 1 if the line proves its prime, and 0
+// otherwise, when the certificate is left as it was. Blank and comment only
+// lines return 1 and add nothing.
+int PrimeCertificateCheckLine(const char* line, PrimeCertificate* certificate);
+
+// Checks every line of a certificate. Returns 0 and stores the number of the
+// first line that fails in bad_line, counting from 1, if any does, or 0 if
+// the certificate has no lines. Otherwise returns 1 with the prime proven by
+// the last line in prime.
+int PrimeCertificateCheckFile(FILE* in, PrimeCertificate* certificate,
+                              int* bad_line, LargeUInt* prime);
+
+// Releases the primes held by the certificate.
+void PrimeCertificateFree(PrimeCertificate* certificate);
+
+#endif
@@ -0,0 +1,169 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "large-u-int.h"
+#include "prime-archive.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+void PrintPrime(LargeUInt* prime, FILE* out) {
+  LargeUIntPrint(prime, out);
+  fprintf(out, " # int value: ");
+  LargeUIntBase10Print(prime, out);
+  fprintf(out, "\n");
+}
+
+// Copies every value from input to output, writing the binary format if
+// to_binary is set and the text format otherwise. Either format is read.
+// Returns the number of values copied.
+long ConvertPrimes(FILE* input, FILE* output, int to_binary) {
+  LargeUInt prime = {0};
+  LargeUIntBinaryReader reader;
+  LargeUIntBinaryWriter writer;
+  long num_primes = 0;
+  LargeUIntBinaryReaderInit(input, &reader);
+  if (to_binary) {
+    LargeUIntBinaryWriterInit(output, &writer);
+  }
+  LargeUIntBinaryRead(&reader, &prime);
+  while (LargeUIntNumBytes(&prime) != 0) {
+    if (to_binary) {
+      LargeUIntBinaryWrite(&prime, &writer);
+    } else {
+      PrintPrime(&prime, output);
+    }
+    num_primes++;
+    LargeUIntBinaryRead(&reader, &prime);
+  }
+  LargeUIntBinaryReaderClose(&reader);
+  if (to_binary) {
+    LargeUIntBinaryWriterClose(&writer);
+  }
+  LargeUIntFree(&prime);
+  return num_primes;
+}
+
+// Adds every value from input, in either format, to a new gap encoded
+// archive. Returns the number of values copied.
+long ArchivePrimes(FILE* input, char* archive_name) {
+  LargeUInt prime = {0};
+  LargeUIntBinaryReader reader;
+  PrimeArchiveWriter writer;
+  long num_primes = 0;
+  LargeUIntBinaryReaderInit(input, &reader);
+  remove(archive_name);
+  PrimeArchiveWriterOpen(archive_name, &writer);
+  LargeUIntBinaryRead(&reader, &prime);
+  while (LargeUIntNumBytes(&prime) != 0) {
+    if (LargeUIntNumBytes(&prime) > 8) {
+      printf("Archives only hold primes that fit in 64 bits.\n");
+      exit(1);
+    }
+    PrimeArchiveWrite(LargeUIntGetWord(&prime), &writer);
+    num_primes++;
+    LargeUIntBinaryRead(&reader, &prime);
+  }
+  LargeUIntBinaryReaderClose(&reader);
+  PrimeArchiveWriterClose(&writer);
+  LargeUIntFree(&prime);
+  return num_primes;
+}
+
+// Writes every prime in the archive to output in the text format. Returns the
+// number of values copied.
+long UnarchivePrimes(char* archive_name, FILE* output) {
+  PrimeArchive archive;
+  LargeUInt prime = {0};
+  long num_primes = 0;
+  PrimeArchiveOpen(archive_name, &archive);
+  long block;
+  for (block = 0; block < PrimeArchiveNumBlocks(&archive); block++) {
+    uint64_t* primes = malloc(
+        PrimeArchiveGetBlock(block, &archive)->num_primes * sizeof(uint64_t));
+    if (primes == NULL) {
+      printf("Unable to allocate space for an archive block.\n");
+      exit(1);
+    }
+    uint32_t count = PrimeArchiveReadBlock(block, &archive, primes);
+    uint32_t i;
+    for (i = 0; i < count; i++) {
+      LargeUIntSetWord(primes[i], &prime);
+      PrintPrime(&prime, output);
+    }
+    num_primes += count;
+    free(primes);
+  }
+  PrimeArchiveClose(&archive);
+  LargeUIntFree(&prime);
+  return num_primes;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 4 || (strcmp(argv[1], "--to-binary") != 0 &&
+                    strcmp(argv[1], "--to-text") != 0 &&
+                    strcmp(argv[1], "--to-archive") != 0 &&
+                    strcmp(argv[1], "--from-archive") != 0)) {
+    printf("Usage: %s --to-binary|--to-text|--to-archive|--from-archive"
+           " <input> <output>\n", argv[0]);
+    printf("For example %s --to-binary primes primes.bin\n", argv[0]);
+    printf("--from-archive writes the text format.\n");
+    return 1;
+  }
+  long num_primes;
+  if (strcmp(argv[1], "--from-archive") == 0) {
+    FILE* output = fopen(argv[3], "wb");
+    if (output == NULL) {
+      printf("Unable to open %s\n", argv[3]);
+      return 1;
+    }
+    num_primes = UnarchivePrimes(argv[2], output);
+    if (fclose(output) != 0) {
+      printf("Unable to finish writing %s\n", argv[3]);
+      return 1;
+    }
+    printf("Converted %ld primes.\n", num_primes);
+    return 0;
+  }
+
+  FILE* input = fopen(argv[2], "rb");
+  if (input == NULL) {
+    printf("Unable to open %s\n", argv[2]);
+    return 1;
+  }
+  if (strcmp(argv[1], "--to-archive") == 0) {
+    num_primes = ArchivePrimes(input, argv[3]);
+    fclose(input);
+    printf("Converted %ld primes.\n", num_primes);
+    return 0;
+  }
+  FILE* output = fopen(argv[3], "wb");
+  if (output == NULL) {
+    printf("Unable to open %s\n", argv[3]);
+    return 1;
+  }
+  num_primes =
+      ConvertPrimes(input, output, strcmp(argv[1], "--to-binary") == 0);
+  fclose(input);
+  if (fclose(output) != 0) {
+    printf("Unable to finish writing %s\n", argv[3]);
+    return 1;
+  }
+  printf("Converted %ld primes.\n", num_primes);
+  return 0;
+}
@@ -0,0 +1,222 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "primes-file.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+void Check(int condition, char* message) {
+  if (!condition) {
+    fprintf(stderr, "Condition failed: %s\n", message);
+    exit(1);
+  }
+}
+
+// Writes contents to a new temporary file and returns its name.
+char* WriteTempFile(const char* contents, size_t size) {
+  static char filename[32];
+  strcpy(filename, "/tmp/primes-file-testXXXXXX");
+  int fd = mkstemp(filename);
+  Check(fd >= 0, "Temporary file should open");
+  Check(write(fd, contents, size) == size, "Temporary file should be written");
+  close(fd);
+  return filename;
+}
+
+long FileSize(char* filename) {
+  FILE* file = fopen(filename, "rb");
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fclose(file);
+  return size;
+}
+
+void TestLastLine() {
+  char* contents = "0100_02 # int value: 2\n0100_03 # int value: 3\n";
+  char* filename = WriteTempFile(contents, strlen(contents));
+  char* line = ReadLastPrimeLine(filename, 0);
+  Check(line != NULL && strcmp(line, "0100_03 # int value: 3") == 0,
+        "Last line should be found");
+  Check(FileSize(filename) == strlen(contents),
+        "A file ending in a whole line should be left alone");
+  free(line);
+  unlink(filename);
+
+  filename = WriteTempFile("", 0);
+  Check(ReadLastPrimeLine(filename, 0) == NULL,
+        "Empty file has no last line");
+  unlink(filename);
+
+  Check(ReadLastPrimeLine("/tmp/primes-file-test-missing", 0) == NULL,
+        "Missing file has no last line");
+}
+
+void TestTornLine() {
+  char* contents = "0100_02 # int value: 2\n0100_03 # int val";
+  char* filename = WriteTempFile(contents, strlen(contents));
+  char* line = ReadLastPrimeLine(filename, 0);
+  Check(line != NULL && strcmp(line, "0100_02 # int value: 2") == 0,
+        "Line before a torn line should be found");
+  Check(FileSize(filename) == strlen("0100_02 # int value: 2\n"),
+        "Torn line should be removed");
+  free(line);
+  unlink(filename);
+
+  filename = WriteTempFile("0100_0", 6);
+  Check(ReadLastPrimeLine(filename, 0) == NULL, "Only a torn line is no line");
+  Check(FileSize(filename) == 0, "Lone torn line should be removed");
+  unlink(filename);
+}
+
+void TestLongLines() {
+  // Lines longer than the first read from the end, followed by a comment.
+  size_t line_size = 10000;
+  char* contents = malloc(3 * line_size + 100);
+  size_t size = 0;
+  int i;
+  for (i = 0; i < 2; i++) {
+    memset(contents + size, '0' + i, line_size);
+    contents[size + 1] = '_';
+    size += line_size;
+    contents[size++] = '\n';
+  }
+  strcpy(contents + size, "# a comment\n\n");
+  size += strlen("# a comment\n\n");
+  char* filename = WriteTempFile(contents, size);
+  char* line = ReadLastPrimeLine(filename, 0);
+  Check(line != NULL && strlen(line) == line_size && line[0] == '1',
+        "Long last line should be found whole");
+  free(line);
+  free(contents);
+  unlink(filename);
+}
+
+void TestAfterBinary() {
+  // Stands in for binary blocks, which may hold any byte, newlines and
+  // underscores included.
+  char binary[] = "\x89" "LPF_\n\x89" "B_\n";
+  long text_start = sizeof(binary) - 1;
+  char contents[100];
+  strcpy(contents, binary);
+  strcat(contents, "0100_03 # int value: 3\n0400_D");
+  char* filename = WriteTempFile(contents, strlen(contents));
+  char* line = ReadLastPrimeLine(filename, text_start);
+  Check(line != NULL && strcmp(line, "0100_03 # int value: 3") == 0,
+        "Last line after binary blocks should be found");
+  Check(FileSize(filename) == text_start + strlen("0100_03 # int value: 3\n"),
+        "Torn line after binary blocks should be removed");
+  free(line);
+  unlink(filename);
+
+  // With only a torn line after them the blocks are left whole.
+  strcpy(contents, binary);
+  strcat(contents, "0400_D");
+  filename = WriteTempFile(contents, strlen(contents));
+  Check(ReadLastPrimeLine(filename, text_start) == NULL,
+        "Binary blocks hold no text line");
+  Check(FileSize(filename) == text_start,
+        "Only the torn line should be removed");
+  unlink(filename);
+}
+
+// Writes the values to a new binary file, followed by text, and returns its
+// name.
+char* WriteBinaryFile(const uint64_t* values, int count, const char* text) {
+  char* filename = WriteTempFile("", 0);
+  FILE* file = fopen(filename, "wb");
+  LargeUIntBinaryWriter writer;
+  LargeUInt value = {0};
+  LargeUIntBinaryWriterInit(file, &writer);
+  int i;
+  for (i = 0; i < count; i++) {
+    LargeUIntSetWord(values[i], &value);
+    LargeUIntBinaryWrite(&value, &writer);
+  }
+  LargeUIntBinaryWriterClose(&writer);
+  fputs(text, file);
+  fclose(file);
+  LargeUIntFree(&value);
+  return filename;
+}
+
+// Returns 1 if every value in the file reads back in order, checksums
+// included, and there are count of them.
+int ReadsBack(char* filename, const uint64_t* values, int count) {
+  FILE* file = fopen(filename, "rb");
+  LargeUIntBinaryReader reader;
+  LargeUInt value = {0};
+  int matches = 1;
+  int i;
+  LargeUIntBinaryReaderInit(file, &reader);
+  for (i = 0; i < count; i++) {
+    LargeUIntBinaryRead(&reader, &value);
+    matches = matches && LargeUIntGetWord(&value) == values[i];
+  }
+  LargeUIntBinaryRead(&reader, &value);
+  matches = matches && LargeUIntNumBytes(&value) == 0;
+  LargeUIntBinaryReaderClose(&reader);
+  fclose(file);
+  LargeUIntFree(&value);
+  return matches;
+}
+
+void TestHighestPrime() {
+  LargeUInt prime = {0};
+  char* contents = "0100_02 # int value: 2\n0100_03 # int val";
+  char* filename = WriteTempFile(contents, strlen(contents));
+  ReadHighestPrime(filename, &prime);
+  Check(LargeUIntGetWord(&prime) == 2, "Text file should give its last prime");
+  unlink(filename);
+
+  ReadHighestPrime("/tmp/primes-file-test-missing", &prime);
+  Check(LargeUIntNumBytes(&prime) == 0, "Missing file has no highest prime");
+
+  // The values hold newline bytes, which must not be taken for line ends.
+  uint64_t values[] = {3, 5, 7, 11, 0x0B0A, 0x0B0A0A, 0x0B0A0A0A0AULL};
+  int count = sizeof(values) / sizeof(values[0]);
+  filename = WriteBinaryFile(values, count, "");
+  long size = FileSize(filename);
+  ReadHighestPrime(filename, &prime);
+  Check(LargeUIntGetWord(&prime) == 0x0B0A0A0A0AULL,
+        "Binary file should give its last value");
+  Check(FileSize(filename) == size && ReadsBack(filename, values, count),
+        "Binary file should be left whole");
+
+  // Resuming appends text, which is then read from the end.
+  FILE* file = fopen(filename, "ab");
+  fputs("0500_0D0A0A0A0B # int value: 47413070349\n0500_1", file);
+  fclose(file);
+  ReadHighestPrime(filename, &prime);
+  Check(LargeUIntGetWord(&prime) == 0x0B0A0A0A0DULL,
+        "Text after binary blocks should give the highest prime");
+  uint64_t resumed[] = {3, 5, 7, 11, 0x0B0A, 0x0B0A0A, 0x0B0A0A0A0AULL,
+                        0x0B0A0A0A0DULL};
+  Check(ReadsBack(filename, resumed, count + 1),
+        "Only the torn line after the binary blocks should be removed");
+  unlink(filename);
+  LargeUIntFree(&prime);
+}
+
+int main() {
+  TestLastLine();
+  TestTornLine();
+  TestLongLines();
+  TestAfterBinary();
+  TestHighestPrime();
+  printf("All tests passed\n");
+}
@@ -0,0 +1,130 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "primes-file.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// The end of the file is first read this many bytes at a time, doubling
+// until a whole line is in view.
+#define TAIL_BYTES 4096
+
+// Exits the program after sending the message to stderr.
+static void ErrorOut(char* message) {
+  fprintf(stderr, "%s\n", message);
+  exit(1);
+}
+
+char* ReadLastPrimeLine(char* filename, long text_start) {
+  FILE* primes = fopen(filename, "rb");
+  if (primes == NULL) {
+    return NULL;
+  }
+  if (fseek(primes, 0, SEEK_END) != 0) {
+    ErrorOut("Unable to seek in the primes file.");
+  }
+  long size = ftell(primes);
+  if (text_start > size) {
+    ErrorOut("The primes file ends before its text starts.");
+  }
+
+  char* buffer = NULL;
+  char* line = NULL;
+  // The length of the file up to the end of its last complete line.
+  long complete_size = 0;
+  long window = TAIL_BYTES;
+  while (1) {
+    long start = size - text_start > window ? size - window : text_start;
+    buffer = realloc(buffer, size - start + 1);
+    if (buffer == NULL) {
+      ErrorOut("Unable to allocate space for the end of the primes file.");
+    }
+    if (fseek(primes, start, SEEK_SET) != 0 ||
+        fread(buffer, 1, size - start, primes) != size - start) {
+      ErrorOut("Unable to read the end of the primes file.");
+    }
+
+    // Skip back over any partial line at the end.
+    long line_end = size - start;
+    while (line_end > 0 && buffer[line_end - 1] != '\n') {
+      line_end--;
+    }
+    if (line_end == 0 && start > text_start) {
+      window *= 2;
+      continue;
+    }
+    complete_size = start + line_end;
+
+    // Walk back over whole lines to the last one with a value in it.
+    while (line_end > 0) {
+      long line_start = line_end - 1;
+      while (line_start > 0 && buffer[line_start - 1] != '\n') {
+        line_start--;
+      }
+      if (line_start == 0 && start > text_start) {
+        // The line may begin before the part that was read.
+        break;
+      }
+      if (memchr(buffer + line_start, '_', line_end - line_start) != NULL) {
+        line = malloc(line_end - line_start);
+        if (line == NULL) {
+          ErrorOut("Unable to allocate space for the last prime.");
+        }
+        memcpy(line, buffer + line_start, line_end - line_start - 1);
+        line[line_end - line_start - 1] = '\0';
+        break;
+      }
+      line_end = line_start;
+    }
+    if (line != NULL || start == text_start) {
+      break;
+    }
+    window *= 2;
+  }
+  free(buffer);
+  fclose(primes);
+
+  if (complete_size < size) {
+    if (truncate(filename, complete_size) != 0) {
+      ErrorOut("Unable to remove the partial line at the end of the file.");
+    }
+    printf("Removed a partial line from the end of %s.\n", filename);
+  }
+  return line;
+}
+
+void ReadHighestPrime(char* filename, LargeUInt* prime) {
+  LargeUIntInit(0, prime);
+  FILE* primes = fopen(filename, "rb");
+  if (primes == NULL) {
+    return;
+  }
+  long text_start = 0;
+  if (fgetc(primes) == LARGE_U_INT_BINARY_MARKER) {
+    LargeUIntSkipBinary(primes, prime);
+    text_start = ftell(primes);
+  }
+  fclose(primes);
+
+  char* line = ReadLastPrimeLine(filename, text_start);
+  if (line != NULL) {
+    LargeUIntLoad(strlen(line), line, prime);
+    free(line);
+  }
+}
@@ -0,0 +1,38 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PRIMES_FILE_H
+#define PRIMES_FILE_H
+
+#include "large-u-int.h"
+
+// Finds the last prime in a text primes file without reading the whole file.
+// Returns the last complete line that holds a value, without its newline, in
+// a buffer the caller frees, or NULL if there is none. The finders append
+// whole lines, so anything after the last newline is a line that was cut off
+// when a finder was killed. That partial line is removed from the file.
+// Only the text from text_start on is looked at or removed, which lets a file
+// that starts with binary blocks pass the offset of the text after them.
+char* ReadLastPrimeLine(char* filename, long text_start);
+
+// Finds the highest prime in a primes file of either format, or in one with
+// binary blocks followed by text, and stores it in prime, which has zero bytes
+// if the file is missing or holds none. Binary blocks are skipped by their
+// lengths and never changed, and the text after them is read from the end,
+// removing a partial line there as ReadLastPrimeLine does.
+void ReadHighestPrime(char* filename, LargeUInt* prime);
+
+#endif
@@ -18,6 +18,12 @@
 // a configurable amount of time performaing an exaustive check by trial
 // division to prove that the number is prime. If the provided time limit
 // is exceeded, the number is reported as probably prime.
+//
+// With --certificate, the prime is instead built so that it can be proven
+// without trial division, and the proof is written out as a certificate that
+// certificate-verifier checks.
+
+#include "wheel.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -111,10 +117,283 @@ void FindNearbyPrime(mpz_t candidate, int timeout) {
   }
 }
 
+// Primes below this are proven by trial division. Each larger one is proven
+// from a prime a little over a third of its length.
+#define TRIAL_DIVISION_LIMIT 4294967296ull
+
+// n - 1 is also searched for factors below this, which are added to F.
+#define SMALL_FACTOR_LIMIT (1 << 16)
+// There are this many primes below SMALL_FACTOR_LIMIT.
+#define NUM_SMALL_PRIMES 6542
+
+// Bases up to this are tried as the witness for each candidate.
+#define MAX_WITNESS 100
+
+// Writes the value in the LargeUInt text format.
+void PrintLargeUInt(const mpz_t value, FILE* out) {
+  size_t num_bytes = (mpz_sizeinbase(value, 2) + 7) / 8;
+  unsigned char* bytes = calloc(num_bytes, 1);
+  if (bytes == NULL) {
+    printf("Unable to allocate space for a value.\n");
+    exit(1);
+  }
+  size_t count = 0;
+  mpz_export(bytes, &count, -1, 1, 0, 0, value);
+  fprintf(out, "%02X%02X_", (unsigned) (count & 0xFF), (unsigned) (count >> 8));
+  for (size_t i = 0; i < count; i++) {
+    fprintf(out, "%02X", bytes[i]);
+  }
+  free(bytes);
+}
+
+// Returns 1 if value, which is below TRIAL_DIVISION_LIMIT, is prime.
+int IsSmallPrime(uint64_t value) {
+  if (value < 4) {
+    return value >= 2;
+  }
+  if (value % 2 == 0) {
+    return 0;
+  }
+  for (uint64_t divisor = 3; divisor * divisor <= value; divisor += 2) {
+    if (value % divisor == 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+// Collects the primes below SMALL_FACTOR_LIMIT that divide value into
+// factors, which has room for all of them, and returns how many there are.
+// Divisors come off the wheel after 2, 3, 5 and 7; any that are not prime
+// never divide what is left by the time they are reached.
+int SmallFactors(const mpz_t value, unsigned long* factors) {
+  mpz_t rest;
+  mpz_init_set(rest, value);
+  int num_factors = 0;
+  unsigned long divisor = 2;
+  Wheel wheel;
+  WheelStart(WHEEL_FIRST_DIVISOR, &wheel);
+  while (divisor < SMALL_FACTOR_LIMIT) {
+    if (mpz_divisible_ui_p(rest, divisor)) {
+      factors[num_factors++] = divisor;
+      while (mpz_divisible_ui_p(rest, divisor)) {
+        mpz_divexact_ui(rest, rest, divisor);
+      }
+    }
+    if (divisor < WHEEL_FIRST_DIVISOR) {
+      divisor = divisor == 2 ? 3 : divisor == 7 ? WHEEL_FIRST_DIVISOR
+                                                : divisor + 2;
+    } else {
+      divisor += WheelNext(&wheel);
+    }
+  }
+  mpz_clear(rest);
+  return num_factors;
+}
+
+// Returns 1 if base shows every prime factor of n to be 1 mod each of the
+// primes in factors (Pocklington): base^(n - 1) = 1 mod n, and
+// gcd(base^((n - 1) / q) - 1, n) = 1 for each of them.
+int IsWitness(unsigned long base, const mpz_t n, int num_factors,
+              mpz_t* factors) {
+  mpz_t a, n_minus_1, exponent, power;
+  mpz_init_set_ui(a, base);
+  mpz_init(n_minus_1);
+  mpz_init(exponent);
+  mpz_init(power);
+  mpz_sub_ui(n_minus_1, n, 1);
+  mpz_powm(power, a, n_minus_1, n);
+  int is_witness = mpz_cmp_ui(power, 1) == 0;
+  for (int i = 0; i < num_factors && is_witness; i++) {
+    mpz_divexact(exponent, n_minus_1, factors[i]);
+    mpz_powm(power, a, exponent, n);
+    mpz_sub_ui(power, power, 1);
+    mpz_gcd(power, power, n);
+    is_witness = mpz_cmp_ui(power, 1) == 0;
+  }
+  mpz_clears(a, n_minus_1, exponent, power, NULL);
+  return is_witness;
+}
+
+// Returns 1 if the checks on n with the factored part f of n - 1 are enough
+// to prove it prime. With f^2 > n they are. Otherwise, since f^3 > n, writing
+// n = c2 * f^2 + c1 * f + 1, c1^2 - 4 * c2 must not be a square.
+int FactoredPartIsEnough(const mpz_t n, const mpz_t f) {
+  mpz_t c1, c2, square;
+  mpz_inits(c1, c2, square, NULL);
+  mpz_mul(square, f, f);
+  int is_enough = mpz_cmp(square, n) > 0;
+  if (!is_enough) {
+    mpz_sub_ui(c2, n, 1);
+    mpz_divexact(c2, c2, f);
+    mpz_fdiv_qr(c2, c1, c2, f);
+    mpz_mul(square, c1, c1);
+    mpz_submul_ui(square, c2, 4);
+    is_enough = mpz_sgn(square) < 0 || !mpz_perfect_square_p(square);
+  }
+  mpz_clears(c1, c2, square, NULL);
+  return is_enough;
+}
+
+// Finds a random prime at least low and below high, and writes the lines of
+// the certificate that prove it to out, after the lines for the primes that
+// its own line depends on.
+void ProvePrime(const mpz_t low, const mpz_t high, gmp_randstate_t random,
+                FILE* out, mpz_t prime) {
+  mpz_t range;
+  mpz_init(range);
+  if (mpz_cmp_ui(high, TRIAL_DIVISION_LIMIT) <= 0) {
+    // Move up from a random start, wrapping around at high.
+    mpz_sub(range, high, low);
+    mpz_urandomm(prime, random, range);
+    mpz_add(prime, prime, low);
+    uint64_t value = mpz_get_ui(prime);
+    while (!IsSmallPrime(value)) {
+      value = value + 1 < mpz_get_ui(high) ? value + 1 : mpz_get_ui(low);
+    }
+    mpz_set_ui(prime, value);
+    PrintLargeUInt(prime, out);
+    fprintf(out, " # proven by trial division\n");
+    mpz_clear(range);
+    return;
+  }
+
+  // A prime q with q^3 > high, so that F is at least the cube root of any n
+  // below high.
+  mpz_t q_low, q_high, q;
+  mpz_inits(q_low, q_high, q, NULL);
+  mpz_root(q_low, high, 3);
+  mpz_add_ui(q_low, q_low, 1);
+  mpz_mul_ui(q_high, q_low, 2);
+  ProvePrime(q_low, q_high, random, out, q);
+
+  // Candidates are n = 2 * k * q + 1 for k from k_low up to below k_high,
+  // which keeps them at least low and below high.
+  mpz_t two_q, k_low, k, n, n_minus_1, rest, f;
+  mpz_inits(two_q, k_low, k, n, n_minus_1, rest, f, NULL);
+  mpz_mul_ui(two_q, q, 2);
+  mpz_sub_ui(k_low, low, 1);
+  mpz_cdiv_q(k_low, k_low, two_q);
+  mpz_sub_ui(range, high, 2);
+  mpz_fdiv_q(range, range, two_q);
+  mpz_add_ui(range, range, 1);
+  mpz_sub(range, range, k_low);
+
+  unsigned long small_factors[NUM_SMALL_PRIMES];
+  mpz_t* factors = NULL;
+  int num_factors = 0;
+  unsigned long base = 0;
+  while (base == 0) {
+    mpz_urandomm(k, random, range);
+    mpz_add(k, k, k_low);
+    mpz_mul(n, two_q, k);
+    mpz_add_ui(n, n, 1);
+    // The certificate is the proof, so one round of the probable prime test
+    // is enough to pass over composites quickly.
+    if (mpz_probab_prime_p(n, 1) == 0) {
+      continue;
+    }
+
+    // F is made up of q and the small primes of n - 1, to their full powers.
+    mpz_sub_ui(n_minus_1, n, 1);
+    int num_small = SmallFactors(n_minus_1, small_factors);
+    factors = malloc((num_small + 1) * sizeof(mpz_t));
+    if (factors == NULL) {
+      printf("Unable to allocate space for factors.\n");
+      exit(1);
+    }
+    num_factors = 0;
+    mpz_set(rest, n_minus_1);
+    for (int i = 0; i <= num_small; i++) {
+      mpz_init(factors[num_factors]);
+      if (i < num_small) {
+        mpz_set_ui(factors[num_factors], small_factors[i]);
+      } else {
+        mpz_set(factors[num_factors], q);
+      }
+      // q may itself be below SMALL_FACTOR_LIMIT.
+      if (!mpz_divisible_p(rest, factors[num_factors])) {
+        mpz_clear(factors[num_factors]);
+        continue;
+      }
+      mpz_remove(rest, rest, factors[num_factors]);
+      num_factors++;
+    }
+    mpz_divexact(f, n_minus_1, rest);
+
+    if (FactoredPartIsEnough(n, f)) {
+      for (unsigned long a = 2; a <= MAX_WITNESS && base == 0; a++) {
+        if (IsWitness(a, n, num_factors, factors)) {
+          base = a;
+        }
+      }
+    }
+    if (base == 0) {
+      for (int i = 0; i < num_factors; i++) {
+        mpz_clear(factors[i]);
+      }
+      free(factors);
+    }
+  }
+
+  mpz_set(prime, n);
+  PrintLargeUInt(n, out);
+  // Witnesses are below 256, so they take one byte.
+  fprintf(out, " 0100_%02lX", base);
+  for (int i = 0; i < num_factors; i++) {
+    fputc(' ', out);
+    PrintLargeUInt(factors[i], out);
+    mpz_clear(factors[i]);
+  }
+  fprintf(out, "\n");
+  free(factors);
+  mpz_clears(range, q_low, q_high, q, two_q, k_low, k, n, n_minus_1, rest, f,
+             NULL);
+}
+
+// Writes a certificate for a random prime of num_digits digits to filename.
+int WriteCertificate(int num_digits, char* filename) {
+  FILE* out = fopen(filename, "w");
+  if (out == NULL) {
+    printf("Unable to open %s\n", filename);
+    return 1;
+  }
+  fprintf(out, "# Primality certificate. Each line proves one prime from the "
+               "small primes\n# and the primes on the lines above it, and the "
+               "last line proves the\n# prime found. Each line that is not "
+               "proven by trial division holds the\n# prime, a witness and "
+               "the prime factors of the prime minus 1 it relies on.\n");
+  gmp_randstate_t random;
+  gmp_randinit_default(random);
+  gmp_randseed_ui(random, time(0));
+  mpz_t low, high, prime;
+  mpz_inits(low, high, prime, NULL);
+  mpz_ui_pow_ui(low, 10, num_digits - 1);
+  mpz_ui_pow_ui(high, 10, num_digits);
+  ProvePrime(low, high, random, out, prime);
+  if (fclose(out) != 0) {
+    printf("Unable to write %s\n", filename);
+    return 1;
+  }
+  printf("Prime:\n%s\n", mpz_get_str(NULL, 10, prime));
+  printf("Certificate written to %s\n", filename);
+  mpz_clears(low, high, prime, NULL);
+  gmp_randclear(random);
+  return 0;
+}
+
 int main(int argc, char *argv[]) {
+  if (argc == 4 && strcmp(argv[1], "--certificate") == 0 &&
+      atoi(argv[3]) > 0) {
+    return WriteCertificate(atoi(argv[3]), argv[2]);
+  }
   if (argc < 3) {
     printf("Usage: %s <num digits> <max minutes to run>\n", argv[0]);
+    printf("       %s --certificate <file> <num digits>\n", argv[0]);
     printf("For example %s 20 5\n", argv[0]);
+    printf("With --certificate, the prime is proven without trial division "
+           "and the proof\nis written to the file for certificate-verifier "
+           "to check.\n");
     return 1;
   }
   srand(time(0));
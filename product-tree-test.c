@@ -0,0 +1,214 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "product-tree.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+void Check(int condition, char* message) {
+  if (!condition) {
+    fprintf(stderr, "Condition failed: %s\n", message);
+    exit(1);
+  }
+}
+
+// Fills this with num_bytes pseudorandom bytes from the given state.
+void RandomLargeUInt(int num_bytes, uint64_t* state, LargeUInt* this) {
+  LargeUIntInit(num_bytes, this);
+  int i;
+  for (i = 0; i < num_bytes; i++) {
+    *state = *state * 6364136223846793005ull + 1442695040888963407ull;
+    LargeUIntSetByte(*state >> 56, i, this);
+  }
+  LargeUIntTrim(this);
+}
+
+// Checks ProductTreeResidues against LargeUIntModSmall for candidates from
+// shorter than the tree's product to twice as long.
+void CheckResidues(ProductTree* tree, char* message) {
+  LargeUInt product = {0};
+  LargeUInt candidate = {0};
+  ProductTreeProduct(tree, &product);
+  int max_bytes = 2 * LargeUIntNumBytes(&product) + 9;
+  uint32_t* residues = malloc(tree->num_primes_ * sizeof(uint32_t));
+  uint32_t* expected = malloc(tree->num_primes_ * sizeof(uint32_t));
+  uint64_t state = 3;
+  int num_bytes;
+  int all_match = 1;
+  for (num_bytes = 0; num_bytes < max_bytes;
+       num_bytes += 1 + max_bytes / 8) {
+    RandomLargeUInt(num_bytes, &state, &candidate);
+    ProductTreeResidues(tree, &candidate, residues);
+    LargeUIntModSmall(&candidate, tree->primes_, tree->num_primes_, expected);
+    if (memcmp(residues, expected, tree->num_primes_ * sizeof(uint32_t))) {
+      all_match = 0;
+    }
+  }
+  Check(all_match, message);
+  free(residues);
+  free(expected);
+  LargeUIntFree(&product);
+  LargeUIntFree(&candidate);
+}
+
+void TestResidues() {
+  ProductTree tree = {0};
+  uint32_t one_prime[1] = {4294967291u};
+  ProductTreeInit(one_prime, 1, &tree);
+  CheckResidues(&tree, "Residues by a single prime should match");
+  ProductTreeFree(&tree);
+
+  uint32_t few_primes[6] = {3, 5, 7, 65537, 4294967279u, 4294967291u};
+  ProductTreeInit(few_primes, 6, &tree);
+  Check(tree.num_leaves_ == 2 && tree.leaf_starts_[1] == 5,
+        "All but the last of the primes should fit in one leaf");
+  CheckResidues(&tree, "Residues by a few primes should match");
+  ProductTreeFree(&tree);
+
+  ProductTreeInitRange(11, 1 << 16, &tree);
+  Check(tree.num_primes_ == 6542 - 4, "There are 6538 primes from 11 to 2^16");
+  Check(tree.primes_[0] == 11 && tree.primes_[6537] == 65521,
+        "Primes should run from 11 to 65521");
+  CheckResidues(&tree, "Residues by the primes below 2^16 should match");
+  ProductTreeFree(&tree);
+}
+
+void TestProduct() {
+  ProductTree tree = {0};
+  LargeUInt product = {0};
+  ProductTreeInitRange(0, 30, &tree);
+  ProductTreeProduct(&tree, &product);
+  Check(LargeUIntGetWord(&product) == 6469693230ull,
+        "Primorial of 29 should be 6469693230");
+  ProductTreeFree(&tree);
+  LargeUIntFree(&product);
+}
+
+void TestHasFactor() {
+  ProductTree tree = {0};
+  LargeUInt candidate = {0};
+  ProductTreeInitRange(11, 1 << 16, &tree);
+
+  LargeUIntSetWord(0, &candidate);
+  Check(ProductTreeHasFactor(&tree, &candidate), "0 has every factor");
+  LargeUIntSetWord(1, &candidate);
+  Check(!ProductTreeHasFactor(&tree, &candidate), "1 has no factor");
+  LargeUIntSetWord(65521, &candidate);
+  Check(!ProductTreeHasFactor(&tree, &candidate),
+        "A prime in the tree is not its own factor");
+  LargeUIntSetWord(11 * 13, &candidate);
+  Check(ProductTreeHasFactor(&tree, &candidate), "143 is 11 * 13");
+  LargeUIntSetWord(65521ull * 65521, &candidate);
+  Check(ProductTreeHasFactor(&tree, &candidate),
+        "The square of a prime in the tree has it as a factor");
+  LargeUIntSetWord(65537ull * 65539, &candidate);
+  Check(!ProductTreeHasFactor(&tree, &candidate),
+        "65537 * 65539 has no factor below 2^16");
+  LargeUIntSetWord(1000000000000000003ull, &candidate);
+  Check(!ProductTreeHasFactor(&tree, &candidate), "10^18 + 3 is prime");
+  LargeUIntSetWord(1000000000000000001ull, &candidate);
+  Check(ProductTreeHasFactor(&tree, &candidate), "10^18 + 1 is 101 * ...");
+
+  // Longer candidates go through the residues.
+  LargeUInt product = {0};
+  ProductTreeProduct(&tree, &product);
+  uint32_t* residues = malloc(tree.num_primes_ * sizeof(uint32_t));
+  uint64_t state = 5;
+  int trial;
+  int all_match = 1;
+  for (trial = 0; trial < 40; trial++) {
+    RandomLargeUInt(LargeUIntNumBytes(&product) / 40 + trial * 100, &state,
+                    &candidate);
+    ProductTreeResidues(&tree, &candidate, residues);
+    int expected = 0;
+    int i;
+    for (i = 0; i < tree.num_primes_; i++) {
+      if (residues[i] == 0) {
+        expected = 1;
+      }
+    }
+    if (expected != ProductTreeHasFactor(&tree, &candidate)) {
+      all_match = 0;
+    }
+  }
+  Check(all_match, "Candidates should have a factor if any residue is 0");
+
+  // A long candidate with a single large factor in the tree.
+  RandomLargeUInt(LargeUIntNumBytes(&product) + 100, &state, &candidate);
+  LargeUIntSetWord(tree.primes_[tree.num_primes_ - 1], &product);
+  LargeUIntMultiplyFull(&candidate, &product, &candidate);
+  Check(ProductTreeHasFactor(&tree, &candidate),
+        "A multiple of 65521 should have a factor");
+
+  free(residues);
+  ProductTreeFree(&tree);
+  LargeUIntFree(&candidate);
+  LargeUIntFree(&product);
+}
+
+void TestFactor() {
+  ProductTree tree = {0};
+  LargeUInt candidate = {0};
+  ProductTreeInitRange(11, 1 << 16, &tree);
+  LargeUIntSetWord(65521, &candidate);
+  Check(ProductTreeFactor(&tree, &candidate) == 0,
+        "A prime in the tree is not its own factor");
+  LargeUIntSetWord(65537ull * 65539, &candidate);
+  Check(ProductTreeFactor(&tree, &candidate) == 0,
+        "65537 * 65539 has no factor below 2^16");
+  LargeUIntSetWord(65521ull * 65519 * 65537, &candidate);
+  Check(ProductTreeFactor(&tree, &candidate) == 65519,
+        "65519 is the smallest factor of 65521 * 65519 * 65537");
+  LargeUIntSetWord(1000000000000000001ull, &candidate);
+  Check(ProductTreeFactor(&tree, &candidate) == 101,
+        "101 is the smallest factor of 10^18 + 1 from 11 up");
+  ProductTreeFree(&tree);
+  LargeUIntFree(&candidate);
+}
+
+// In a tree this small every candidate goes through the residues, which must
+// not count a prime of the tree as its own factor either.
+void TestSmallTree() {
+  ProductTree tree = {0};
+  LargeUInt candidate = {0};
+  uint32_t primes[] = {3, 5, 7};
+  ProductTreeInit(primes, 3, &tree);
+  uint32_t value;
+  for (value = 3; value <= 7; value += 2) {
+    LargeUIntSetWord(value, &candidate);
+    Check(!ProductTreeHasFactor(&tree, &candidate),
+          "3, 5 and 7 are not their own factors");
+    Check(ProductTreeFactor(&tree, &candidate) == 0,
+          "3, 5 and 7 have no factor in the tree");
+  }
+  LargeUIntSetWord(9, &candidate);
+  Check(ProductTreeFactor(&tree, &candidate) == 3, "9 is 3 * 3");
+  LargeUIntSetWord(35, &candidate);
+  Check(ProductTreeFactor(&tree, &candidate) == 5, "35 is 5 * 7");
+  LargeUIntSetWord(11, &candidate);
+  Check(!ProductTreeHasFactor(&tree, &candidate), "11 has no factor");
+  ProductTreeFree(&tree);
+  LargeUIntFree(&candidate);
+}
+
+int main(void) {
+  TestResidues();
+  TestProduct();
+  TestHasFactor();
+  TestFactor();
+  TestSmallTree();
+  printf("All tests passed\n");
+}
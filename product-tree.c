@@ -0,0 +1,300 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "product-tree.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Enough levels for 2^31 leaves.
+#define MAX_PRODUCT_TREE_LEVELS 32
+
+// ProductTreeHasFactor takes a gcd with the product for candidates under
+// 1 / GCD_LENGTH_RATIO of its length. Euclid's algorithm slows with the square
+// of the candidate's length, so longer ones are quicker through the tree.
+#define GCD_LENGTH_RATIO 32
+
+// ProductTreeFactor tries this many primes at a time.
+#define FACTOR_BATCH 64
+
+static void ErrorOut(char* message) {
+  fprintf(stderr, "%s\n", message);
+  exit(1);
+}
+
+static void* Allocate(size_t size) {
+  void* memory = malloc(size);
+  if (memory == NULL) {
+    ErrorOut("Unable to allocate space for a product tree.");
+  }
+  return memory;
+}
+
+// Sets the node to the product of two values, or a copy of the first when the
+// second is NULL.
+static void InitNode(const LargeUInt* left, const LargeUInt* right,
+                     ProductTreeNode* node) {
+  memset(node, 0, sizeof(ProductTreeNode));
+  if (right == NULL) {
+    LargeUIntClone(left, &node->product_);
+  } else {
+    LargeUIntMultiplyFull(left, right, &node->product_);
+  }
+  LargeUIntBarrettInit(&node->product_, &node->barrett_);
+}
+
+void ProductTreeInit(const uint32_t* primes, int num_primes,
+                     ProductTree* tree) {
+  if (num_primes < 1) {
+    ErrorOut("A product tree needs at least one prime.");
+  }
+  tree->num_primes_ = num_primes;
+  tree->primes_ = Allocate(num_primes * sizeof(uint32_t));
+  memcpy(tree->primes_, primes, num_primes * sizeof(uint32_t));
+
+  // Pack as many primes into each leaf as fit in a word.
+  tree->leaf_starts_ = Allocate((num_primes + 1) * sizeof(int));
+  tree->leaf_products_ = Allocate(num_primes * sizeof(uint64_t));
+  tree->num_leaves_ = 0;
+  int i;
+  for (i = 0; i < num_primes; i++) {
+    int leaf = tree->num_leaves_ - 1;
+    if (leaf < 0 || tree->leaf_products_[leaf] > UINT64_MAX / primes[i]) {
+      leaf = tree->num_leaves_++;
+      tree->leaf_starts_[leaf] = i;
+      tree->leaf_products_[leaf] = 1;
+    }
+    tree->leaf_products_[leaf] *= primes[i];
+  }
+  tree->leaf_starts_[tree->num_leaves_] = num_primes;
+
+  tree->level_sizes_ = Allocate(MAX_PRODUCT_TREE_LEVELS * sizeof(int));
+  tree->levels_ =
+      Allocate(MAX_PRODUCT_TREE_LEVELS * sizeof(ProductTreeNode*));
+  int size = (tree->num_leaves_ + 1) / 2;
+  ProductTreeNode* level = Allocate(size * sizeof(ProductTreeNode));
+  LargeUInt left = {0};
+  LargeUInt right = {0};
+  for (i = 0; i < size; i++) {
+    LargeUIntSetWord(tree->leaf_products_[2 * i], &left);
+    if (2 * i + 1 < tree->num_leaves_) {
+      LargeUIntSetWord(tree->leaf_products_[2 * i + 1], &right);
+      InitNode(&left, &right, &level[i]);
+    } else {
+      InitNode(&left, NULL, &level[i]);
+    }
+  }
+  LargeUIntFree(&left);
+  LargeUIntFree(&right);
+  tree->num_levels_ = 1;
+  tree->level_sizes_[0] = size;
+  tree->levels_[0] = level;
+
+  while (size > 1) {
+    const ProductTreeNode* below = level;
+    int below_size = size;
+    size = (below_size + 1) / 2;
+    level = Allocate(size * sizeof(ProductTreeNode));
+    for (i = 0; i < size; i++) {
+      InitNode(&below[2 * i].product_,
+               2 * i + 1 < below_size ? &below[2 * i + 1].product_ : NULL,
+               &level[i]);
+    }
+    tree->level_sizes_[tree->num_levels_] = size;
+    tree->levels_[tree->num_levels_] = level;
+    tree->num_levels_++;
+  }
+}
+
+void ProductTreeInitRange(uint32_t first, uint32_t limit, ProductTree* tree) {
+  if (first < 2) {
+    first = 2;
+  }
+  if (limit <= first) {
+    ErrorOut("A product tree needs at least one prime.");
+  }
+  char* composite = calloc(limit, 1);
+  uint32_t* primes = Allocate((limit / 2 + 1) * sizeof(uint32_t));
+  if (composite == NULL) {
+    ErrorOut("Unable to allocate space for a product tree.");
+  }
+  int num_primes = 0;
+  uint64_t i;
+  for (i = 2; i < limit; i++) {
+    if (composite[i]) {
+      continue;
+    }
+    if (i >= first) {
+      primes[num_primes++] = i;
+    }
+    uint64_t multiple;
+    for (multiple = i * i; multiple < limit; multiple += i) {
+      composite[multiple] = 1;
+    }
+  }
+  ProductTreeInit(primes, num_primes, tree);
+  free(composite);
+  free(primes);
+}
+
+void ProductTreeFree(ProductTree* tree) {
+  int level;
+  for (level = 0; level < tree->num_levels_; level++) {
+    int i;
+    for (i = 0; i < tree->level_sizes_[level]; i++) {
+      LargeUIntFree(&tree->levels_[level][i].product_);
+      LargeUIntBarrettFree(&tree->levels_[level][i].barrett_);
+    }
+    free(tree->levels_[level]);
+  }
+  free(tree->levels_);
+  free(tree->level_sizes_);
+  free(tree->leaf_products_);
+  free(tree->leaf_starts_);
+  free(tree->primes_);
+  memset(tree, 0, sizeof(ProductTree));
+}
+
+static const LargeUInt* Root(const ProductTree* tree) {
+  return &tree->levels_[tree->num_levels_ - 1][0].product_;
+}
+
+void ProductTreeProduct(const ProductTree* tree, LargeUInt* product) {
+  LargeUIntClone(Root(tree), product);
+}
+
+void ProductTreeResidues(const ProductTree* tree, const LargeUInt* candidate,
+                         uint32_t* residues) {
+  // The remainders by one level of nodes, and by the level below it.
+  int width = tree->level_sizes_[0];
+  LargeUInt* above = calloc(width, sizeof(LargeUInt));
+  LargeUInt* below = calloc(width, sizeof(LargeUInt));
+  if (above == NULL || below == NULL) {
+    ErrorOut("Unable to allocate space for product tree remainders.");
+  }
+  int level = tree->num_levels_ - 1;
+  LargeUIntBarrettMod(candidate, &tree->levels_[level][0].barrett_, &above[0]);
+  int i;
+  for (level--; level >= 0; level--) {
+    for (i = 0; i < tree->level_sizes_[level]; i++) {
+      LargeUIntBarrettMod(&above[i / 2], &tree->levels_[level][i].barrett_,
+                          &below[i]);
+    }
+    LargeUInt* swap = above;
+    above = below;
+    below = swap;
+  }
+
+  // Each leaf's remainder fits in a word, which is cheap to reduce by each of
+  // its primes.
+  for (i = 0; i < tree->num_leaves_; i++) {
+    uint64_t remainder =
+        LargeUIntModWord(&above[i / 2], tree->leaf_products_[i]);
+    int j;
+    for (j = tree->leaf_starts_[i]; j < tree->leaf_starts_[i + 1]; j++) {
+      residues[j] = remainder % tree->primes_[j];
+    }
+  }
+
+  for (i = 0; i < width; i++) {
+    LargeUIntFree(&above[i]);
+    LargeUIntFree(&below[i]);
+  }
+  free(above);
+  free(below);
+}
+
+// Returns 1 if the value is one of the tree's primes.
+static int IsTreePrime(const ProductTree* tree, const LargeUInt* value) {
+  if (LargeUIntNumBytes(value) > 4) {
+    return 0;
+  }
+  uint64_t word = LargeUIntGetWord(value);
+  int low = 0;
+  int high = tree->num_primes_;
+  while (low < high) {
+    int middle = low + (high - low) / 2;
+    if (tree->primes_[middle] < word) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low < tree->num_primes_ && tree->primes_[low] == word;
+}
+
+int ProductTreeHasFactor(const ProductTree* tree, const LargeUInt* candidate) {
+  const LargeUInt* root = Root(tree);
+  if (LargeUIntNumBytes(candidate) * GCD_LENGTH_RATIO <
+      LargeUIntNumBytes(root)) {
+    if (LargeUIntNumBytes(candidate) == 0) {
+      return 1;
+    }
+    // gcd(candidate, root) = gcd(candidate, root mod candidate), so this is
+    // one pass over the root and a gcd of short values.
+    LargeUInt gcd = {0};
+    LargeUIntMod(root, candidate, &gcd);
+    LargeUIntGcd(candidate, &gcd, &gcd);
+    int has_factor = !(LargeUIntNumBytes(&gcd) == 1 &&
+                       LargeUIntGetWord(&gcd) == 1);
+    if (has_factor && LargeUIntEqual(&gcd, candidate) &&
+        IsTreePrime(tree, candidate)) {
+      has_factor = 0;
+    }
+    LargeUIntFree(&gcd);
+    return has_factor;
+  }
+
+  // A zero remainder is a factor unless the candidate is that prime, which
+  // only a candidate of up to 4 bytes can be.
+  uint32_t* residues = Allocate(tree->num_primes_ * sizeof(uint32_t));
+  ProductTreeResidues(tree, candidate, residues);
+  int is_tree_prime = IsTreePrime(tree, candidate);
+  uint64_t word = LargeUIntGetWord(candidate);
+  int has_factor = 0;
+  int i;
+  for (i = 0; i < tree->num_primes_ && !has_factor; i++) {
+    has_factor = residues[i] == 0 &&
+                 !(is_tree_prime && tree->primes_[i] == word);
+  }
+  free(residues);
+  return has_factor;
+}
+
+uint32_t ProductTreeFactor(const ProductTree* tree, const LargeUInt* candidate) {
+  if (!ProductTreeHasFactor(tree, candidate)) {
+    return 0;
+  }
+  // The candidate is not one of the primes, so the first one with a zero
+  // remainder is the factor. Try them a batch at a time from the smallest.
+  int first;
+  for (first = 0; first < tree->num_primes_; first += FACTOR_BATCH) {
+    uint32_t residues[FACTOR_BATCH];
+    int count = tree->num_primes_ - first;
+    if (count > FACTOR_BATCH) {
+      count = FACTOR_BATCH;
+    }
+    LargeUIntModSmall(candidate, tree->primes_ + first, count, residues);
+    int i;
+    for (i = 0; i < count; i++) {
+      if (residues[i] == 0) {
+        return tree->primes_[first + i];
+      }
+    }
+  }
+  return 0;
+}
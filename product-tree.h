@@ -0,0 +1,83 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PRODUCT_TREE_H
+#define PRODUCT_TREE_H
+
+#include "large-u-int.h"
+
+#include <stdint.h>
+
+// A product tree over a fixed set of small primes. The primes are packed into
+// leaves of one 64 bit word each, the leaves are multiplied together in
+// pairs, then the pairs in pairs, up to their whole product at the root. A
+// candidate is reduced modulo the root once and each remainder modulo the
+// two nodes below it, so its remainder by every prime comes out of a few
+// large multiplications rather than one pass over the candidate per prime.
+// Built once, a tree may be shared by any number of threads.
+
+// One node above the leaves. The Barrett context reduces a remainder from
+// the node above by this node's product.
+typedef struct {
+  LargeUInt product_;
+  LargeUIntBarrettCtx barrett_;
+} ProductTreeNode;
+
+typedef struct {
+  int num_primes_;
+  uint32_t* primes_;
+  // Leaf i holds primes_[leaf_starts_[i]] up to primes_[leaf_starts_[i + 1]]
+  // and their product, leaf_products_[i].
+  int num_leaves_;
+  int* leaf_starts_;
+  uint64_t* leaf_products_;
+  // Level 0 is made of pairs of leaves, and the last level holds only the
+  // root, which is a copy of the one leaf when there is only one.
+  int num_levels_;
+  int* level_sizes_;
+  ProductTreeNode** levels_;
+} ProductTree;
+
+// Builds a tree over num_primes primes in increasing order, each below 2^32.
+// There must be at least one. The tree must start out zeroed.
+void ProductTreeInit(const uint32_t* primes, int num_primes, ProductTree* tree);
+
+// Builds a tree over every prime from first up to but not including limit.
+void ProductTreeInitRange(uint32_t first, uint32_t limit, ProductTree* tree);
+
+// Releases everything held by the tree.
+void ProductTreeFree(ProductTree* tree);
+
+// Stores the product of the tree's primes in the second argument.
+void ProductTreeProduct(const ProductTree* tree, LargeUInt* product);
+
+// Writes the candidate modulo each of the tree's primes, in the order they
+// were given, into residues.
+void ProductTreeResidues(const ProductTree* tree, const LargeUInt* candidate,
+                         uint32_t* residues);
+
+// Returns 1 if one of the tree's primes divides the candidate and the
+// candidate is not that prime itself, otherwise 0. A candidate much shorter
+// than the product is checked with a single gcd against it, and longer ones
+// with ProductTreeResidues.
+int ProductTreeHasFactor(const ProductTree* tree, const LargeUInt* candidate);
+
+// Returns the smallest of the tree's primes that divides the candidate, other
+// than the candidate itself, or 0 if there is none. Costs little more than
+// ProductTreeHasFactor when the factor is small.
+uint32_t ProductTreeFactor(const ProductTree* tree, const LargeUInt* candidate);
+
+#endif
@@ -18,32 +18,44 @@
 #include<stdlib.h>
 #include<string.h>
 #include<stdint.h>
+#include<pthread.h>
+#include<time.h>
+
+#include "batch-writer.h"
+#include "block-pipeline.h"
+#include "large-u-int.h"
+#include "prime-archive.h"
+#include "primes-file.h"
 
 const char HEX_BYTES[] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9',
                           'A', 'B', 'C', 'D', 'E', 'F'};
 
-void BigIntPrint(uint_fast64_t x, FILE *out) {
-  int num_bytes;
-  if (x <= 0xFF) {
-    num_bytes = 1;
-  } else if (x <= 0xFFFF) {
-    num_bytes = 2;
-  } else if (x <= 0xFFFFFF) {
-    num_bytes = 3;
-  } else if (x <= 0xFFFFFFFF) {
-    num_bytes = 4;
-  } else {
-    printf("reached size limit");
-    exit(1);
+// Large enough for any line written by BigIntStore.
+#define BIG_INT_LINE_SIZE 64
+
+// Writes the line for x in the primes file format into buffer, which must
+// hold BIG_INT_LINE_SIZE chars, and returns its length.
+int BigIntStore(uint_fast64_t x, char* buffer) {
+  int num_bytes = 1;
+  while (num_bytes < 8 && x >> (8 * num_bytes) > 0) {
+    num_bytes++;
   }
 
-  fprintf(out, "0%c00_", HEX_BYTES[num_bytes]);
+  int length = sprintf(buffer, "0%c00_", HEX_BYTES[num_bytes]);
   uint_fast64_t x_copy = x;
   while (x > 0) {
-    fprintf(out, "%c%c", HEX_BYTES[x >> 4 & 0x0F], HEX_BYTES[x & 0x0F]);
+    buffer[length++] = HEX_BYTES[x >> 4 & 0x0F];
+    buffer[length++] = HEX_BYTES[x & 0x0F];
     x >>= 8;
   }
-  fprintf(out, " # int value: %llu\n", x_copy);
+  length += sprintf(buffer + length, " # int value: %llu\n",
+                    (unsigned long long) x_copy);
+  return length;
+}
+
+void BigIntPrint(uint_fast64_t x, FILE *out) {
+  char buffer[BIG_INT_LINE_SIZE];
+  fwrite(buffer, 1, BigIntStore(x, buffer), out);
 }
 
 int HexCharToNibble(char hex_char) {
@@ -56,134 +68,270 @@ int HexCharToNibble(char hex_char) {
   }
 }
 
-uint_fast64_t FindNearbyPrime(uint_fast64_t candidate) {
-  if (candidate % 2 == 0) {
-    candidate++;
-  }
+// Segments of the sieve hold one bit for each odd number, set once the number
+// is known to be composite. While every base prime that is needed crosses off
+// at least one number per segment, a segment that fits in the L1 data cache
+// is fastest. Past that point most base primes skip whole segments, so larger
+// segments sized to the L2 cache spread the cost of visiting them.
+#ifndef L1_CACHE_BYTES
+#define L1_CACHE_BYTES (32 * 1024)
+#endif
+#ifndef L2_CACHE_BYTES
+#define L2_CACHE_BYTES (256 * 1024)
+#endif
+#define L1_SEGMENT_BITS (L1_CACHE_BYTES * 8)
+#define L2_SEGMENT_BITS (L2_CACHE_BYTES * 8)
+
+// Base primes are kept in fixed size chunks so that they never move while
+// other threads read them. All the primes below 2^32 fit in MAX_BASE_CHUNKS.
+#define BASE_CHUNK_PRIMES (1 << 20)
+#define MAX_BASE_CHUNKS 256
 
-  uint_fast64_t max_divisor = candidate / 2;
-  for (uint_fast64_t divisor = 3; divisor <= max_divisor;) {
-    if (candidate % divisor == 0) {
-      candidate += 2;
-      divisor = 3;
-      max_divisor = candidate / 2;
+// The odd primes up to limit, in increasing order. Grown as the sieve moves
+// up so that it always reaches the square root of the current segment, which
+// is never more than 2^32. Only the thread holding extend_lock adds primes or
+// reads num_primes and limit. Readers take the published count and limit
+// under lock, and every prime below that count stays valid.
+typedef struct {
+  uint32_t* chunks[MAX_BASE_CHUNKS];
+  size_t num_primes;
+  uint_fast64_t limit;
+  pthread_mutex_t extend_lock;
+  pthread_mutex_t lock;
+  size_t published_primes;
+  uint_fast64_t published_limit;
+} BasePrimes;
+
+// Marks the odd composites among the num_bits odd numbers starting at low,
+// which must be odd. Bit i of sieve stands for low + 2 * i. The first
+// num_primes base primes must hold every prime up to the square root of the
+// last number.
+void SieveSegment(uint_fast64_t low, int num_bits, const BasePrimes* base,
+                  size_t num_primes, uint64_t* sieve) {
+  memset(sieve, 0, ((num_bits + 63) / 64) * sizeof(uint64_t));
+  uint_fast64_t high = low + 2 * (uint_fast64_t) (num_bits - 1);
+  size_t i;
+  for (i = 0; i < num_primes; i++) {
+    uint_fast64_t prime =
+        base->chunks[i / BASE_CHUNK_PRIMES][i % BASE_CHUNK_PRIMES];
+    if (prime * prime > high) {
+      break;
+    }
+    // Find the first odd multiple that is in range, not counting the prime
+    // itself. Working with offsets from low keeps this from overflowing.
+    uint_fast64_t offset;
+    if (prime * prime >= low) {
+      offset = prime * prime - low;
     } else {
-      max_divisor = candidate / divisor;
-      divisor += 2;
+      offset = (prime - low % prime) % prime;
+      if (offset % 2 == 1) {
+        offset += prime;
+      }
+    }
+    uint_fast64_t bit;
+    for (bit = offset / 2; bit < num_bits; bit += prime) {
+      sieve[bit / 64] |= (uint64_t) 1 << (bit % 64);
     }
   }
-
-  // We ran out of divisors so candidate is prime.
-  return candidate;
+  if (low == 1) {
+    sieve[0] |= 1;
+  }
 }
 
-uint_fast64_t LoadNextPrime(FILE* primes) {
-  if (primes == NULL) {
-    return 0;
+// Returns the index of the first unmarked bit at or after start, or num_bits
+// when there are none left.
+int NextUnmarked(const uint64_t* sieve, int num_bits, int start) {
+  int word = start / 64;
+  if (start >= num_bits) {
+    return num_bits;
+  }
+  uint64_t unmarked = ~sieve[word] & (~(uint64_t) 0 << (start % 64));
+  while (unmarked == 0) {
+    word++;
+    if (word * 64 >= num_bits) {
+      return num_bits;
+    }
+    unmarked = ~sieve[word];
   }
+  int index = word * 64 + __builtin_ctzll(unmarked);
+  return index < num_bits ? index : num_bits;
+}
 
-  int current = fgetc(primes);
-  int state = 0;
-  int num_bytes = 0;
-  int byte_index = 0;
-  int current_value = -1;
-  uint_fast64_t result = 0;
-  int shift = 0;
-  while (1) {
-    if (feof(primes)) {
-      break;
+// Adds every prime up to target, which must be no more than 2^32, to the base
+// primes. Each step sieves with the primes already found, so it reaches at
+// most the square of the current limit. The caller must hold extend_lock.
+void ExtendBasePrimes(uint_fast64_t target, BasePrimes* base) {
+  uint64_t* sieve = malloc(L1_CACHE_BYTES);
+  if (sieve == NULL) {
+    printf("Unable to allocate space for the sieve.\n");
+    exit(1);
+  }
+  while (base->limit < target) {
+    uint_fast64_t next_limit = base->limit * base->limit;
+    if (next_limit > target) {
+      next_limit = target;
     }
+    // Sieve the odd numbers above the old limit up to next_limit.
+    uint_fast64_t low = base->limit + 1 + base->limit % 2;
+    while (low <= next_limit) {
+      int num_bits = L1_SEGMENT_BITS;
+      if ((next_limit - low) / 2 + 1 < num_bits) {
+        num_bits = (next_limit - low) / 2 + 1;
+      }
+      SieveSegment(low, num_bits, base, base->num_primes, sieve);
+      int i;
+      for (i = NextUnmarked(sieve, num_bits, 0); i < num_bits;
+           i = NextUnmarked(sieve, num_bits, i + 1)) {
+        size_t chunk = base->num_primes / BASE_CHUNK_PRIMES;
+        if (base->num_primes % BASE_CHUNK_PRIMES == 0) {
+          base->chunks[chunk] = malloc(BASE_CHUNK_PRIMES * sizeof(uint32_t));
+          if (base->chunks[chunk] == NULL) {
+            printf("Unable to allocate space for base primes.\n");
+            exit(1);
+          }
+        }
+        base->chunks[chunk][base->num_primes % BASE_CHUNK_PRIMES] =
+            low + 2 * (uint_fast64_t) i;
+        base->num_primes++;
+      }
+      low += 2 * (uint_fast64_t) num_bits;
+    }
+    base->limit = next_limit;
+  }
+  free(sieve);
+}
+
+// In Miller-Rabin mode the segments are only sieved with the base primes up
+// to this limit, and whatever is left is checked with IsPrime64.
+#define PRE_SIEVE_LIMIT (1 << 16)
+
+// Returns 1 if base primes up to limit are not enough to sieve up to high.
+int NeedsMoreBasePrimes(uint_fast64_t limit, uint_fast64_t high,
+                        int use_miller_rabin) {
+  return (unsigned __int128) limit * limit < high &&
+         (!use_miller_rabin || limit < PRE_SIEVE_LIMIT);
+}
 
-    if (current == '#') {
-      state = 10;
+// Grows the base primes as needed to sieve up to high, then returns their
+// limit and sets num_primes to how many of them can be read.
+uint_fast64_t GetBasePrimes(uint_fast64_t high, int use_miller_rabin,
+                            BasePrimes* base, size_t* num_primes) {
+  pthread_mutex_lock(&base->lock);
+  uint_fast64_t limit = base->published_limit;
+  *num_primes = base->published_primes;
+  pthread_mutex_unlock(&base->lock);
+  if (!NeedsMoreBasePrimes(limit, high, use_miller_rabin)) {
+    return limit;
+  }
+
+  pthread_mutex_lock(&base->extend_lock);
+  while (NeedsMoreBasePrimes(base->limit, high, use_miller_rabin)) {
+    uint_fast64_t target = 2 * base->limit;
+    ExtendBasePrimes(target < 0x100000000 ? target : 0x100000000, base);
+  }
+  pthread_mutex_lock(&base->lock);
+  base->published_primes = base->num_primes;
+  base->published_limit = base->limit;
+  limit = base->limit;
+  *num_primes = base->num_primes;
+  pthread_mutex_unlock(&base->lock);
+  pthread_mutex_unlock(&base->extend_lock);
+  return limit;
+}
+
+// Returns a * b / 2^64 mod n for a and b less than the odd modulus n, where
+// inverse is 1 / n mod 2^64. This Montgomery product stands in for a 128 bit
+// division.
+uint64_t MontMul(uint64_t a, uint64_t b, uint64_t n, uint64_t inverse) {
+  unsigned __int128 t = (unsigned __int128) a * b;
+  // m * n matches t in the low 64 bits, so t - m * n is a multiple of 2^64.
+  uint64_t m = (uint64_t) t * inverse;
+  uint64_t t_high = t >> 64;
+  uint64_t mn_high = ((unsigned __int128) m * n) >> 64;
+  uint64_t result = t_high - mn_high;
+  if (t_high < mn_high) {
+    result += n;
+  }
+  return result;
+}
+
+// Deterministic Miller-Rabin test for 64 bit numbers. Returns 1 if n is
+// prime. The seven bases found by Jim Sinclair leave no 64 bit strong
+// pseudoprimes, and all the modular arithmetic is done in Montgomery form.
+int IsPrime64(uint64_t n) {
+  static const uint64_t kSmallPrimes[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29,
+                                          31, 37};
+  static const uint64_t kBases[] = {2, 325, 9375, 28178, 450775, 9780504,
+                                    1795265022};
+  int i;
+  if (n < 2) {
+    return 0;
+  }
+  for (i = 0; i < sizeof(kSmallPrimes) / sizeof(kSmallPrimes[0]); i++) {
+    if (n % kSmallPrimes[i] == 0) {
+      return n == kSmallPrimes[i];
     }
+  }
+  if (n < 41 * 41) {
+    return 1;
+  }
 
-    if (state == 10) {
-      if (current == '\n') {
-        state = 0;
-      }
-      current = fgetc(primes);
+  // n - 1 = d * 2^s with d odd.
+  uint64_t d = n - 1;
+  int s = __builtin_ctzll(d);
+  d >>= s;
+
+  // Newton's iteration doubles the number of correct low bits each step,
+  // and n is its own inverse mod 8.
+  uint64_t inverse = n;
+  for (i = 0; i < 5; i++) {
+    inverse *= 2 - n * inverse;
+  }
+  // 1 and -1 in Montgomery form, as 2^64 mod n and n minus that.
+  uint64_t one = -n % n;
+  uint64_t minus_one = n - one;
+
+  int b;
+  for (b = 0; b < sizeof(kBases) / sizeof(kBases[0]); b++) {
+    uint64_t base = kBases[b] % n;
+    if (base == 0) {
       continue;
     }
-
-    current_value = HexCharToNibble(current);
-    if (current_value == -1) {
-      // Skip over non hex characters.
-      current = fgetc(primes);
+    uint64_t power = ((unsigned __int128) base << 64) % n;
+    uint64_t x = one;
+    uint64_t exponent;
+    for (exponent = d; exponent > 0; exponent >>= 1) {
+      if (exponent & 1) {
+        x = MontMul(x, power, n, inverse);
+      }
+      power = MontMul(power, power, n, inverse);
+    }
+    if (x == one || x == minus_one) {
       continue;
     }
-
-    switch (state) {
-      // First char of 8 in the num_bytes.
-      case 0:
-        num_bytes = current_value << 4;
-        state = 1;
-        break;
-      case 1:
-        num_bytes += current_value;
-        state = 2;
-        break;
-      case 2:
-        num_bytes += current_value << 12;
-        state = 3;
-        break;
-      case 3:
-        num_bytes += current_value << 8;
-        state = 8;
-        break;
-      case 4:
-        num_bytes += current_value << 20;
-        state = 5;
-        break;
-      case 5:
-        num_bytes += current_value << 16;
-        state = 6;
-        break;
-      case 6:
-        num_bytes += current_value << 28;
-        state = 7;
-        break;
-      case 7:
-        num_bytes += current_value << 24;
-        state = 8;  // Reached the end of num_bytes;
-        result = 0;
-        byte_index = 0;
-        break;
-      case 8:
-        result += ((current_value << 4) << shift);
-        state = 9;
-        break;
-      case 9:
-        result += (current_value << shift);
-        byte_index++;
-        shift += 8;
-        if (byte_index < num_bytes) {
-          state = 8;
-        } else {
-          return result;
-        }
-        break;
-      case 10:
-        break;
+    int j;
+    for (j = 1; j < s && x != minus_one; j++) {
+      x = MontMul(x, x, n, inverse);
+    }
+    if (x != minus_one) {
+      return 0;
     }
-    current = fgetc(primes);
   }
-  return 0;
+  return 1;
 }
 
+// Reads the last prime from the end of the file, so resuming takes the same
+// time however many primes have been found. A file converted to the binary
+// format is resumed from too, with new primes appended to it as text.
 uint_fast64_t FindHighestPrime(char* filename) {
-  FILE* primes = fopen(filename, "r");
-  if (primes == NULL) {
-    return 0;
-  }
-
-  uint_fast64_t next_prime = LoadNextPrime(primes);
-  uint_fast64_t result;
-  while (next_prime != 0) {
-    result = next_prime;
-    next_prime = LoadNextPrime(primes);
+  LargeUInt prime = {0};
+  ReadHighestPrime(filename, &prime);
+  if (LargeUIntNumBytes(&prime) > 8) {
+    printf("The last prime in %s does not fit in 64 bits.\n", filename);
+    exit(1);
   }
-  fclose(primes);
+  uint_fast64_t result = LargeUIntGetWord(&prime);
+  LargeUIntFree(&prime);
   return result;
 }
 
@@ -193,29 +341,230 @@ void AppendPrime(char* filename, uint_fast64_t prime) {
   fclose(primes);
 }
 
-void GeneratePrimes(char* filename) {
+// By default the primes file is flushed to disk after this many new primes,
+// or this long after the first of them was found.
+#define DEFAULT_FLUSH_PRIMES 1000000
+#define DEFAULT_FLUSH_MS 1000
+
+typedef struct {
+  int use_miller_rabin;
+  int num_threads;
+  int flush_primes;
+  int flush_ms;
+  // When set, primes go to this gap encoded archive instead of the primes
+  // file.
+  char* archive;
+} Options;
+
+typedef struct {
+  BatchWriter writer;
+  // Only used when writing an archive, in which case block output holds the
+  // primes as uint64_t values rather than lines.
+  int use_archive;
+  PrimeArchiveWriter archive;
+  time_t last_report;
+  int use_miller_rabin;
+  // The first odd number after the highest prime already in the file.
+  uint_fast64_t first;
+  BasePrimes base;
+} Finder;
+
+// Finds the primes among the L2_SEGMENT_BITS odd numbers that make up the
+// block and adds them to output. Returns 0 once the block starts past
+// the last odd number that fits in 64 bits, or once asked to stop.
+int SieveBlock(long block, void* context, BlockOutput* output) {
+  Finder* finder = context;
+  if (BatchWriterStopRequested()) {
+    return 0;
+  }
+  unsigned __int128 block_low = finder->first +
+      (unsigned __int128) 2 * L2_SEGMENT_BITS * block;
+  if (block_low > UINT64_MAX) {
+    return 0;
+  }
+  uint_fast64_t low = block_low;
+  int num_bits = L2_SEGMENT_BITS;
+  uint_fast64_t remaining = (UINT64_MAX - low) / 2 + 1;
+  if (remaining < num_bits) {
+    num_bits = remaining;
+  }
+  uint_fast64_t high = low + 2 * (uint_fast64_t) (num_bits - 1);
+  size_t num_primes;
+  uint_fast64_t limit = GetBasePrimes(high, finder->use_miller_rabin,
+                                      &finder->base, &num_primes);
+
+  // Sieve L1 sized pieces of the block while the base primes are small.
+  int segment_bits = L1_SEGMENT_BITS;
+  if (limit > 2 * (uint_fast64_t) L1_SEGMENT_BITS) {
+    segment_bits = L2_SEGMENT_BITS;
+  }
+  uint64_t* sieve = malloc(L2_CACHE_BYTES);
+  if (sieve == NULL) {
+    printf("Unable to allocate space for the sieve.\n");
+    exit(1);
+  }
+  char line[BIG_INT_LINE_SIZE];
+  int start;
+  for (start = 0; start < num_bits; start += segment_bits) {
+    int segment_size = num_bits - start;
+    if (segment_size > segment_bits) {
+      segment_size = segment_bits;
+    }
+    uint_fast64_t segment_low = low + 2 * (uint_fast64_t) start;
+    SieveSegment(segment_low, segment_size, &finder->base, num_primes, sieve);
+    int i;
+    for (i = NextUnmarked(sieve, segment_size, 0); i < segment_size;
+         i = NextUnmarked(sieve, segment_size, i + 1)) {
+      uint_fast64_t candidate = segment_low + 2 * (uint_fast64_t) i;
+      // Anything up to the square of the base limit is fully sieved.
+      if ((unsigned __int128) limit * limit < candidate &&
+          !IsPrime64(candidate)) {
+        continue;
+      }
+      if (finder->use_archive) {
+        uint64_t value = candidate;
+        BlockOutputAppend((char*) &value, sizeof(value), output);
+      } else {
+        BlockOutputAppend(line, BigIntStore(candidate, line), output);
+      }
+    }
+  }
+  free(sieve);
+  return 1;
+}
+
+// Queues the lines of a finished block to be appended to the primes file, or
+// adds its primes to the archive.
+void CommitBlock(long block, const BlockOutput* output, void* context) {
+  Finder* finder = context;
+  if (!finder->use_archive) {
+    BatchWriterAppend(output->data, output->size, &finder->writer);
+    return;
+  }
+  const uint64_t* primes = (const uint64_t*) output->data;
+  size_t num_primes = output->size / sizeof(uint64_t);
+  size_t i;
+  for (i = 0; i < num_primes; i++) {
+    PrimeArchiveWrite(primes[i], &finder->archive);
+  }
+  // Report progress once a second.
+  time_t now = time(NULL);
+  if (num_primes > 0 && now != finder->last_report) {
+    finder->last_report = now;
+    printf("Found primes through: ");
+    BigIntPrint(primes[num_primes - 1], stdout);
+    fflush(stdout);
+  }
+}
+
+// Appends primes to the file from the first one after the highest prime in
+// it. With use_miller_rabin set, segments are only pre-sieved with primes up
+// to PRE_SIEVE_LIMIT and the survivors are checked with IsPrime64, which
+// avoids building base primes all the way to 2^32 near the top of the range.
+// The range is split into blocks that several threads sieve at once, and
+// blocks are appended in order so the file always ends on a whole block.
+// SIGINT and SIGTERM stop the search once the blocks before are written.
+void GeneratePrimes(char* filename, const Options* options) {
+  Finder finder;
+  memset(&finder, 0, sizeof(finder));
+
   // Start by finding the higest prime that we have so far.
   printf("Looking for highest prime already found.\n");
-  uint_fast64_t candidate = FindHighestPrime(filename);
+  uint_fast64_t highest;
+  if (options->archive != NULL) {
+    finder.use_archive = 1;
+    PrimeArchiveWriterOpen(options->archive, &finder.archive);
+    highest = PrimeArchiveWriterLastPrime(&finder.archive);
+  } else {
+    highest = FindHighestPrime(filename);
+  }
   printf("Starting from highest prime found so far: ");
-  BigIntPrint(candidate, stdout);
+  BigIntPrint(highest, stdout);
 
-  uint_fast64_t first_candidate = candidate;
-  uint_fast64_t prime;
+  if (highest < 2) {
+    if (finder.use_archive) {
+      PrimeArchiveWrite(2, &finder.archive);
+    } else {
+      AppendPrime(filename, 2);
+    }
+  }
+
+  finder.use_miller_rabin = options->use_miller_rabin;
+  finder.first = (highest + 1) | 1;
+  finder.base.limit = 2;
+  finder.base.published_limit = 2;
+  pthread_mutex_init(&finder.base.extend_lock, NULL);
+  pthread_mutex_init(&finder.base.lock, NULL);
 
-  // Add two to start trying new primes.
-  candidate += 2;
+  if (!finder.use_archive) {
+    BatchWriterOpen(filename, options->flush_primes, options->flush_ms,
+                    &finder.writer);
+  }
+  BatchWriterCatchSignals();
+  RunBlockPipeline(options->num_threads, SieveBlock, CommitBlock, NULL,
+                   &finder);
+  if (finder.use_archive) {
+    printf("Archived primes through: ");
+    BigIntPrint(PrimeArchiveWriterLastPrime(&finder.archive), stdout);
+    PrimeArchiveWriterClose(&finder.archive);
+  } else {
+    BatchWriterClose(&finder.writer);
+  }
+  if (BatchWriterStopRequested()) {
+    printf("Stopped, every prime found has been saved.\n");
+  }
 
-  while(candidate > first_candidate) {
-    prime = FindNearbyPrime(candidate);
-    AppendPrime(filename, prime);
-    printf("Found prime: ");
-    BigIntPrint(prime, stdout);
-    candidate = prime + 2;
+  size_t i;
+  for (i = 0; i * BASE_CHUNK_PRIMES < finder.base.num_primes; i++) {
+    free(finder.base.chunks[i]);
   }
+  pthread_mutex_destroy(&finder.base.extend_lock);
+  pthread_mutex_destroy(&finder.base.lock);
 }
 
-int main() {
-  GeneratePrimes("primes");
+// Returns the value of text as a count, or -1 if it is not one.
+int ParseCount(char* text) {
+  char* end;
+  long value = strtol(text, &end, 10);
+  if (end == text || *end != '\0' || value < 0 || value > INT32_MAX) {
+    return -1;
+  }
+  return value;
 }
 
+int main(int argc, char *argv[]) {
+  Options options = {0, 1, DEFAULT_FLUSH_PRIMES, DEFAULT_FLUSH_MS, NULL};
+  int i;
+  for (i = 1; i < argc; i++) {
+    int value = i + 1 < argc ? ParseCount(argv[i + 1]) : -1;
+    if (strcmp(argv[i], "--miller-rabin") == 0) {
+      options.use_miller_rabin = 1;
+    } else if (strcmp(argv[i], "-j") == 0 && value > 0) {
+      options.num_threads = value;
+      i++;
+    } else if (strcmp(argv[i], "--flush-primes") == 0 && value >= 0) {
+      options.flush_primes = value;
+      i++;
+    } else if (strcmp(argv[i], "--flush-ms") == 0 && value >= 0) {
+      options.flush_ms = value;
+      i++;
+    } else if (strcmp(argv[i], "--archive") == 0 && i + 1 < argc) {
+      options.archive = argv[i + 1];
+      i++;
+    } else {
+      printf("Usage: %s [--miller-rabin] [-j threads] [--flush-primes count]"
+             " [--flush-ms milliseconds] [--archive file]\n", argv[0]);
+      printf("With --miller-rabin, numbers left after sieving with small\n");
+      printf("primes are tested with deterministic Miller-Rabin.\n");
+      printf("With -j, blocks of numbers are sieved on that many threads.\n");
+      printf("New primes are flushed to disk once --flush-primes are\n");
+      printf("waiting or --flush-ms after the first, by default %d or %d.\n",
+             DEFAULT_FLUSH_PRIMES, DEFAULT_FLUSH_MS);
+      printf("Either may be 0 to leave it out.\n");
+      printf("With --archive, primes are kept in a gap encoded archive\n");
+      printf("instead of the primes file.\n");
+      return 1;
+    }
+  }
+  GeneratePrimes("primes", &options);
+}
@@ -0,0 +1,217 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "search-checkpoint.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+void Check(int condition, char* message) {
+  if (!condition) {
+    fprintf(stderr, "Condition failed: %s\n", message);
+    exit(1);
+  }
+}
+
+// Creates an empty temporary file and returns its name.
+char* MakeTempFile() {
+  static char filename[40];
+  strcpy(filename, "/tmp/search-checkpoint-testXXXXXX");
+  int fd = mkstemp(filename);
+  Check(fd >= 0, "Temporary file should open");
+  close(fd);
+  return filename;
+}
+
+// Returns the name of the file that holds the rejected candidates.
+char* RejectedFilename(char* filename) {
+  static char rejected_filename[50];
+  sprintf(rejected_filename, "%s.rejected", filename);
+  return rejected_filename;
+}
+
+// Reads the whole of the rejected file into a buffer the caller frees, and
+// sets size to its length.
+char* ReadRejected(char* filename, long* size) {
+  FILE* file = fopen(RejectedFilename(filename), "r");
+  Check(file != NULL, "The rejected file should open");
+  fseek(file, 0, SEEK_END);
+  *size = ftell(file);
+  rewind(file);
+  char* contents = malloc(*size + 1);
+  Check(fread(contents, 1, *size, file) == *size,
+        "The rejected file should be read");
+  contents[*size] = '\0';
+  fclose(file);
+  return contents;
+}
+
+void TestSaveAndLoad() {
+  char* filename = MakeTempFile();
+  SearchCheckpoint checkpoint = {0};
+  SearchCheckpointInit(filename, 1000000, &checkpoint);
+  LargeUInt candidate = {0};
+  LargeUInt max_divisor = {0};
+  LargeUInt tried_below = {0};
+  LargeUInt factor = {0};
+  LargeUIntSetWord(11, &tried_below);
+
+  // Enough rejected candidates to grow the list a few times.
+  uint64_t value = 1000000000000000001ULL;
+  int i;
+  for (i = 0; i < 40; i++) {
+    LargeUIntSetWord(value + 2 * i, &candidate);
+    LargeUIntApproximateSquareRoot(&candidate, &max_divisor);
+    SearchCheckpointStart(&candidate, &max_divisor, &tried_below,
+                          &checkpoint);
+    LargeUIntSetWord(13 + i, &factor);
+    SearchCheckpointReject(&factor, &checkpoint);
+  }
+  LargeUIntSetWord(value + 80, &candidate);
+  LargeUIntApproximateSquareRoot(&candidate, &max_divisor);
+  SearchCheckpointStart(&candidate, &max_divisor, &tried_below, &checkpoint);
+  LargeUIntSetWord(1 << 20, &tried_below);
+  SearchCheckpointTried(&tried_below, &checkpoint);
+  SearchCheckpointSave(&checkpoint);
+  SearchCheckpointFree(&checkpoint);
+
+  char* temp_filename = malloc(strlen(filename) + 5);
+  sprintf(temp_filename, "%s.tmp", filename);
+  Check(access(temp_filename, F_OK) != 0,
+        "The temporary file should have been renamed");
+  free(temp_filename);
+
+  SearchCheckpoint loaded = {0};
+  Check(SearchCheckpointLoad(filename, 1000000, &loaded),
+        "Saved checkpoint should load");
+  Check(LargeUIntEqual(&loaded.candidate, &candidate),
+        "Candidate should be restored");
+  Check(LargeUIntEqual(&loaded.max_divisor, &max_divisor),
+        "Maximum divisor should be restored");
+  Check(LargeUIntEqual(&loaded.tried_below, &tried_below),
+        "Progress should be restored");
+  Check(loaded.num_rejected == 40, "Every rejected candidate should be kept");
+  int all_match = 1;
+  for (i = 0; i < 40; i++) {
+    if (LargeUIntGetWord(&loaded.rejected[i]) != value + 2 * i ||
+        LargeUIntGetWord(&loaded.rejected_by[i]) != 13 + i) {
+      all_match = 0;
+    }
+  }
+  Check(all_match, "Rejected candidates and factors should be restored");
+  SearchCheckpointFree(&loaded);
+  unlink(filename);
+  unlink(RejectedFilename(filename));
+
+  Check(!SearchCheckpointLoad(filename, 1000, &loaded),
+        "A missing checkpoint should not load");
+  LargeUIntFree(&candidate);
+  LargeUIntFree(&max_divisor);
+  LargeUIntFree(&tried_below);
+  LargeUIntFree(&factor);
+}
+
+void TestSavesAreSpacedOut() {
+  char* filename = MakeTempFile();
+  SearchCheckpoint checkpoint = {0};
+  SearchCheckpointInit(filename, 1000000, &checkpoint);
+  LargeUInt value = {0};
+  LargeUIntSetWord(1000003, &value);
+  // The first save is due at once, and the next not for a long while.
+  SearchCheckpointStart(&value, &value, &value, &checkpoint);
+  LargeUIntSetWord(1000033, &value);
+  SearchCheckpointTried(&value, &checkpoint);
+  SearchCheckpointFree(&checkpoint);
+
+  SearchCheckpoint loaded = {0};
+  Check(SearchCheckpointLoad(filename, 1000000, &loaded),
+        "The first checkpoint should have been saved");
+  Check(LargeUIntGetWord(&loaded.tried_below) == 1000003,
+        "The second checkpoint should not have been saved yet");
+  SearchCheckpointFree(&loaded);
+  unlink(filename);
+  unlink(RejectedFilename(filename));
+  LargeUIntFree(&value);
+}
+
+void TestRejectedAreAppended() {
+  char* filename = MakeTempFile();
+  SearchCheckpoint checkpoint = {0};
+  SearchCheckpointInit(filename, 1000000, &checkpoint);
+  LargeUInt value = {0};
+  LargeUInt factor = {0};
+  LargeUIntSetWord(1000003, &value);
+  SearchCheckpointStart(&value, &value, &value, &checkpoint);
+  LargeUIntSetWord(3, &factor);
+  SearchCheckpointReject(&factor, &checkpoint);
+  SearchCheckpointSave(&checkpoint);
+  long first_size;
+  char* first = ReadRejected(filename, &first_size);
+
+  // A second save adds just the one line for the new rejected candidate.
+  LargeUIntSetWord(1000005, &value);
+  SearchCheckpointStart(&value, &value, &value, &checkpoint);
+  LargeUIntSetWord(5, &factor);
+  SearchCheckpointReject(&factor, &checkpoint);
+  SearchCheckpointSave(&checkpoint);
+  long second_size;
+  char* second = ReadRejected(filename, &second_size);
+  Check(memcmp(first, second, first_size) == 0,
+        "Saved rejected candidates should not be written again");
+  Check(strchr(second + first_size, '\n') == second + second_size - 1,
+        "Only the new rejected candidate should be appended");
+  SearchCheckpointSave(&checkpoint);
+  free(second);
+  second = ReadRejected(filename, &second_size);
+  Check(strchr(second + first_size, '\n') == second + second_size - 1,
+        "A save with nothing new should append nothing");
+  SearchCheckpointFree(&checkpoint);
+
+  // Lines from a save that did not finish are ignored, and then replaced.
+  FILE* rejected = fopen(RejectedFilename(filename), "a");
+  fprintf(rejected, "0100_07 0100_07 # not saved\n");
+  fclose(rejected);
+  SearchCheckpoint loaded = {0};
+  Check(SearchCheckpointLoad(filename, 1000000, &loaded),
+        "Saved checkpoint should load");
+  Check(loaded.num_rejected == 2,
+        "Lines past the saved length should be ignored");
+  LargeUIntSetWord(7, &factor);
+  SearchCheckpointReject(&factor, &loaded);
+  SearchCheckpointSave(&loaded);
+  SearchCheckpointFree(&loaded);
+  Check(SearchCheckpointLoad(filename, 1000000, &loaded),
+        "Saved checkpoint should load again");
+  Check(loaded.num_rejected == 3 &&
+        LargeUIntGetWord(&loaded.rejected[2]) == 1000005 &&
+        LargeUIntGetWord(&loaded.rejected_by[2]) == 7,
+        "A later save should replace the lines that were not saved");
+  SearchCheckpointFree(&loaded);
+
+  free(first);
+  free(second);
+  unlink(filename);
+  unlink(RejectedFilename(filename));
+  LargeUIntFree(&value);
+  LargeUIntFree(&factor);
+}
+
+int main(void) {
+  TestSaveAndLoad();
+  TestSavesAreSpacedOut();
+  TestRejectedAreAppended();
+  printf("All tests passed\n");
+}
@@ -0,0 +1,262 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "search-checkpoint.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static void ErrorOut(char* message) {
+  fprintf(stderr, "%s\n", message);
+  exit(1);
+}
+
+// Starts the rejected file, before the first rejected candidate.
+#define REJECTED_HEADER "# Candidates rejected by the next prime search.\n"
+
+void SearchCheckpointInit(const char* filename, int interval_ms,
+                          SearchCheckpoint* checkpoint) {
+  checkpoint->filename_ = strdup(filename);
+  checkpoint->rejected_filename_ = malloc(strlen(filename) + 10);
+  if (checkpoint->filename_ == NULL ||
+      checkpoint->rejected_filename_ == NULL) {
+    ErrorOut("Unable to allocate space for the checkpoint.");
+  }
+  sprintf(checkpoint->rejected_filename_, "%s.rejected", filename);
+  checkpoint->interval_ms_ = interval_ms;
+  // A zero last save makes the first save due straight away.
+  memset(&checkpoint->last_save_, 0, sizeof(struct timespec));
+}
+
+// Appends a rejected candidate and its factor.
+static void AddRejected(const LargeUInt* candidate, const LargeUInt* factor,
+                        SearchCheckpoint* checkpoint) {
+  if (checkpoint->num_rejected == checkpoint->max_rejected_) {
+    // LargeUInts may point into themselves, so they are cloned into the
+    // bigger arrays rather than moved by realloc.
+    int max_rejected = checkpoint->max_rejected_ == 0
+                           ? 16
+                           : 2 * checkpoint->max_rejected_;
+    LargeUInt* rejected = calloc(max_rejected, sizeof(LargeUInt));
+    LargeUInt* rejected_by = calloc(max_rejected, sizeof(LargeUInt));
+    if (rejected == NULL || rejected_by == NULL) {
+      ErrorOut("Unable to allocate space for the rejected candidates.");
+    }
+    int i;
+    for (i = 0; i < checkpoint->max_rejected_; i++) {
+      LargeUIntClone(&checkpoint->rejected[i], &rejected[i]);
+      LargeUIntClone(&checkpoint->rejected_by[i], &rejected_by[i]);
+      LargeUIntFree(&checkpoint->rejected[i]);
+      LargeUIntFree(&checkpoint->rejected_by[i]);
+    }
+    free(checkpoint->rejected);
+    free(checkpoint->rejected_by);
+    checkpoint->rejected = rejected;
+    checkpoint->rejected_by = rejected_by;
+    checkpoint->max_rejected_ = max_rejected;
+  }
+  LargeUIntClone(candidate, &checkpoint->rejected[checkpoint->num_rejected]);
+  LargeUIntClone(factor, &checkpoint->rejected_by[checkpoint->num_rejected]);
+  checkpoint->num_rejected++;
+}
+
+// Adds the rejected candidates held in the first size bytes of the rejected
+// file.
+static void LoadRejected(long size, SearchCheckpoint* checkpoint) {
+  FILE* in = fopen(checkpoint->rejected_filename_, "r");
+  if (in == NULL) {
+    ErrorOut("Unable to open the rejected candidates of the checkpoint.");
+  }
+  char* contents = malloc(size);
+  if (contents == NULL) {
+    ErrorOut("Unable to allocate space for the rejected candidates.");
+  }
+  if (fread(contents, 1, size, in) != size ||
+      strncmp(contents, REJECTED_HEADER, strlen(REJECTED_HEADER)) != 0) {
+    ErrorOut("Invalid checkpoint file.");
+  }
+  fclose(in);
+
+  // Only the saved part is parsed, whatever follows it in the file.
+  in = fmemopen(contents, size, "r");
+  if (in == NULL) {
+    ErrorOut("Unable to read the rejected candidates of the checkpoint.");
+  }
+  LargeUInt rejected = {0};
+  LargeUInt factor = {0};
+  while (1) {
+    LargeUIntRead(in, &rejected);
+    if (LargeUIntNumBytes(&rejected) == 0) {
+      break;
+    }
+    LargeUIntRead(in, &factor);
+    if (LargeUIntNumBytes(&factor) == 0) {
+      ErrorOut("Invalid checkpoint file.");
+    }
+    AddRejected(&rejected, &factor, checkpoint);
+  }
+  LargeUIntFree(&rejected);
+  LargeUIntFree(&factor);
+  fclose(in);
+  free(contents);
+}
+
+int SearchCheckpointLoad(const char* filename, int interval_ms,
+                         SearchCheckpoint* checkpoint) {
+  FILE* in = fopen(filename, "r");
+  if (in == NULL) {
+    return 0;
+  }
+  SearchCheckpointInit(filename, interval_ms, checkpoint);
+  LargeUInt rejected_size = {0};
+  LargeUIntRead(in, &checkpoint->candidate);
+  LargeUIntRead(in, &checkpoint->max_divisor);
+  LargeUIntRead(in, &checkpoint->tried_below);
+  LargeUIntRead(in, &rejected_size);
+  if (LargeUIntNumBytes(&checkpoint->candidate) == 0 ||
+      LargeUIntNumBytes(&checkpoint->max_divisor) == 0 ||
+      LargeUIntNumBytes(&checkpoint->tried_below) == 0 ||
+      LargeUIntNumBytes(&rejected_size) == 0 ||
+      LargeUIntNumBytes(&rejected_size) > 4) {
+    ErrorOut("Invalid checkpoint file.");
+  }
+  fclose(in);
+  checkpoint->rejected_size_ = LargeUIntGetWord(&rejected_size);
+  LargeUIntFree(&rejected_size);
+  LoadRejected(checkpoint->rejected_size_, checkpoint);
+  checkpoint->num_saved_ = checkpoint->num_rejected;
+  return 1;
+}
+
+// Saves the checkpoint if interval_ms have passed since the last save.
+static void SaveIfDue(SearchCheckpoint* checkpoint) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  long long elapsed_ms =
+      (now.tv_sec - checkpoint->last_save_.tv_sec) * 1000LL +
+      (now.tv_nsec - checkpoint->last_save_.tv_nsec) / 1000000;
+  if (elapsed_ms >= checkpoint->interval_ms_) {
+    SearchCheckpointSave(checkpoint);
+  }
+}
+
+void SearchCheckpointStart(const LargeUInt* candidate,
+                           const LargeUInt* max_divisor,
+                           const LargeUInt* tried_below,
+                           SearchCheckpoint* checkpoint) {
+  LargeUIntClone(candidate, &checkpoint->candidate);
+  LargeUIntClone(max_divisor, &checkpoint->max_divisor);
+  LargeUIntClone(tried_below, &checkpoint->tried_below);
+  SaveIfDue(checkpoint);
+}
+
+void SearchCheckpointTried(const LargeUInt* tried_below,
+                           SearchCheckpoint* checkpoint) {
+  LargeUIntClone(tried_below, &checkpoint->tried_below);
+  SaveIfDue(checkpoint);
+}
+
+void SearchCheckpointReject(const LargeUInt* factor,
+                            SearchCheckpoint* checkpoint) {
+  AddRejected(&checkpoint->candidate, factor, checkpoint);
+}
+
+// Appends the candidates rejected since the last save to the rejected file,
+// and syncs it.
+static void SaveRejected(SearchCheckpoint* checkpoint) {
+  if (checkpoint->rejected_size_ > 0 &&
+      checkpoint->num_saved_ == checkpoint->num_rejected) {
+    return;
+  }
+  // Writing from the saved length on replaces whatever an unfinished save
+  // left after it.
+  FILE* out = checkpoint->rejected_size_ == 0
+                  ? fopen(checkpoint->rejected_filename_, "w")
+                  : fopen(checkpoint->rejected_filename_, "r+");
+  if (out == NULL ||
+      fseek(out, checkpoint->rejected_size_, SEEK_SET) != 0) {
+    ErrorOut("Unable to open the rejected candidates of the checkpoint.");
+  }
+  if (checkpoint->rejected_size_ == 0) {
+    fputs(REJECTED_HEADER, out);
+  }
+  int i;
+  for (i = checkpoint->num_saved_; i < checkpoint->num_rejected; i++) {
+    LargeUIntPrint(&checkpoint->rejected[i], out);
+    fprintf(out, " ");
+    LargeUIntPrint(&checkpoint->rejected_by[i], out);
+    fprintf(out, " # rejected, with its factor\n");
+  }
+  long size = ftell(out);
+  if (ferror(out) || fflush(out) != 0 || fsync(fileno(out)) != 0 ||
+      fclose(out) != 0) {
+    ErrorOut("Unable to write the rejected candidates of the checkpoint.");
+  }
+  checkpoint->num_saved_ = checkpoint->num_rejected;
+  checkpoint->rejected_size_ = size;
+}
+
+void SearchCheckpointSave(SearchCheckpoint* checkpoint) {
+  SaveRejected(checkpoint);
+  char* temp_filename = malloc(strlen(checkpoint->filename_) + 5);
+  if (temp_filename == NULL) {
+    ErrorOut("Unable to allocate space for the checkpoint.");
+  }
+  sprintf(temp_filename, "%s.tmp", checkpoint->filename_);
+  FILE* out = fopen(temp_filename, "w");
+  if (out == NULL) {
+    ErrorOut("Unable to open the checkpoint file.");
+  }
+  LargeUInt rejected_size = {0};
+  LargeUIntSetWord(checkpoint->rejected_size_, &rejected_size);
+  fprintf(out, "# Next prime search checkpoint.\n");
+  LargeUIntPrint(&checkpoint->candidate, out);
+  fprintf(out, " # candidate\n");
+  LargeUIntPrint(&checkpoint->max_divisor, out);
+  fprintf(out, " # maximum divisor\n");
+  LargeUIntPrint(&checkpoint->tried_below, out);
+  fprintf(out, " # every divisor below this has been tried\n");
+  LargeUIntPrint(&rejected_size, out);
+  fprintf(out, " # length of the rejected file\n");
+  LargeUIntFree(&rejected_size);
+  if (ferror(out) || fflush(out) != 0 || fsync(fileno(out)) != 0 ||
+      fclose(out) != 0) {
+    ErrorOut("Unable to write the checkpoint file.");
+  }
+  if (rename(temp_filename, checkpoint->filename_) != 0) {
+    ErrorOut("Unable to replace the checkpoint file.");
+  }
+  free(temp_filename);
+  clock_gettime(CLOCK_MONOTONIC, &checkpoint->last_save_);
+}
+
+void SearchCheckpointFree(SearchCheckpoint* checkpoint) {
+  int i;
+  for (i = 0; i < checkpoint->max_rejected_; i++) {
+    LargeUIntFree(&checkpoint->rejected[i]);
+    LargeUIntFree(&checkpoint->rejected_by[i]);
+  }
+  free(checkpoint->rejected);
+  free(checkpoint->rejected_by);
+  free(checkpoint->filename_);
+  free(checkpoint->rejected_filename_);
+  LargeUIntFree(&checkpoint->candidate);
+  LargeUIntFree(&checkpoint->max_divisor);
+  LargeUIntFree(&checkpoint->tried_below);
+  memset(checkpoint, 0, sizeof(SearchCheckpoint));
+}
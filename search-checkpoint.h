@@ -0,0 +1,92 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SEARCH_CHECKPOINT_H
+#define SEARCH_CHECKPOINT_H
+
+#include "large-u-int.h"
+
+#include <time.h>
+
+// The progress of a search for the next prime from some starting point, saved
+// from time to time so that it can carry on after a restart. The file holds
+// one value per line in the LargeUInt text format, each followed by a comment
+// saying what it is: the candidate, its maximum divisor, the point below
+// which every divisor has been tried on it, and the length of the rejected
+// file. None of these values is ever 0.
+//
+// The earlier candidates, each along with the factor that ruled it out, are
+// kept in filename.rejected after a comment line. Each save appends only the
+// ones rejected since the last save and syncs them. Then the rest goes to
+// filename.tmp, which is synced and renamed over filename, so the file always
+// holds one whole checkpoint or another. Anything in the rejected file past
+// the length that filename gives is left from a save that did not finish, and
+// is ignored.
+
+typedef struct {
+  LargeUInt candidate;
+  LargeUInt max_divisor;
+  LargeUInt tried_below;
+  // The candidates ruled out so far, and a factor of each.
+  int num_rejected;
+  LargeUInt* rejected;
+  LargeUInt* rejected_by;
+  char* filename_;
+  char* rejected_filename_;
+  int interval_ms_;
+  int max_rejected_;
+  // How many of the rejected candidates have been saved, and the length of
+  // the rejected file holding them, which is 0 before it is written.
+  int num_saved_;
+  long rejected_size_;
+  struct timespec last_save_;
+} SearchCheckpoint;
+
+// Sets up an empty checkpoint that saves to filename no more often than every
+// interval_ms. The checkpoint must start out zeroed.
+void SearchCheckpointInit(const char* filename, int interval_ms,
+                          SearchCheckpoint* checkpoint);
+
+// Sets up a checkpoint from the one saved in filename, and saves back there.
+// Returns 0 if the file cannot be opened, and exits if it is not a
+// checkpoint.
+int SearchCheckpointLoad(const char* filename, int interval_ms,
+                         SearchCheckpoint* checkpoint);
+
+// Moves the checkpoint on to a new candidate, on which every divisor below
+// tried_below has been tried, and saves it if it is due.
+void SearchCheckpointStart(const LargeUInt* candidate,
+                           const LargeUInt* max_divisor,
+                           const LargeUInt* tried_below,
+                           SearchCheckpoint* checkpoint);
+
+// Records that every divisor below tried_below has been tried on the
+// candidate, and saves the checkpoint if it is due.
+void SearchCheckpointTried(const LargeUInt* tried_below,
+                           SearchCheckpoint* checkpoint);
+
+// Adds the candidate to the rejected ones, along with the factor that ruled
+// it out.
+void SearchCheckpointReject(const LargeUInt* factor,
+                            SearchCheckpoint* checkpoint);
+
+// Saves the checkpoint now.
+void SearchCheckpointSave(SearchCheckpoint* checkpoint);
+
+// Releases everything held by the checkpoint.
+void SearchCheckpointFree(SearchCheckpoint* checkpoint);
+
+#endif
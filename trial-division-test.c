@@ -0,0 +1,175 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "trial-division.h"
+#include "wheel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+void Check(int condition, char* message) {
+  if (!condition) {
+    fprintf(stderr, "Condition failed: %s\n", message);
+    exit(1);
+  }
+}
+
+int IsPrime(uint64_t value, int num_threads) {
+  LargeUInt candidate = {0};
+  LargeUInt max_divisor = {0};
+  LargeUIntSetWord(value, &candidate);
+  LargeUIntApproximateSquareRoot(&candidate, &max_divisor);
+  int is_prime = TrialDivisionIsPrime(&candidate, &max_divisor, num_threads);
+  LargeUIntFree(&candidate);
+  LargeUIntFree(&max_divisor);
+  return is_prime;
+}
+
+int SlowIsPrime(uint64_t value) {
+  uint64_t divisor;
+  for (divisor = 2; divisor * divisor <= value; divisor++) {
+    if (value % divisor == 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+void TestSmallCandidates(int num_threads) {
+  // Every number on the wheel up to 5000 is checked.
+  Wheel wheel;
+  uint64_t value = WHEEL_FIRST_DIVISOR;
+  WheelStart(WHEEL_FIRST_DIVISOR, &wheel);
+  int all_match = 1;
+  while (value < 5000) {
+    if (IsPrime(value, num_threads) != SlowIsPrime(value)) {
+      all_match = 0;
+    }
+    value += WheelNext(&wheel);
+  }
+  Check(all_match, "Small candidates should be told apart correctly");
+}
+
+void TestLargeCandidates(int num_threads) {
+  // The square root of each spans several chunks, and the factors of the
+  // composite are both in the last of them.
+  Check(IsPrime(100000000000031ULL, num_threads),
+        "100000000000031 should be prime");
+  Check(!IsPrime(10000019ULL * 10000079ULL, num_threads),
+        "10000019 * 10000079 should not be prime");
+}
+
+void TestFirstDivisor() {
+  // Factors below the first divisor are not tried.
+  LargeUInt candidate = {0};
+  LargeUInt first = {0};
+  LargeUInt max_divisor = {0};
+  LargeUIntSetWord(11ULL * 10000079ULL, &candidate);
+  LargeUIntSetWord(13, &first);
+  LargeUIntApproximateSquareRoot(&candidate, &max_divisor);
+  Check(TrialDivisionIsPrimeFrom(&candidate, &first, &max_divisor, 1, NULL,
+                                 NULL, NULL),
+        "11 * 10000079 has no factor from 13 up to its square root");
+  LargeUIntSetWord(10000019ULL * 10000079ULL, &candidate);
+  LargeUIntSetWord(65537, &first);
+  LargeUIntApproximateSquareRoot(&candidate, &max_divisor);
+  Check(!TrialDivisionIsPrimeFrom(&candidate, &first, &max_divisor, 2, NULL,
+                                  NULL, NULL),
+        "10000019 * 10000079 should not be prime from 65537");
+  LargeUIntSetWord(10000020, &first);
+  Check(TrialDivisionIsPrimeFrom(&candidate, &first, &max_divisor, 2, NULL,
+                                 NULL, NULL),
+        "10000019 * 10000079 has no factor from 10000020 up");
+  LargeUIntFree(&candidate);
+  LargeUIntFree(&first);
+  LargeUIntFree(&max_divisor);
+}
+
+void TestFactor(int num_threads) {
+  LargeUInt candidate = {0};
+  LargeUInt first = {0};
+  LargeUInt max_divisor = {0};
+  LargeUInt factor = {0};
+  LargeUIntSetWord(10000019ULL * 10000079ULL, &candidate);
+  LargeUIntSetWord(WHEEL_FIRST_DIVISOR, &first);
+  LargeUIntApproximateSquareRoot(&candidate, &max_divisor);
+  TrialDivisionIsPrimeFrom(&candidate, &first, &max_divisor, num_threads, NULL,
+                           NULL, &factor);
+  Check(LargeUIntGetWord(&factor) == 10000019ULL,
+        "10000019 should be found as the factor");
+
+  LargeUIntSetWord(1000003ULL * 1000033ULL * 1000037ULL, &candidate);
+  LargeUIntApproximateSquareRoot(&candidate, &max_divisor);
+  TrialDivisionIsPrimeFrom(&candidate, &first, &max_divisor, num_threads, NULL,
+                           NULL, &factor);
+  Check(LargeUIntGetWord(&factor) > 1 &&
+        LargeUIntModWord(&candidate, LargeUIntGetWord(&factor)) == 0,
+        "The factor found should divide the candidate");
+  LargeUIntFree(&candidate);
+  LargeUIntFree(&first);
+  LargeUIntFree(&max_divisor);
+  LargeUIntFree(&factor);
+}
+
+// The progress reported so far, and whether it only ever went up.
+typedef struct {
+  LargeUInt tried_below;
+  int in_order;
+} Progress;
+
+void RecordProgress(const LargeUInt* tried_below, void* context) {
+  Progress* progress = context;
+  if (!LargeUIntLessThan(&progress->tried_below, tried_below)) {
+    progress->in_order = 0;
+  }
+  LargeUIntClone(tried_below, &progress->tried_below);
+}
+
+void TestProgress(int num_threads) {
+  LargeUInt candidate = {0};
+  LargeUInt first = {0};
+  LargeUInt max_divisor = {0};
+  Progress progress = {{0}, 1};
+  LargeUIntSetWord(100000000000031ULL, &candidate);
+  LargeUIntSetWord(WHEEL_FIRST_DIVISOR, &first);
+  LargeUIntClone(&first, &progress.tried_below);
+  LargeUIntApproximateSquareRoot(&candidate, &max_divisor);
+  TrialDivisionIsPrimeFrom(&candidate, &first, &max_divisor, num_threads,
+                           RecordProgress, &progress, NULL);
+  Check(progress.in_order, "Progress should only move forwards");
+  Check(LargeUIntLessThan(&max_divisor, &progress.tried_below),
+        "Progress should finish past the maximum divisor");
+  Check(LargeUIntModWord(&progress.tried_below, TRIAL_DIVISION_CHUNK_NUMBERS) ==
+        WHEEL_FIRST_DIVISOR,
+        "Progress should move a whole chunk at a time");
+  LargeUIntFree(&candidate);
+  LargeUIntFree(&first);
+  LargeUIntFree(&max_divisor);
+  LargeUIntFree(&progress.tried_below);
+}
+
+int main() {
+  TestSmallCandidates(1);
+  TestSmallCandidates(3);
+  TestLargeCandidates(1);
+  TestLargeCandidates(4);
+  TestFirstDivisor();
+  TestFactor(1);
+  TestFactor(3);
+  TestProgress(1);
+  TestProgress(4);
+  printf("\nAll tests passed\n");
+}
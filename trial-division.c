@@ -0,0 +1,323 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "trial-division.h"
+#include "wheel.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+// Divisors below 2^32 are tried this many at a time.
+#define SMALL_DIVISOR_BATCH 64
+
+// Marks a free place in the list of active chunks.
+#define NO_CHUNK UINT64_MAX
+
+static void ErrorOut(char* message) {
+  fprintf(stderr, "%s\n", message);
+  exit(1);
+}
+
+// The state shared by the threads searching one candidate. found is checked
+// before every division, and everything after lock is only touched while
+// holding it.
+typedef struct {
+  const LargeUInt* candidate;
+  const LargeUInt* max_divisor;
+  TrialDivisionProgress progress;
+  void* context;
+  atomic_int found;
+  // Held while progress is called, and the number of finished chunks it was
+  // last called for.
+  pthread_mutex_t progress_lock;
+  uint64_t num_done_reported;
+  pthread_mutex_t lock;
+  // The first factor found.
+  LargeUInt factor;
+  // The first number of the next chunk to hand out, and its index.
+  LargeUInt next_start;
+  uint64_t next_chunk;
+  // Every divisor below tried_below has been tried, which is the start of
+  // chunk num_done, the first chunk not yet finished. The chunks being worked
+  // on are listed in active, which has a place for each thread, with
+  // NO_CHUNK in the free places.
+  LargeUInt tried_below;
+  uint64_t num_done;
+  int num_threads;
+  uint64_t* active;
+  // How many numbers the finished chunks cover, the count at which the next
+  // x of the progress bar is printed and how many have been printed.
+  LargeUInt covered;
+  LargeUInt one_fiftieth_max;
+  LargeUInt next_reporting_milestone;
+  int num_reported;
+} Search;
+
+// Returns the value, or UINT64_MAX if it does not fit in one word.
+static uint64_t WordOrMax(const LargeUInt* value) {
+  return LargeUIntNumBytes(value) <= 8 ? LargeUIntGetWord(value) : UINT64_MAX;
+}
+
+// Takes the next chunk, setting start and end to its bounds and index to its
+// index. Returns 0 once the chunks have passed the maximum divisor.
+static int TakeChunk(Search* search, const LargeUInt* chunk_numbers,
+                     LargeUInt* start, LargeUInt* end, uint64_t* index) {
+  pthread_mutex_lock(&search->lock);
+  int taken = LargeUIntCompare(&search->next_start, search->max_divisor) >= 0;
+  if (taken) {
+    LargeUIntClone(&search->next_start, start);
+    LargeUIntAdd(chunk_numbers, &search->next_start);
+    LargeUIntClone(&search->next_start, end);
+    *index = search->next_chunk++;
+    int i = 0;
+    while (search->active[i] != NO_CHUNK) {
+      i++;
+    }
+    search->active[i] = *index;
+  }
+  pthread_mutex_unlock(&search->lock);
+  return taken;
+}
+
+// Records the factor unless another was found first.
+static void FoundFactor(Search* search, const LargeUInt* factor) {
+  pthread_mutex_lock(&search->lock);
+  if (!atomic_load(&search->found)) {
+    LargeUIntClone(factor, &search->factor);
+    atomic_store(&search->found, 1);
+  }
+  pthread_mutex_unlock(&search->lock);
+}
+
+// Calls progress with the latest tried_below, copied into the given one,
+// without holding the lock so that the other threads carry on while the
+// progress is saved. One thread reports at a time. A thread that finds another
+// one reporting leaves it to that one, which looks for more progress each
+// time it lets go.
+static void ReportProgress(Search* search, LargeUInt* tried_below) {
+  int more = 1;
+  while (more && pthread_mutex_trylock(&search->progress_lock) == 0) {
+    pthread_mutex_lock(&search->lock);
+    uint64_t num_done = search->num_done;
+    LargeUIntClone(&search->tried_below, tried_below);
+    pthread_mutex_unlock(&search->lock);
+    if (num_done > search->num_done_reported) {
+      search->progress(tried_below, search->context);
+      search->num_done_reported = num_done;
+    }
+    pthread_mutex_unlock(&search->progress_lock);
+    pthread_mutex_lock(&search->lock);
+    more = search->num_done > num_done;
+    pthread_mutex_unlock(&search->lock);
+  }
+}
+
+// Counts a finished chunk towards the progress bar, and moves tried_below past
+// it once every chunk before it is finished too, reporting the progress
+// through tried_below.
+static void FinishChunk(Search* search, const LargeUInt* chunk_numbers,
+                        uint64_t index, LargeUInt* tried_below) {
+  pthread_mutex_lock(&search->lock);
+  uint64_t first_active = search->next_chunk;
+  int i;
+  for (i = 0; i < search->num_threads; i++) {
+    if (search->active[i] == index) {
+      search->active[i] = NO_CHUNK;
+    } else if (search->active[i] < first_active) {
+      first_active = search->active[i];
+    }
+  }
+  int moved = search->num_done < first_active;
+  while (search->num_done < first_active) {
+    search->num_done++;
+    LargeUIntAdd(chunk_numbers, &search->tried_below);
+  }
+  LargeUIntAdd(chunk_numbers, &search->covered);
+  // The first x is printed with the bar, which leaves room for 49 more.
+  while (search->num_reported < 49 &&
+         LargeUIntCompare(&search->covered,
+                          &search->next_reporting_milestone) < 1) {
+    printf("x");
+    fflush(stdout);
+    search->num_reported++;
+    LargeUIntAdd(&search->one_fiftieth_max, &search->next_reporting_milestone);
+  }
+  pthread_mutex_unlock(&search->lock);
+  if (moved && search->progress != NULL) {
+    ReportProgress(search, tried_below);
+  }
+}
+
+// Tries the divisors of one chunk after another until they run out or a
+// factor turns up on any thread.
+static void* RunSearch(void* arg) {
+  Search* search = arg;
+  LargeUInt chunk_numbers = {0};
+  LargeUIntSetWord(TRIAL_DIVISION_CHUNK_NUMBERS, &chunk_numbers);
+  LargeUInt start = {0};
+  LargeUInt end = {0};
+  LargeUInt divisor = {0};
+  LargeUInt tried_below = {0};
+  uint64_t index;
+  while (!atomic_load_explicit(&search->found, memory_order_relaxed) &&
+         TakeChunk(search, &chunk_numbers, &start, &end, &index)) {
+    Wheel wheel;
+    LargeUIntClone(&start, &divisor);
+    LargeUIntAddByte(WheelStart(LargeUIntModWord(&divisor, WHEEL_MODULUS),
+                                &wheel),
+                     &divisor);
+
+    // Divisors below 2^32 are tried a batch at a time, each batch reducing
+    // the candidate in one pass.
+    uint64_t last_small = WordOrMax(&end) - 1;
+    if (last_small > WordOrMax(search->max_divisor)) {
+      last_small = WordOrMax(search->max_divisor);
+    }
+    if (last_small > UINT32_MAX) {
+      last_small = UINT32_MAX;
+    }
+    while (WordOrMax(&divisor) <= last_small &&
+           !atomic_load_explicit(&search->found, memory_order_relaxed)) {
+      uint32_t divisors[SMALL_DIVISOR_BATCH];
+      uint32_t residues[SMALL_DIVISOR_BATCH];
+      uint64_t next = LargeUIntGetWord(&divisor);
+      int count = 0;
+      while (count < SMALL_DIVISOR_BATCH && next <= last_small) {
+        divisors[count++] = next;
+        next += WheelNext(&wheel);
+      }
+      LargeUIntModSmall(search->candidate, divisors, count, residues);
+      int i;
+      for (i = 0; i < count; i++) {
+        if (residues[i] == 0) {
+          LargeUIntSetWord(divisors[i], &divisor);
+          FoundFactor(search, &divisor);
+          break;
+        }
+      }
+      LargeUIntSetWord(next, &divisor);
+    }
+
+    while (LargeUIntCompare(&divisor, &end) > 0 &&
+           LargeUIntCompare(&divisor, search->max_divisor) >= 0) {
+      if (atomic_load_explicit(&search->found, memory_order_relaxed)) {
+        break;
+      }
+      if (LargeUIntIsDivisibleBy(search->candidate, &divisor)) {
+        FoundFactor(search, &divisor);
+        break;
+      }
+      LargeUIntAddByte(WheelNext(&wheel), &divisor);
+    }
+    if (!atomic_load_explicit(&search->found, memory_order_relaxed)) {
+      FinishChunk(search, &chunk_numbers, index, &tried_below);
+    }
+  }
+  LargeUIntFree(&chunk_numbers);
+  LargeUIntFree(&start);
+  LargeUIntFree(&end);
+  LargeUIntFree(&divisor);
+  LargeUIntFree(&tried_below);
+  return NULL;
+}
+
+// Runs RunSearch on a worker thread, handing back its pool when done.
+static void* RunSearchThread(void* arg) {
+  RunSearch(arg);
+  LargeUIntReleasePool();
+  return NULL;
+}
+
+int TrialDivisionIsPrime(const LargeUInt* candidate,
+                         const LargeUInt* max_divisor, int num_threads) {
+  LargeUInt first_divisor = {0};
+  LargeUIntSetWord(WHEEL_FIRST_DIVISOR, &first_divisor);
+  int is_prime = TrialDivisionIsPrimeFrom(candidate, &first_divisor,
+                                          max_divisor, num_threads, NULL, NULL,
+                                          NULL);
+  LargeUIntFree(&first_divisor);
+  return is_prime;
+}
+
+int TrialDivisionIsPrimeFrom(const LargeUInt* candidate,
+                             const LargeUInt* first_divisor,
+                             const LargeUInt* max_divisor, int num_threads,
+                             TrialDivisionProgress progress, void* context,
+                             LargeUInt* factor) {
+  if (WordOrMax(first_divisor) < WHEEL_FIRST_DIVISOR) {
+    ErrorOut("Trial division must start at 11 or above.");
+  }
+  Search search = {candidate, max_divisor, progress, context};
+  atomic_init(&search.found, 0);
+  pthread_mutex_init(&search.progress_lock, NULL);
+  pthread_mutex_init(&search.lock, NULL);
+  LargeUIntClone(first_divisor, &search.next_start);
+  LargeUIntClone(first_divisor, &search.tried_below);
+  search.num_threads = num_threads < 1 ? 1 : num_threads;
+  search.active = malloc(search.num_threads * sizeof(uint64_t));
+  if (search.active == NULL) {
+    ErrorOut("Unable to allocate space for the search.");
+  }
+  int i;
+  for (i = 0; i < search.num_threads; i++) {
+    search.active[i] = NO_CHUNK;
+  }
+  LargeUIntInit(0, &search.covered);
+  LargeUInt fifty = {0};
+  LargeUInt remainder = {0};
+  LargeUIntInit(1, &fifty);
+  LargeUIntSetByte(50, 0, &fifty);
+  LargeUIntDivide(max_divisor, &fifty, &search.one_fiftieth_max, &remainder);
+  LargeUIntClone(&search.one_fiftieth_max, &search.next_reporting_milestone);
+  LargeUIntFree(&fifty);
+  LargeUIntFree(&remainder);
+
+  if (num_threads <= 1) {
+    RunSearch(&search);
+  } else {
+    pthread_t* threads = malloc(num_threads * sizeof(pthread_t));
+    if (threads == NULL) {
+      ErrorOut("Unable to allocate space for the search threads.");
+    }
+    for (i = 0; i < num_threads; i++) {
+      if (pthread_create(&threads[i], NULL, RunSearchThread, &search) != 0) {
+        ErrorOut("Unable to start a search thread.");
+      }
+    }
+    for (i = 0; i < num_threads; i++) {
+      pthread_join(threads[i], NULL);
+    }
+    free(threads);
+  }
+
+  int found = atomic_load(&search.found);
+  if (found && factor != NULL) {
+    LargeUIntClone(&search.factor, factor);
+  }
+  pthread_mutex_destroy(&search.progress_lock);
+  pthread_mutex_destroy(&search.lock);
+  free(search.active);
+  LargeUIntFree(&search.factor);
+  LargeUIntFree(&search.tried_below);
+  LargeUIntFree(&search.next_start);
+  LargeUIntFree(&search.covered);
+  LargeUIntFree(&search.one_fiftieth_max);
+  LargeUIntFree(&search.next_reporting_milestone);
+  return !found;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TRIAL_DIVISION_H
+#define TRIAL_DIVISION_H
+
+#include "large-u-int.h"
+
+// Trial division of a single candidate on several threads. The divisors on
+// the wheel from 11 up to the maximum are split into chunks that the threads
+// take in increasing order. The first factor any thread finds cancels the
+// search on every thread, so a composite costs little more than its
+// smallest factor.
+
+// Each chunk covers this many numbers, of which only those on the wheel are
+// tried as divisors.
+#define TRIAL_DIVISION_CHUNK_NUMBERS (1 << 20)
+
+// Returns 1 if no divisor on the wheel from 11 up to max_divisor divides the
+// candidate, which must itself be on the wheel, or 0 once a factor is found.
+// The search runs on num_threads threads, with 1 keeping it on the calling
+// thread. An x is printed for each 2% of the divisors tried, counted across
+// all of the threads.
+int TrialDivisionIsPrime(const LargeUInt* candidate,
+                         const LargeUInt* max_divisor, int num_threads);
+
+// Called by TrialDivisionIsPrimeFrom, from whichever thread finishes a chunk,
+// as every divisor below tried_below has been tried. The search's lock is not
+// held, so the call may take its time while the other threads carry on, but
+// no two calls overlap and tried_below only ever grows from one call to the
+// next. tried_below is only valid during the call.
+typedef void (*TrialDivisionProgress)(const LargeUInt* tried_below,
+                                      void* context);
+
+// TrialDivisionIsPrime for a candidate already known to have no factor below
+// first_divisor, which must be at least 11. Only the divisors on the wheel
+// from first_divisor up to max_divisor are tried. Unless progress is NULL, it
+// is called with context as the divisors are worked through. A factor that is
+// found is stored in factor unless that is NULL.
+int TrialDivisionIsPrimeFrom(const LargeUInt* candidate,
+                             const LargeUInt* first_divisor,
+                             const LargeUInt* max_divisor, int num_threads,
+                             TrialDivisionProgress progress, void* context,
+                             LargeUInt* factor);
+
+#endif
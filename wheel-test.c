@@ -0,0 +1,77 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "wheel.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+void Check(int condition, char* message) {
+  if (!condition) {
+    fprintf(stderr, "Condition failed: %s\n", message);
+    exit(1);
+  }
+}
+
+int SharesFactor(int value) {
+  return value % 2 == 0 || value % 3 == 0 || value % 5 == 0 || value % 7 == 0;
+}
+
+void TestStepping() {
+  // Stepping from any start visits exactly the numbers with no factor
+  // below 11.
+  int start;
+  int all_match = 1;
+  for (start = 0; start < 2 * WHEEL_MODULUS; start++) {
+    Wheel wheel;
+    int value = start + WheelStart(start % WHEEL_MODULUS, &wheel);
+    int expected = start;
+    while (SharesFactor(expected)) {
+      expected++;
+    }
+    while (value < 4 * WHEEL_MODULUS) {
+      if (value != expected) {
+        all_match = 0;
+      }
+      value += WheelNext(&wheel);
+      expected++;
+      while (SharesFactor(expected)) {
+        expected++;
+      }
+    }
+  }
+  Check(all_match, "Wheel should visit every number with no small factor");
+}
+
+void TestFirstDivisor() {
+  Wheel wheel;
+  Check(WheelStart(WHEEL_FIRST_DIVISOR, &wheel) == 0,
+        "First divisor should be on the wheel");
+  Check(WheelNext(&wheel) == 2, "13 should follow 11");
+}
+
+void TestSmallOddPrimes() {
+  Check(WheelSmallOddPrime(0) == 3, "0 should give 3");
+  Check(WheelSmallOddPrime(3) == 3, "3 should give 3");
+  Check(WheelSmallOddPrime(4) == 5, "4 should give 5");
+  Check(WheelSmallOddPrime(6) == 7, "6 should give 7");
+  Check(WheelSmallOddPrime(7) == 7, "7 should give 7");
+}
+
+int main() {
+  TestStepping();
+  TestFirstDivisor();
+  TestSmallOddPrimes();
+  printf("All tests passed\n");
+}
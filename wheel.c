@@ -0,0 +1,63 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "wheel.h"
+
+// The residues mod 210 that are on the wheel, in increasing order.
+static const unsigned char kResidues[WHEEL_SIZE] = {
+    1, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53, 59, 61, 67, 71, 73, 79,
+    83, 89, 97, 101, 103, 107, 109, 113, 121, 127, 131, 137, 139, 143, 149, 151,
+    157, 163, 167, 169, 173, 179, 181, 187, 191, 193, 197, 199, 209};
+
+// The gap from each residue to the next one, wrapping from 209 to 211.
+static const unsigned char kGaps[WHEEL_SIZE] = {
+    10, 2, 4, 2, 4, 6, 2, 6, 4, 2, 4, 6, 6, 2, 6, 4, 2, 6, 4, 6, 8, 4, 2, 4,
+    2, 4, 8, 6, 4, 6, 2, 4, 6, 2, 6, 6, 4, 2, 4, 6, 2, 6, 4, 2, 4, 2, 10, 2};
+
+int WheelStart(int residue, Wheel* wheel) {
+  int i;
+  for (i = 0; i < WHEEL_SIZE; i++) {
+    if (kResidues[i] >= residue) {
+      wheel->index = i;
+      return kResidues[i] - residue;
+    }
+  }
+  // Past 209 the next number on the wheel is 1 in the next turn.
+  wheel->index = 0;
+  return WHEEL_MODULUS + 1 - residue;
+}
+
+int WheelNext(Wheel* wheel) {
+  int gap = kGaps[wheel->index];
+  wheel->index++;
+  if (wheel->index == WHEEL_SIZE) {
+    wheel->index = 0;
+  }
+  return gap;
+}
+
+int WheelSmallOddPrime(int value) {
+  if (value <= 3) {
+    return 3;
+  }
+  if (value <= 5) {
+    return 5;
+  }
+  if (value <= 7) {
+    return 7;
+  }
+  return 11;
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright 2014 Google Inc. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WHEEL_H
+#define WHEEL_H
+
+// A mod 210 wheel for stepping through candidates and trial divisors. Only
+// the 48 residues that share no factor with 2 * 3 * 5 * 7 are visited, so
+// multiples of 2, 3, 5 and 7 are skipped without being tried. A number
+// reached on the wheel has no factor below 11, which makes 11 the first
+// divisor worth trying.
+
+#define WHEEL_MODULUS 210
+#define WHEEL_SIZE 48
+#define WHEEL_FIRST_DIVISOR 11
+
+// The position on the wheel, as an index into its residues.
+typedef struct {
+  int index;
+} Wheel;
+
+// Returns how far to move up from a number with the given residue mod
+// WHEEL_MODULUS to reach the next number on the wheel, which is 0 if the
+// number is already on it, and sets the wheel to that number's position.
+int WheelStart(int residue, Wheel* wheel);
+
+// Returns the gap from the current position to the next number on the wheel
+// and moves the wheel there. Gaps are never more than 10.
+int WheelNext(Wheel* wheel);
+
+// The wheel steps over the primes 3, 5 and 7, so numbers up to 7 are handled
+// here. Returns the first odd prime at or above value.
+int WheelSmallOddPrime(int value);
+
+#endif